@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "affinity.h"
+
+// most NUMA nodes we will keep track of
+#define	MAX_NODES	256
+
+// the supported placement policies
+static enum { NONE, COMPACT, SCATTER, NODES, CPUS } policy = NONE;
+
+static int numNodes = 0;		// nodes (with CPUs we may use)
+static int nodeNum[MAX_NODES];		// system number of each node
+static cpu_set_t nodeCpus[MAX_NODES];	// usable CPUs on each node
+
+static int numCpus = 0;			// CPUs, in the order we assign them
+static int cpuOrder[CPU_SETSIZE];
+
+static int numChosen = 0;		// nodes, in the order we assign them
+static int nodeOrder[MAX_NODES];	// (as indices into the above)
+
+/*
+ * parse a list of numbers and ranges (e.g. 0-3,8,10-11)
+ *
+ * @param	list to be parsed
+ * @param	(returned) numbers in the list
+ * @param	maximum number of numbers to return
+ * @return	number of numbers, or -1 if the list is malformed
+ */
+static int parseList( const char *s, int *out, int max ) {
+	int count = 0;
+	while( *s && *s != '\n' ) {
+		char *end;
+		long first = strtol( s, &end, 10 );
+		if (end == s || first < 0)
+			return -1;
+		long last = first;
+		s = end;
+		if (*s == '-') {
+			last = strtol( ++s, &end, 10 );
+			if (end == s || last < first)
+				return -1;
+			s = end;
+		}
+		for( long n = first; n <= last; n++ ) {
+			if (count >= max)
+				return -1;
+			out[count++] = (int) n;
+		}
+		if (*s == ',')
+			s++;
+		else if (*s && *s != '\n')
+			return -1;
+	}
+	return count;
+}
+
+/*
+ * read a (short, one line) sysfs file
+ *
+ * @return	true if it could be read
+ */
+static bool readLine( const char *path, char *buf, int len ) {
+	FILE *f = fopen( path, "r" );
+	if (f == 0)
+		return false;
+	bool ok = fgets( buf, len, f ) != 0;
+	fclose( f );
+	return ok;
+}
+
+/*
+ * find the NUMA nodes, and the CPUs we are allowed to use on each
+ */
+static void findNodes() {
+	cpu_set_t allowed;
+	if (sched_getaffinity( 0, sizeof allowed, &allowed ) != 0) {
+		CPU_ZERO( &allowed );
+		long n = sysconf( _SC_NPROCESSORS_ONLN );
+		for( long i = 0; i < n && i < CPU_SETSIZE; i++ )
+			CPU_SET( i, &allowed );
+	}
+
+	int ids[MAX_NODES];
+	char line[4096];
+	int nodes = 0;
+	if (readLine( "/sys/devices/system/node/online", line, sizeof line ))
+		nodes = parseList( line, ids, MAX_NODES );
+
+	numNodes = 0;
+	for( int i = 0; i < nodes; i++ ) {
+		char path[128];
+		snprintf( path, sizeof path, "/sys/devices/system/node/node%d/cpulist", ids[i] );
+		if (!readLine( path, line, sizeof line ))
+			continue;
+
+		// a node's CPUs are a list of the same form
+		static int cpus[CPU_SETSIZE];	// (too big for the stack)
+		int n = parseList( line, cpus, CPU_SETSIZE );
+		cpu_set_t *set = &nodeCpus[numNodes];
+		CPU_ZERO( set );
+		for( int c = 0; c < n; c++ )
+			if (cpus[c] < CPU_SETSIZE && CPU_ISSET( cpus[c], &allowed ))
+				CPU_SET( cpus[c], set );
+
+		// memory-only nodes (and those we may not use) don't count
+		if (CPU_COUNT( set ) > 0)
+			nodeNum[numNodes++] = ids[i];
+	}
+
+	// without NUMA information, we are one big node
+	if (numNodes == 0) {
+		nodeNum[0] = 0;
+		nodeCpus[0] = allowed;
+		numNodes = 1;
+	}
+}
+
+/*
+ * parse and set up an affinity policy
+ */
+const char *setAffinity( const char *p ) {
+	findNodes();
+	numCpus = 0;
+	numChosen = 0;
+
+	if (strcmp( p, "compact" ) == 0) {
+		// all of the CPUs of each node, one node at a time
+		policy = COMPACT;
+		for( int n = 0; n < numNodes; n++ )
+			for( int c = 0; c < CPU_SETSIZE; c++ )
+				if (CPU_ISSET( c, &nodeCpus[n] ))
+					cpuOrder[numCpus++] = c;
+	} else if (strcmp( p, "scatter" ) == 0) {
+		// the next CPU of each node, one CPU at a time
+		policy = SCATTER;
+		int next[MAX_NODES];
+		memset( next, 0, sizeof next );
+		for( bool more = true; more; ) {
+			more = false;
+			for( int n = 0; n < numNodes; n++ ) {
+				while( next[n] < CPU_SETSIZE && !CPU_ISSET( next[n], &nodeCpus[n] ))
+					next[n]++;
+				if (next[n] < CPU_SETSIZE) {
+					cpuOrder[numCpus++] = next[n]++;
+					more = true;
+				}
+			}
+		}
+	} else if (strncmp( p, "nodes:", 6 ) == 0) {
+		policy = NODES;
+		int ids[MAX_NODES];
+		int count = parseList( p + 6, ids, MAX_NODES );
+		if (count <= 0)
+			return "malformed node list";
+		for( int i = 0; i < count; i++ ) {
+			int n = 0;
+			while( n < numNodes && nodeNum[n] != ids[i] )
+				n++;
+			if (n >= numNodes)
+				return "no usable CPUs on requested node";
+			nodeOrder[numChosen++] = n;
+		}
+	} else if (strncmp( p, "cpus:", 5 ) == 0) {
+		policy = CPUS;
+		int count = parseList( p + 5, cpuOrder, CPU_SETSIZE );
+		if (count <= 0)
+			return "malformed cpu list";
+		for( int i = 0; i < count; i++ ) {
+			if (cpuOrder[i] >= CPU_SETSIZE)
+				return "requested CPU is not usable";
+			int n = 0;
+			while( n < numNodes && !CPU_ISSET( cpuOrder[i], &nodeCpus[n] ))
+				n++;
+			if (n >= numNodes)
+				return "requested CPU is not usable";
+		}
+		numCpus = count;
+	} else
+		return "unknown affinity policy";
+
+	return 0;
+}
+
+/*
+ * figure out where a worker should run
+ */
+bool workerAffinity( int worker, cpu_set_t *cpus ) {
+	if (policy == NONE || worker < 0)
+		return false;
+
+	if (policy == NODES) {
+		*cpus = nodeCpus[nodeOrder[worker % numChosen]];
+	} else {
+		CPU_ZERO( cpus );
+		CPU_SET( cpuOrder[worker % numCpus], cpus );
+	}
+	return true;
+}
+
+/*
+ * figure out where the thread manager should run
+ *	(anywhere on the same node as the first worker)
+ */
+bool managerAffinity( cpu_set_t *cpus ) {
+	if (!workerAffinity( 0, cpus ))
+		return false;
+
+	for( int n = 0; n < numNodes; n++ ) {
+		cpu_set_t both;
+		CPU_AND( &both, cpus, &nodeCpus[n] );
+		if (CPU_COUNT( &both ) > 0) {
+			*cpus = nodeCpus[n];
+			break;
+		}
+	}
+	return true;
+}
+
+/*
+ * format a set of CPUs as a list (e.g. 0-3,8)
+ */
+char *cpuList( const cpu_set_t *cpus, char *buf, int len ) {
+	int used = 0;
+	buf[0] = 0;
+	for( int c = 0; c < CPU_SETSIZE && used < len; c++ ) {
+		if (!CPU_ISSET( c, cpus ))
+			continue;
+		int last = c;
+		while( last + 1 < CPU_SETSIZE && CPU_ISSET( last + 1, cpus ))
+			last++;
+		if (last > c)
+			used += snprintf( &buf[used], len - used, "%s%d-%d", used ? "," : "", c, last );
+		else
+			used += snprintf( &buf[used], len - used, "%s%d", used ? "," : "", c );
+		c = last;
+	}
+	return buf;
+}
@@ -0,0 +1,59 @@
+#include <sched.h>
+
+/*
+ * CPU and NUMA placement of the load generation threads
+ *
+ *	Left to itself, the scheduler freely migrates threads between
+ *	CPUs (and NUMA nodes), which causes cross-node memory traffic
+ *	and noisy latencies.  An affinity policy pins each worker (in
+ *	the order they are started) to a CPU or node:
+ *
+ *	compact		fill up the CPUs of one node before the next
+ *	scatter		round-robin the workers across the nodes
+ *	nodes:LIST	round-robin the workers across the listed nodes
+ *			(each may run on any CPU in its node)
+ *	cpus:LIST	round-robin the workers across the listed CPUs
+ *
+ *	The manager is pinned to the node of the first worker.  Since
+ *	each worker allocates (and first touches) its own buffers after
+ *	it has been pinned, its buffers come from its own node.
+ *
+ *	Node topology comes from /sys/devices/system/node, and only
+ *	CPUs we are allowed to run on are used.  Without NUMA
+ *	information, all CPUs are treated as a single node.
+ */
+
+/**
+ * parse and set up an affinity policy
+ *
+ * @param	policy (compact, scatter, nodes:LIST, cpus:LIST)
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *setAffinity( const char *policy );
+
+/**
+ * figure out where a worker should run
+ *
+ * @param	index of the worker (in the order they are started)
+ * @param	(returned) CPUs it should run on
+ * @return	true if the worker is to be pinned
+ */
+bool workerAffinity( int worker, cpu_set_t *cpus );
+
+/**
+ * figure out where the thread manager should run
+ *
+ * @param	(returned) CPUs it should run on
+ * @return	true if the manager is to be pinned
+ */
+bool managerAffinity( cpu_set_t *cpus );
+
+/**
+ * format a set of CPUs as a list (e.g. 0-3,8)
+ *
+ * @param	CPUs to be listed
+ * @param	buffer for the list
+ * @param	length of that buffer
+ * @return	the buffer
+ */
+char *cpuList( const cpu_set_t *cpus, char *buf, int len );
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "loadgen.h"
+#include "perfstats.h"
+#include "autotune.h"
+#include "report.h"
+#include "debug.h"
+
+enum phase { IDLE, GROWING, SEARCHING, DONE };
+
+// the outcome of each trial
+#define	TRIAL_NONE	0	// not (yet) tried
+#define	TRIAL_OK	1	// SLO met and throughput grew
+#define	TRIAL_SLO	2	// SLO missed
+#define	TRIAL_FLAT	3	// throughput did not (sufficiently) grow
+static const char *results[] = { "none", "ok", "slo", "flat" };
+
+struct trial {
+	int	result;		///< TRIAL_NONE ... TRIAL_FLAT
+	long long rate;		///< throughput (bytes/second)
+	long	p50;		///< median latency (us)
+	long	pslo;		///< latency at the SLO percentile (us)
+};
+
+static enum phase phase = IDLE;
+static double sloPct = 99;	// SLO percentile
+static long sloUs = 0;		// SLO latency (us)
+static struct trial trials[MAX_THREADS + 1];	// indexed by thread count
+static int maxThreads;		// most threads we can try
+static int current;		// thread count being tried
+static int lo;			// most threads that were good (or 0)
+static int hi;			// fewest threads that were bad
+static int warming;		// intervals to skip before judging a trial
+
+/*
+ * parse a latency SLO
+ */
+const char *setSLO( const char *spec ) {
+	const char *s = spec;
+	if (*s == 'p' || *s == 'P') {
+		char *end;
+		sloPct = strtod( s + 1, &end );
+		if (end == s + 1 || *end != ':' || sloPct <= 0 || sloPct >= 100)
+			return "Invalid SLO percentile";
+		s = end + 1;
+	}
+
+	char *suffix;
+	double num = strtod( s, &suffix );
+	if (suffix == s || num <= 0)
+		return "Invalid SLO latency";
+	if (strcmp( suffix, "s" ) == 0)
+		num *= 1000000;
+	else if (strcmp( suffix, "ms" ) == 0)
+		num *= 1000;
+	else if (*suffix != 0 && strcmp( suffix, "us" ) != 0)
+		return "Invalid SLO latency";
+	sloUs = (long) num;
+
+	phase = GROWING;
+	return 0;
+}
+
+bool tuning() {
+	return phase == GROWING || phase == SEARCHING;
+}
+
+/*
+ * start the search
+ */
+int tuneStart( int max ) {
+	if (!tuning())
+		return -1;
+	maxThreads = (max > MAX_THREADS) ? MAX_THREADS : max;
+	lo = 0;
+	hi = maxThreads + 1;
+	current = (maxThreads > 0) ? 1 : 0;
+	warming = TUNE_WARMUP;
+	return current;
+}
+
+/*
+ * note the results of a reporting interval
+ */
+int tuneInterval( int threads, long microseconds, perfstats *s ) {
+	if (!tuning())
+		return current;
+
+	// if threads have finished, this was not a fair trial (and
+	//	there can be no more of them)
+	if (threads < current || loadgen_shutdown) {
+		tuneEnd();
+		return lo;
+	}
+
+	// a (clock aligned) first interval may be too short to count
+	if (microseconds < loadgen_update * 1000L * 9 / 10)
+		return current;
+
+	// and the new threads (and the old ones' queues) need time to settle
+	if (warming > 0) {
+		if (loadgen_debug & D_CMDS)
+			fprintf(stderr, "# tune: threads=%d warming up\n", current );
+		warming--;
+		return current;
+	}
+
+	// evaluate this trial
+	struct trial *t = &trials[current];
+	t->rate = microseconds > 0 ? (s->total_bytes * 1000000) / microseconds : 0;
+	t->p50 = s->interpolated( 50 );
+	t->pslo = s->interpolated( sloPct );
+	if (t->pslo > sloUs)
+		t->result = TRIAL_SLO;
+	else if (lo > 0 && (t->rate - trials[lo].rate) * 100 * lo <
+			trials[lo].rate * (current - lo) * TUNE_GAIN)
+		t->result = TRIAL_FLAT;
+	else
+		t->result = TRIAL_OK;
+	if (loadgen_debug & D_CMDS)
+		fprintf(stderr, "# tune: threads=%d rate=%lld p50_us=%ld slo_us=%ld/%ld result=%s\n",
+			current, t->rate, t->p50, t->pslo, sloUs, results[t->result] );
+
+	if (t->result == TRIAL_OK)
+		lo = current;
+	else
+		hi = current;
+
+	// double the load until something goes wrong
+	warming = TUNE_WARMUP;
+	if (phase == GROWING) {
+		if (t->result == TRIAL_OK && current < maxThreads) {
+			current = (current * 2 > maxThreads) ? maxThreads : current * 2;
+			return current;
+		}
+		phase = SEARCHING;
+	}
+
+	// then narrow in on the knee
+	if (hi - lo > 1 && lo > 0) {
+		current = (lo + hi) / 2;
+		return current;
+	}
+	tuneEnd();
+	return lo;
+}
+
+/*
+ * end the search and report what we found
+ */
+void tuneEnd() {
+	if (!tuning())
+		return;
+	phase = DONE;
+
+	for( int i = 1; i <= maxThreads; i++ ) {
+		struct trial *t = &trials[i];
+		if (t->result != TRIAL_NONE)
+			tuneReport( "trial", i, t->rate, t->p50, sloPct, t->pslo, sloUs, results[t->result] );
+	}
+
+	struct trial none = { TRIAL_NONE, 0, 0, 0 };
+	struct trial *t = (lo > 0) ? &trials[lo] : &none;
+	tuneReport( "chosen", lo, t->rate, t->p50, sloPct, t->pslo, sloUs, results[t->result] );
+}
@@ -0,0 +1,77 @@
+/*
+ * automatic saturation search against a latency SLO
+ *
+ *	Rather than having someone at the master console bump the
+ *	thread count until latency goes bad, a loadgen can search for
+ *	the knee itself: the most threads it can run while a latency
+ *	percentile (e.g. p99 < 5ms) is still met and throughput is
+ *	still growing.
+ *
+ *	Each trial runs a thread count for TUNE_WARMUP (full)
+ *	reporting intervals, which are ignored, and then judges it
+ *	by the next one, so --update= should be long enough to
+ *	reach a steady state.
+ *	The count doubles (1, 2, 4, ...) until the SLO is missed,
+ *	throughput stops growing (the added threads deliver less
+ *	than TUNE_GAIN percent of linear scaling), or we run out of
+ *	threads, and then a binary search between the last good and
+ *	first bad counts finds the knee.  Each trial,
+ *	and the chosen operating point, is reported as a TUNE line
+ *	(or a JSON object with a "tune" field).
+ *
+ *	Latencies are estimated from the report buckets, by
+ *	interpolating within the bucket containing the percentile
+ *	(rather than taking its upper limit, which would turn a 5ms
+ *	SLO into 4ms), so an SLO is only as exact as the assumption
+ *	that latencies are spread evenly through each bucket.
+ */
+
+// how much (percent of linear scaling) added threads have to deliver
+#define	TUNE_GAIN	25
+
+// how many reporting intervals each trial runs before it is judged
+#define	TUNE_WARMUP	1
+
+class perfstats;
+
+/**
+ * parse a latency SLO
+ *
+ * @param	[pPCT:]LATENCY (e.g. p99:5ms), where the latency is in
+ *		us (or followed by us, ms or s), and the default
+ *		percentile is p99
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *setSLO( const char *spec );
+
+/**
+ * is a saturation search (still) in progress
+ *
+ * @return	true if it is
+ */
+bool tuning();
+
+/**
+ * start the search
+ *
+ * @param	number of threads available (or that can be defined)
+ * @return	number of threads for the first trial
+ */
+int tuneStart( int max );
+
+/**
+ * note the results of a reporting interval
+ *
+ * @param	number of threads that were running
+ * @param	length of the interval (us)
+ * @param	statistics for the interval
+ * @return	number of threads for the next trial (or the chosen
+ *		operating point, when the search is over)
+ */
+int tuneInterval( int threads, long microseconds, perfstats *s );
+
+/**
+ * end the search (early, if it is still in progress)
+ *	reporting the trials so far and the best of them
+ */
+void tuneEnd();
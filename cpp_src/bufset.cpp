@@ -1,5 +1,7 @@
 #include <stdlib.h>
 #include <malloc.h>
+#include <string.h>
+#include <pthread.h>
 #include <sys/mman.h>
 
 #include "bufset.h"
@@ -8,6 +10,50 @@
  * count, size, and alignment
  */
 
+/*
+ * the (pre-touched) pool that buffer sets are carved from
+ */
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static char *pool = 0;		// start of the pool
+static long poolSize = 0;	// bytes in the pool
+static long poolUsed = 0;	// bytes carved from it
+
+/**
+ * allocate (and touch) the pool
+ *
+ * @param	bytes in the pool
+ * @return	true if it could be allocated
+ */
+bool bufsetPool( long bytes ) {
+	void *p = mmap( 0, bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+	if (p == MAP_FAILED)
+		return false;
+	memset( p, 0, bytes );
+	pool = (char *) p;
+	poolSize = bytes;
+	poolUsed = 0;
+	return true;
+}
+
+/**
+ * carve a buffer set from the pool
+ *
+ * @param	bytes needed
+ * @param	required memory alignment
+ * @return	the buffers (or NULL if they do not fit)
+ */
+static char *carve( long bytes, int alignment ) {
+	char *p = 0;
+	pthread_mutex_lock( &poolLock );
+	long start = ((poolUsed + alignment - 1) / alignment) * alignment;
+	if (pool != 0 && start + bytes <= poolSize) {
+		p = &pool[start];
+		poolUsed = start + bytes;
+	}
+	pthread_mutex_unlock( &poolLock );
+	return p;
+}
+
 /**
  * allocate and lock down a buffer set
  *
@@ -19,10 +65,21 @@ Bufset::Bufset( int numbufs, int bufsize, int alignment ) {
 
 	int totsize = numbufs * bufsize;
 
-	if (posix_memalign( (void **) &_bufstart, alignment, totsize) == 0) {
+	// (pool memory has already been touched)
+	_bufstart = carve( totsize, alignment );
+	_pooled = _bufstart != 0;
+	if (_pooled) {
+		buffers = numbufs;
+		size = bufsize;
+		mlock( _bufstart, totsize );
+	} else if (posix_memalign( (void **) &_bufstart, alignment, totsize) == 0) {
 		buffers = numbufs;
 		size = bufsize;
-		mlock( &_bufstart, totsize );
+
+		// touch every page now, so that they are allocated on the
+		// NUMA node of the (possibly pinned) thread that will use them
+		memset( _bufstart, 0, totsize );
+		mlock( _bufstart, totsize );
 	} else {
 		buffers = 0;
 		size = 0;
@@ -32,11 +89,20 @@ Bufset::Bufset( int numbufs, int bufsize, int alignment ) {
 
 /**
  * unlock and free a buffer set
+ *	(a pooled one goes back to the pool only if it was the last
+ *	carved from it)
  */
 Bufset::~Bufset() {
 	if (_bufstart != 0 && buffers != 0 && size != 0) {
 		munlock( _bufstart, buffers * size );
-		free( _bufstart );
+		if (!_pooled)
+			free( _bufstart );
+		else {
+			pthread_mutex_lock( &poolLock );
+			if (_bufstart + buffers * size == &pool[poolUsed])
+				poolUsed = _bufstart - pool;
+			pthread_mutex_unlock( &poolLock );
+		}
 	}
 }
 
@@ -28,4 +28,18 @@ class Bufset {
 
     private:
 	char *_bufstart;
+	bool _pooled;	///< carved from the pool (rather than allocated)
 };
+
+/**
+ * allocate (and touch) a pool of buffer memory, from which buffer
+ *	sets are then carved (for as long as it lasts)
+ *
+ *	A listener fills the pool before it forks any sessions, so that
+ *	each of them inherits (copy-on-write) pages that have already
+ *	been faulted in, rather than faulting in their own.
+ *
+ * @param	bytes in the pool
+ * @return	true if it could be allocated
+ */
+bool bufsetPool( long bytes );
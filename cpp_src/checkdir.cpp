@@ -1,8 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 
 #include "loadgen.h"
 #include "debug.h"
@@ -59,6 +62,26 @@ bool checkdev( const char *devname ) {
 	return( false );
 }
 
+/*
+ * routine:	devsize
+ *
+ * purpose:	to determine the size of a block device
+ *
+ * returns:	size (in bytes) or 0 if it cannot be determined
+ */
+long long devsize( const char *devname ) {
+
+	unsigned long long size = 0;
+	int fd = open( devname, O_RDONLY );
+	if (fd >= 0) {
+		if (ioctl( fd, BLKGETSIZE64, &size ) != 0)
+			size = 0;
+		close( fd );
+	}
+
+	return( size );
+}
+
 /*
  * routine:	checkfile
  *
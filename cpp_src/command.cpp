@@ -1,9 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
 #include <poll.h>
 
 #include "loadgen.h"
+#include "pattern.h"
+#include "profile.h"
+#include "sweep.h"
 #include "debug.h"
 
 #define STDIN	0
@@ -11,88 +18,310 @@
 // longest expected input line
 #define MAX_LINE	128
 
-// largest reasonable number of threads to run
-#define	MAX_THREADS	999
+// we have been told there will be no further input
+static bool disconnect = false;
+
+// input we have read, but not yet processed
+static char inbuf[MAX_LINE];
+static int buffered = 0;	// bytes in inbuf
+static bool eof = false;	// there will be no more
+static bool skipping = false;	// discarding the rest of an over-long line
 
 /*
- * wait for a command to change the number of threads
+ * take the next complete line from the input buffer
  *
- *	waits no more than maxSeconds for a command
+ *	a line too long for the buffer is returned truncated (and so
+ *	flagged, since its prefix might look like a command), and the
+ *	rest of it is discarded.  At EOF, a final unterminated line is
+ *	returned as it is.
+ *
+ * @param	(returned) the line, without its newline
+ * @param	(returned) the line was too long (and has been truncated)
+ * @return	true if there was a line
+ */
+static bool nextLine( char *line, bool *truncated ) {
+	for(;;) {
+		char *nl = (char *) memchr( inbuf, '\n', buffered );
+		int len = nl ? (int) (nl - inbuf) : buffered;
+		if (nl == 0 && buffered < MAX_LINE - 1 && !(eof && buffered > 0))
+			return false;
+
+		memcpy( line, inbuf, len );
+		line[len] = 0;
+		int used = nl ? len + 1 : len;
+		buffered -= used;
+		memmove( inbuf, &inbuf[used], buffered );
+
+		// the tail of a line we have already returned
+		if (skipping) {
+			skipping = (nl == 0);
+			continue;
+		}
+		skipping = (nl == 0 && !eof);
+		*truncated = skipping;
+
+		// trailing white space (e.g. from a telnet) is not significant
+		while( len > 0 && isspace( line[len-1] ))
+			line[--len] = 0;
+		return true;
+	}
+}
+
+/*
+ * read whatever input is available (without waiting for more)
+ */
+static void fill() {
+	int got = read( STDIN, &inbuf[buffered], MAX_LINE - 1 - buffered );
+	if (got > 0)
+		buffered += got;
+	else if (got == 0 || (errno != EINTR && errno != EAGAIN))
+		eof = true;
+}
+
+/*
+ * acknowledge (or reject) a command
+ *
+ * @param	the command, as we understood it
+ * @param	NULL if it was accepted, else why it was not
+ */
+static void reply( const char *command, const char *problem ) {
+	if (problem)
+		fprintf(stdout, "NAK %s %s\n", command, problem);
+	else
+		fprintf(stdout, "ACK %s\n", command);
+	fflush( stdout );
+}
+
+/*
+ * parse a (non-negative) number, with an optional K/M/G suffix
+ *
+ * @return	the number, or -1 if it is not one
+ */
+static long long number( const char *s, bool sized ) {
+	if (!isdigit( *s ))
+		return -1;
+	if (sized)
+		return getSizeSpec( s );
+	for( const char *p = s; *p; p++ )
+		if (!isdigit( *p ))
+			return -1;
+	return atoll( s );
+}
+
+/*
+ * carry out a command to change the shape of the load
+ *
+ * @param	the name of the parameter
+ * @param	its new value
+ * @param	(returned) the value, as a number
+ * @return	NULL if it was done, else why it was not
+ */
+static const char *setParameter( const char *name, const char *value, long long *applied ) {
+	long long n;
+	if (strcmp( name, "rate" ) == 0) {
+		n = *applied = number( value, true );
+		if (n < 0)
+			return "Invalid rate";
+		loadgen_rate = n;
+		profileRateOverride();
+		return 0;
+	}
+
+	// the others change the blocks, which only mixed workers can do
+	bool blocks = strcmp( name, "bsize" ) == 0 || strcmp( name, "depth" ) == 0 ||
+			strcmp( name, "random" ) == 0 || strcmp( name, "mix" ) == 0;
+	if (!blocks)
+		return "Unrecognized command";
+	if (loadgen_mix < 0)
+		return "Only a mixed workload (--mix or --sweep) can change its blocks";
+	if (sweeping() && strcmp( name, "random" ) != 0)
+		return "Sweep in progress";
+
+	if (strcmp( name, "bsize" ) == 0) {
+		n = *applied = number( value, true );
+		if (n <= 0 || n > max_bsize())
+			return "Invalid block size";
+		if (loadgen_direct > 0 && n % loadgen_direct != 0)
+			return "Block size is not a multiple of the direct alignment";
+		loadgen_bsize = (int) n;
+	} else if (strcmp( name, "depth" ) == 0) {
+		n = *applied = number( value, false );
+		if (n < 1 || n > MAX_MIX_DEPTH)
+			return "Invalid queue depth";
+		loadgen_depth = (int) n;
+	} else if (strcmp( name, "random" ) == 0) {
+		n = *applied = number( value, true );
+		if (n < 0 || n > max_bsize())
+			return "Invalid random block size";
+		loadgen_rand_blk = (int) n;
+	} else {
+		n = *applied = number( value, false );
+		if (n < 0 || n > 100)
+			return "Invalid read/write mix";
+		loadgen_mix = (int) n;
+	}
+	return 0;
+}
+
+/*
+ * wait for a command to change the number of threads (or the load)
+ *
+ *	waits (no later than an absolute deadline) for a command
  *
  *	if an x, q, or EOF is entered, it is treated as a shutdown
  *	if a d is entered, disconnect from stdin (it has no more to say)
- #	if a number is entered, return it as a new thread count
+ *	if a number (or threads=#) is entered, return it as a new thread count
+ *	if rate=, bsize=, depth=, random= or mix= is entered, change it
+ *
+ *	every other command is acknowledged (with an ACK or NAK line)
  *
  *	returns a new thread count, or -1 if we timed out
  */
-int changeNumThreads( int maxSeconds ) {
-
-	static bool disconnect = false;
+int changeNumThreads( const struct timespec *deadline ) {
 
 	// if we aren't a zombie or have no connected input
+	//	(a signal wakes us up, so we can notice a shutdown)
 	if (disconnect || !loadgen_zombie) {
-		sleep( maxSeconds );
+		clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, 0 );
 		return( -1 );
 	}
-		
-	// set up our poll arguments
-	struct pollfd pollfds;
-	pollfds.fd = STDIN;
-	pollfds.events = POLLIN;
-
-	char inbuf[MAX_LINE];
-
-	// wait for input or the specified delay period
-	int count = poll( &pollfds, 1, maxSeconds * 1000 );
-	if (count == 0)	// timed out
-		return( -1 );	
 
-	// did we get a HUP from stdin?
-	if (pollfds.revents & POLLHUP) {
-		disconnect = true;
-		loadgen_shutdown = true;
-		if (loadgen_debug & D_CMDS)
-			fprintf(stderr, "# STDIN <- HUP\n");
-		return 0;
-	}
-
-	// did we get character input
-	if (pollfds.revents & POLLIN) {
-		char c;
-		int got = 0;
-		do {	// try to read one line from stdin
-			if (read(0, &inbuf[got], 1) != 1) 
-				break;
-			c = inbuf[got++];
-		} while (c != '\n' && got < MAX_LINE - 2);
-		inbuf[got] = 0;
-
-		// see if it is an EOF or shutdown command
-		c = inbuf[0];
-		if (got == 0 || c == 'x' || c == 'q' || c == 'X' || c == 'Q') {
+	// wait until we have a complete line
+	char line[MAX_LINE];
+	bool truncated = false;
+	while( !nextLine( line, &truncated )) {
+		// see if it is an EOF
+		if (eof) {
+			disconnect = true;	// nothing more worth reading
 			loadgen_shutdown = true;
 			if (loadgen_debug & D_CMDS)
 				fprintf(stderr, "# STDIN <- quit\n");
 			return 0;
 		}
 
-		// see if it is a disconnect command
-		if (c == 'd' || c == 'D') {
+		// set up our poll arguments
+		struct pollfd pollfds;
+		pollfds.fd = STDIN;
+		pollfds.events = POLLIN;
+
+		// figure out how long we have until the deadline
+		struct timespec now, timeout;
+		clock_gettime( CLOCK_MONOTONIC, &now );
+		timeout.tv_sec = deadline->tv_sec - now.tv_sec;
+		timeout.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+		if (timeout.tv_nsec < 0) {
+			timeout.tv_sec--;
+			timeout.tv_nsec += 1000000000;
+		}
+		if (timeout.tv_sec < 0)
+			return( -1 );
+
+		// wait for input or the deadline
+		int count = ppoll( &pollfds, 1, &timeout, 0 );
+		if (count == 0 || (count < 0 && errno == EINTR))	// timed out
+			return( -1 );
+
+		// did we get character input
+		if (pollfds.revents & POLLIN) {
+			fill();
+			continue;
+		}
+
+		// did we get a HUP from stdin?
+		if (pollfds.revents & POLLHUP) {
 			disconnect = true;
+			loadgen_shutdown = true;
 			if (loadgen_debug & D_CMDS)
-				fprintf(stderr, "# STDIN <- disconnect\n");
-			return( -1 );
+				fprintf(stderr, "# STDIN <- HUP\n");
+			return 0;
 		}
 
-		// try to parse it as a number
-		int n = atoi(inbuf);
+		// something else seems to have happened here
+		fprintf(stderr, "# Unexpected Poll Exit!\n");
+		return( -1 );
+	}
+
+	// blank lines are not commands
+	char c = line[0];
+	if (c == 0)
+		return( -1 );
+
+	// nor is what is left of a line that was too long
+	if (truncated) {
+		if (loadgen_debug & D_CMDS)
+			fprintf(stderr, "# STDIN <- %s...\n", line);
+		reply( line, "Line too long" );
+		return( -1 );
+	}
+	bool assignment = strchr( line, '=' ) != 0;
+
+	// see if it is a shutdown command
+	//	(which is acknowledged by our exit message)
+	if (!assignment && (c == 'x' || c == 'q' || c == 'X' || c == 'Q')) {
+		disconnect = true;	// nothing more worth reading
+		loadgen_shutdown = true;
+		if (loadgen_debug & D_CMDS)
+			fprintf(stderr, "# STDIN <- quit\n");
+		return 0;
+	}
+
+	// see if it is a disconnect command
+	if (!assignment && (c == 'd' || c == 'D')) {
+		disconnect = true;
 		if (loadgen_debug & D_CMDS)
-			fprintf(stderr, "# STDIN <- %d\n", n);
-		if (n >= 0 && n < MAX_THREADS)
-			return( n );
+			fprintf(stderr, "# STDIN <- disconnect\n");
+		reply( "disconnect", 0 );
+		return( -1 );
+	}
+
+	// see if it is a new number of threads
+	const char *count = (strncmp( line, "threads=", 8 ) == 0) ? &line[8] : line;
+	if (isdigit( *count )) {
+		long long n = number( count, false );
+		if (loadgen_debug & D_CMDS)
+			fprintf(stderr, "# STDIN <- %lld\n", n);
+		if (n < 0 || n > MAX_THREADS) {
+			reply( line, "Invalid thread count" );
+			return( -1 );
+		}
+		char ack[MAX_LINE + 32];
+		snprintf( ack, sizeof ack, "threads=%d", (int) n );
+		reply( ack, 0 );
+		return( (int) n );
 	}
 
-	// something else seems to have happened here
-	fprintf(stderr, "# Unexpected Poll Exit!\n");
+	// anything else should be a parameter=value
+	if (loadgen_debug & D_CMDS)
+		fprintf(stderr, "# STDIN <- %s\n", line);
+	char *value = strchr( line, '=' );
+	if (value == 0 || value[1] == 0) {
+		reply( line, "Unrecognized command" );
+		return( -1 );
+	}
+	*value++ = 0;
+	long long n = -1;
+	const char *problem = setParameter( line, value, &n );
+	if (problem) {
+		value[-1] = '=';
+		reply( line, problem );
+	} else {
+		char ack[MAX_LINE + 32];
+		snprintf( ack, sizeof ack, "%s=%lld", line, n );
+		reply( ack, 0 );
+	}
 	return( -1 );
 }
+
+/*
+ * can we still receive commands to change the number of threads
+ */
+bool acceptingCommands() {
+	return loadgen_zombie && !disconnect;
+}
+
+/*
+ * is there a command we have read, but not yet carried out
+ */
+bool commandPending() {
+	return !disconnect && (memchr( inbuf, '\n', buffered ) != 0 || (eof && !skipping));
+}
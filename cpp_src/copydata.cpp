@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <malloc.h>
 #include <unistd.h>
+#include <sched.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -14,6 +15,8 @@
 #include "loadgen.h"
 #include "threadstatus.h"
 #include "pattern.h"
+#include "workqueue.h"
+#include "flush.h"
 #include "debug.h"
 
 	
@@ -27,6 +30,8 @@ struct readParms {
 	char *		to_directory;
 	int 		block_size;
 	unsigned long	create_opts;
+	WorkQueue *	queue;		// files to be copied
+	int		worker;		// this worker's queue
 };
 
 /**
@@ -51,19 +56,6 @@ static int isDir( const struct dirent *dp )
 	return S_ISDIR( statb.st_mode );
 }
 
-/*
- * scandir filter function to select only non-hidden files
- *
- * @param dp	dirent to be validated
- *
- * @return	true if it is a non-hidden file
- */
-static int isFile( const struct dirent *dp ) {
-
-	// make sure name doesn't begin with a dot
-	const char *s = dp->d_name;
-	return( *s != '.' );
-}
 /**
  * Data copying load generator:
  * -	identifies sub-directories in data source
@@ -104,6 +96,9 @@ copyData( const char *from, char *to, int threads ) {
 		return INPUT_FILE_ERROR;
 	}
 
+	// each thread starts out with the files in its own directory
+	WorkQueue *queue = new WorkQueue( num_subdirs, loadgen_steal );
+
 	// create a thread for each 
 	for( int i = 0; i < num_subdirs; i++ ) {
 		// come up with a name for this thread
@@ -141,9 +136,30 @@ copyData( const char *from, char *to, int threads ) {
 			return RESOURCE_ERROR;
 		}
 
+		// a stolen file may be copied before its own thread starts,
+		//	so the target directories must all exist up front
+		err = checkdir( parms->to_directory, true );
+		if (err) {
+			fprintf(stderr, "FATAL: target directory %s: %s\n",
+				parms->to_directory, err );
+			loadgen_problem = "target directory access";
+			return TARGET_DIRECTORY;
+		}
+
+		// queue up its files
+		parms->queue = queue;
+		parms->worker = i;
+		if (queue->addDir( i, parms->from_directory, parms->to_directory ) < 0) {
+			fprintf(stderr, "FATAL: unable to read directory %s: %s\n",
+				parms->from_directory, strerror( errno ) );
+			loadgen_problem = "source directory access";
+			return SOURCE_DIRECTORY;
+		}
+
 		// allocate the thread status structure for it
 		// 	and add it to the known threads list
-		new ThreadStatus( threadname, parms );
+		ThreadStatus *t = new ThreadStatus( threadname, parms );
+		t->target = to;
 		
 		// and free up the dirent
 		free( results[i] );
@@ -156,6 +172,7 @@ copyData( const char *from, char *to, int threads ) {
 	
 	// we just configure them, the thread manager does the real work
 	int ret =  ThreadStatus::manageThreads( copyThread, threads );
+	delete queue;
 	
 	return ret;
 }
@@ -168,8 +185,9 @@ copyData( const char *from, char *to, int threads ) {
 void *copyThread( void *sts ) {
 	int status = 0;		// this thread's exit status
 	char *data = 0;		// the buffer we read into
-	int count = 0;		// number of directory entries to process
-	int done = 0;		// number of directory entries processed
+	int count = 0;		// number of files originally queued for us
+	int done = 0;		// number of files processed
+	bool finished = false;	// we have run out of work
 
 	// pick up ponter to my status structure
 	struct ThreadStatus *mystatus = (struct ThreadStatus *) sts;
@@ -180,9 +198,10 @@ void *copyThread( void *sts ) {
 		bsize = max_bsize();
 
 	// announce that we are starting up
-	mystatus->running = true;
+	mystatus->running = true;	// now set in manageThreads to avoid a race
 	if (loadgen_debug & D_THREADS) {
-		fprintf(stderr, "# Starting %s in %s\n", mystatus->name, myparms->to_directory );
+		fprintf(stderr, "# Starting %s in %s on cpu %d\n", mystatus->name,
+			myparms->to_directory, sched_getcpu() );
 	}
 
 	// make sure our target directory exists
@@ -206,16 +225,23 @@ void *copyThread( void *sts ) {
 	}
 	mlock( data, bsize );
 
-	// find and verify each file in this directory
-	struct dirent **results;
-	count = scandir(  myparms->from_directory, &results, isFile, alphasort );
-	for( done = 0; done < count && status == 0 && mystatus->enable; done++ ) {
-		if (loadgen_shutdown)
+	// copy each queued file until there are no more
+	//	(or we are told to stop)
+	count = myparms->queue->queued( myparms->worker );
+	while( status == 0 ) {
+		if (!mystatus->keepRunning())
 			break;
 		
+		// get the next file to copy
+		WorkItem *w = myparms->queue->get( myparms->worker );
+		if (w == 0) {
+			finished = true;
+			break;
+		}
+
 		// open the input file
 		char *from_path;
-		asprintf( &from_path, "%s/%s", myparms->from_directory, results[done]->d_name );
+		asprintf( &from_path, "%s/%s", w->dir->path, w->name );
 		int fd_from = open( from_path, 0 );
 		if (fd_from < 0) {
 			fprintf(stderr, "Unable to open input file %s: %s\n", 
@@ -227,7 +253,7 @@ void *copyThread( void *sts ) {
 
 		// open the output file
 		char *to_path;
-		asprintf( &to_path, "%s/%s", myparms->to_directory, results[done]->d_name );
+		asprintf( &to_path, "%s/%s", w->dir->peer, w->name );
 		int opts = O_WRONLY|myparms->create_opts;
 		int fd_to = open( to_path, opts, 0666 );
 		if (fd_to < 0) {
@@ -246,13 +272,22 @@ void *copyThread( void *sts ) {
 
 		if (loadgen_debug & D_FILES) {
 			fprintf(stderr, "# copying file %s from %s to %s, bsize=%ld\n",
-				results[done]->d_name, myparms->from_directory,
-				myparms->to_directory, bsize);
+				w->name, w->dir->path, w->dir->peer, bsize);
 		}
 
 		// no go back and copy the next block
 		long long unsigned len = 0;
+		bool interrupted = false;
+		struct flushState flush;
+		flushOpen( &flush, fd_to, to_path );
 		while( status == 0 ) {
+			// if we have been parked, we resume right here,
+			//	but a shutdown abandons the rest of the file
+			if (!mystatus->keepRunning()) {
+				interrupted = true;
+				break;
+			}
+
 			// note when this operation starts
 			// hires_time_t elapsed = hires_time();	FIX: UNUSED
 
@@ -272,23 +307,35 @@ void *copyThread( void *sts ) {
 			// write it out to the target file
 			status |= timed_write( fd_to, data, bytes, 
 				&mystatus->stats, to_path, len );
+			if (status == 0)
+				status |= flushWrite( &flush, len, bytes, &mystatus->stats );
 			len += bytes;
 		}
 
+		if (status == 0)
+			status |= flushClose( &flush, &mystatus->stats );
 		close( fd_from );
 		close( fd_to );
 
-		if (status == 0) {
+		if (status == 0 && interrupted) {
+			// a file we didn't finish is not counted
+			free( from_path );
+			free( to_path );
+			break;
+		} else if (status == 0) {
 			mystatus->stats.file_done();
 		}
+		done++;
+
+		// whoever finishes the last file in a directory flushes it
+		if (myparms->queue->done( w, status == 0 ))
+			status |= flushDirectory( w->dir->peer, &mystatus->stats );
 		
 		// free the stuff we allocated for this file
 		free( from_path );
 		from_path = 0;
 		free( to_path );
 		to_path = 0;
-		free( results[done] );
-		results[done] = 0;
 	}
 
   	// free stuff we allocated
@@ -296,9 +343,7 @@ void *copyThread( void *sts ) {
 		munlock( data, bsize );
 		free( data );
 	}
-	if (results)
-		free( results );
-	
+
 	// free our parameters
 	free( myparms->to_directory );
 	myparms->to_directory = 0;
@@ -306,15 +351,15 @@ void *copyThread( void *sts ) {
 	myparms->from_directory = 0;
 
   exit:	
-	// update my exit status and exit
-	mystatus->running = false;
-	mystatus->exit_status = status;
-	if (loadgen_debug & D_THREADS || done != count) {
+	if (loadgen_debug & D_THREADS || !finished) {
 		// it is often useful to know what caused a thread to shut down
 		fprintf(stderr, "# Shutting down %s (en=%d, cnt=%d/%d, sts=%x, stop=%d)\n",
-			mystatus->name, mystatus->enable,
-			done, count, status, loadgen_shutdown );
+			mystatus->name, mystatus->enable.load(),
+			done, count, status, loadgen_shutdown.load() );
 	}
+
+	// report my exit status and exit
+	mystatus->exiting( status );
 	pthread_exit(0);
 }
 
@@ -0,0 +1,108 @@
+#include <string.h>
+
+#include "crc32c.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+// the (reflected) Castagnoli polynomial
+#define	POLY	0x82f63b78
+
+/**
+ * slice-by-8 tables for the software implementation
+ *	table[0] is the classic byte-at-a-time table, and
+ *	table[k] advances a byte that is k bytes further back
+ */
+static struct crc_tables {
+	uint32_t t[8][256];
+
+	crc_tables() {
+		for( int i = 0; i < 256; i++ ) {
+			uint32_t c = i;
+			for( int b = 0; b < 8; b++ )
+				c = (c & 1) ? (c >> 1) ^ POLY : (c >> 1);
+			t[0][i] = c;
+		}
+		for( int i = 0; i < 256; i++ )
+			for( int k = 1; k < 8; k++ )
+				t[k][i] = (t[k-1][i] >> 8) ^ t[0][t[k-1][i] & 0xff];
+	}
+} tables;
+
+/**
+ * software CRC32C, eight bytes at a time
+ */
+static uint32_t crc32c_sw( uint32_t crc, const void *buf, size_t len ) {
+	const unsigned char *p = (const unsigned char *) buf;
+	const uint32_t (*t)[256] = tables.t;
+
+	crc = ~crc;
+	while( len >= 8 ) {
+		uint32_t lo, hi;
+		memcpy( &lo, p, 4 );
+		memcpy( &hi, p + 4, 4 );
+		lo ^= crc;
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+		      t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+		      t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+		      t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+		p += 8;
+		len -= 8;
+	}
+	while( len-- > 0 )
+		crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+
+	return ~crc;
+}
+
+#if defined(__x86_64__)
+/**
+ * hardware CRC32C, using the SSE4.2 crc32 instruction
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw( uint32_t crc, const void *buf, size_t len ) {
+	const unsigned char *p = (const unsigned char *) buf;
+	uint64_t c = ~crc;
+
+	while( len >= 8 ) {
+		uint64_t v;
+		memcpy( &v, p, 8 );
+		c = _mm_crc32_u64( c, v );
+		p += 8;
+		len -= 8;
+	}
+	uint32_t c32 = (uint32_t) c;
+	while( len-- > 0 )
+		c32 = _mm_crc32_u8( c32, *p++ );
+
+	return ~c32;
+}
+#endif
+
+/**
+ * choose an implementation the first time we are called
+ */
+static uint32_t crc32c_init( uint32_t crc, const void *buf, size_t len );
+static uint32_t (*crc32c_impl)( uint32_t, const void *, size_t ) = crc32c_init;
+
+static uint32_t crc32c_init( uint32_t crc, const void *buf, size_t len ) {
+#if defined(__x86_64__)
+	crc32c_impl = crc32c_hardware() ? crc32c_hw : crc32c_sw;
+#else
+	crc32c_impl = crc32c_sw;
+#endif
+	return crc32c_impl( crc, buf, len );
+}
+
+bool crc32c_hardware() {
+#if defined(__x86_64__)
+	return __builtin_cpu_supports( "sse4.2" );
+#else
+	return false;
+#endif
+}
+
+uint32_t crc32c( uint32_t crc, const void *buf, size_t len ) {
+	return crc32c_impl( crc, buf, len );
+}
@@ -0,0 +1,23 @@
+/*
+ * CRC32C (Castagnoli) checksums, as used by the version 2
+ * pattern data format.  Uses the SSE4.2 crc32 instruction
+ * when the processor has it, and a table driven (slice by 8)
+ * implementation when it does not.
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * compute (or continue) a CRC32C
+ *
+ * @param crc	CRC of the preceding data (0 to start a new one)
+ * @param buf	data to be checksummed
+ * @param len	number of bytes to be checksummed
+ * @return	CRC of the preceding data followed by this buffer
+ */
+uint32_t crc32c( uint32_t crc, const void *buf, size_t len );
+
+/**
+ * @return	true if crc32c is using the crc32 instruction
+ */
+bool crc32c_hardware();
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <malloc.h>
 #include <unistd.h>
+#include <sched.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -14,19 +15,14 @@
 #include "threadstatus.h"
 #include "pattern.h"
 #include "bufset.h"
+#include "genmap.h"
+#include "flush.h"
 #include "debug.h"
 
-// maximum number of discrete threads (for manual creation)
-//	if we aren't told how many threads to create, we
-//	should expect commands to change this number over
-//	the course of the session.  This is the maximum number
-//	of threads we can create and destroy in a single
-//	session.
-#define	MAX_THREADS	100
-
 void *createDataThread( void * );
 int writeFile( const char *filename, Bufset *bufs, struct writeParms *myparms, perfstats *stats );
-int singleWrite(const char *filename, Bufset *bufs, struct writeParms *parms, int fd, perfstats *stats);
+int singleWrite(const char *filename, Bufset *bufs, struct writeParms *parms, int fd,
+		struct flushState *flush, perfstats *stats);
 
 /**
  * parameters for a data creation thread
@@ -38,11 +34,13 @@ struct writeParms {
 	bool		single_file;		// do one file and then exit
 	long long	offset;			// base offset for all file I/O
 	int		aio_depth;		// depth for AIO requests
+	ThreadStatus *	thread;			// worker doing these writes
 
 	// per file parameters
 	int 		block_size;		// size of all writes
 	long long	file_length;		// maximum allowable file size
 	long long	bytes_to_write;		// total number of bytes to write
+	GenMap *	genmap;			// block generations (if tracked)
 
 	/**
 	 * allocate and initialize a write operation descriptor.
@@ -57,6 +55,7 @@ struct writeParms {
 		block_size = bsize;
 		file_length = file_size;
 		bytes_to_write = 0;
+		genmap = 0;
 		to_directory = dir;
 		create_opts = O_CREAT;
 		if (!loadgen_rewrite)
@@ -68,10 +67,53 @@ struct writeParms {
 
 		// allocate the thread status structure for it
 		// 	and add it to the known threads list
-		new ThreadStatus( name, this );
+		thread = new ThreadStatus( name, this );
 	}
 };
 
+/*
+ * what the threads of createData_d are defined from
+ *	(so that more of them can be defined as they are wanted)
+ */
+static char *createTo = 0;		// directory (or file or device)
+static long long createOffset = 0;	// base offset for all file I/O
+static bool createOneFile = false;	// a file or device (not a directory)
+
+/**
+ * define a thread for createData_d
+ *
+ * @param i		number of the thread
+ *
+ * @return		true if it could be defined
+ */
+static bool defineCreator( int i ) {
+	// come up with a name for this thread
+	char *threadname = 0;
+	asprintf( &threadname, "Creator Thread %04d", i );
+
+	struct writeParms *parms;
+	// come up with a target directory for this thread
+	if (createOneFile)
+		parms = new writeParms( threadname, loadgen_bsize, loadgen_fsize, createTo );
+	else {
+		char *dir = 0;
+		asprintf( &dir, "%s/Thread%04d", createTo, i );
+		parms = new writeParms( threadname, loadgen_bsize, loadgen_fsize, dir );
+	}
+
+	if (threadname == 0 || parms == 0) {
+		loadgen_problem = "malloc failure";
+		return false;
+	}
+	parms->offset = createOffset;
+	parms->single_file = createOneFile;
+	parms->thread->target = createTo;
+	parms->bytes_to_write = loadgen_data;
+	parms->aio_depth = (loadgen_depth > 0) ? loadgen_depth.load() : 1;
+	// FIX on shutdown we should reclaim threadname, to_directory
+	return true;
+}
+
 /**
  * Multi-Thread creation load generator:
  * -	creates a sub-directory per thread under target directory
@@ -103,36 +145,18 @@ createData_d( char *to, int threads ) {
 		} 
 	}
 	
-	// pre-define all of the threads we will EVER need
-	int max_threads = threads ? threads : MAX_THREADS;
-	for( int i = 0; i < max_threads; i++ ) {
-		// come up with a name for this thread
-		char *threadname = 0;
-		asprintf( &threadname, "Creator Thread %04d", i );
-
-		struct writeParms *parms;
-		// come up with a target directory for this thread
-		if (onefile)
- 			parms = new writeParms( threadname, loadgen_bsize, loadgen_fsize, to );
-		else {
-			char *dir = 0;
-			asprintf( &dir, "%s/Thread%04d", to, i );
- 			parms = new writeParms( threadname, loadgen_bsize, loadgen_fsize, dir );
-		}
-		
-		if (threadname == 0 || parms == 0) {
-			loadgen_problem = "malloc failure";
+	// define the threads we are to start with, and (if we were not
+	//	told how many we may have) the rest as they are wanted
+	createTo = to;
+	createOffset = offset;
+	createOneFile = onefile;
+	for( int i = 0; i < threads; i++ )
+		if (!defineCreator( i ))
 			return RESOURCE_ERROR;
-		}
-		parms->offset = offset;
-		parms->single_file = onefile;
-		parms->bytes_to_write = loadgen_data;
-		parms->aio_depth = (loadgen_depth > 0) ? loadgen_depth : 1;
-		// FIX on shutdown we should reclaim threadname, to_directory
-	}
 	
 	// we just configure them, the thread manager does the real work
-	return ThreadStatus::manageThreads( createDataThread, threads );
+	return ThreadStatus::manageThreads( createDataThread, threads, 64*1024,
+			threads ? 0 : defineCreator );
 }
 
 /**
@@ -182,8 +206,9 @@ createData_l( char **list ) {
 
 		parms->offset = offset;
 		parms->single_file = single_file;
+		parms->thread->target = list[i];
 		parms->bytes_to_write = loadgen_data;
-		parms->aio_depth = (loadgen_depth > 0) ? loadgen_depth : 1;
+		parms->aio_depth = (loadgen_depth > 0) ? loadgen_depth.load() : 1;
 		threads++;
 		// FIX on shutdown we should reclaim threadname, to_directory
 	}
@@ -214,7 +239,8 @@ void *createDataThread( void *sts ) {
 	// announce that we are starting up
 	mystatus->running = true;	// now set in manageThreads to avoid a race
 	if (loadgen_debug & D_THREADS) {
-		fprintf(stderr, "# Starting %s in %s\n", mystatus->name, myparms->to_directory );
+		fprintf(stderr, "# Starting %s in %s on cpu %d\n", mystatus->name,
+			myparms->to_directory, sched_getcpu() );
 	}
 
 	// make sure we can create our target directory
@@ -253,15 +279,15 @@ void *createDataThread( void *sts ) {
 
 
 	// create a succession of files
-	for( done = 0; status == 0 && mystatus->enable; done++ ) {
-		// see if a general shutdown has been declared
-		if (loadgen_shutdown)
-			break;
-
+	for( done = 0; status == 0; done++ ) {
 		// see if we have hit the maximum # of files to create
 		if (maxfiles > 0 && done >= maxfiles)
 			break;
 
+		// see if we have been parked or a general shutdown declared
+		if (!mystatus->keepRunning())
+			break;
+
 		// figure out the name of the next file 
 		if (!myparms->single_file) {
 			char *fullpath;
@@ -283,19 +309,23 @@ void *createDataThread( void *sts ) {
 		}
 	}
 
+	// a directory may be flushed once we are done with it
+	if (status == 0 && done > 0)
+		status |= flushDirectory( myparms->to_directory, &mystatus->stats );
+
   	// free the pattern data buffers
 	delete bufset;
 
   exit:	
-	// update my exit status and exit
-	mystatus->running = false;
-	mystatus->exit_status = status;
 	if (loadgen_debug & D_THREADS || done != maxfiles) {
 		// it is often useful to know what caused each thread to exit
 		fprintf(stderr, "# Shutting down %s (en=%d, cnt=%d/%d, sts=%x, stop=%d)\n",
-			mystatus->name, mystatus->enable,
-			done, loadgen_maxfiles, status, loadgen_shutdown );
+			mystatus->name, mystatus->enable.load(),
+			done, loadgen_maxfiles, status, loadgen_shutdown.load() );
 	}
+
+	// report my exit status and exit
+	mystatus->exiting( status );
 	pthread_exit(0);
 }
 
@@ -309,8 +339,10 @@ writeFile( const char *filename, 		// output file to create
 	perfstats *stats ) {			// performance counters
 	// generate a fully qualified path and create the file
 	int fd = -1;
+	bool v2_rewrite = loadgen_rewrite && loadgen_format == 2;
 	if (!loadgen_simulate) {
-		int opts = O_WRONLY | myparms->create_opts;
+		// version 2 rewrites pick up where the last generation left off
+		int opts = (v2_rewrite ? O_RDWR : O_WRONLY) | myparms->create_opts;
 		fd = open( filename, opts, 0666 );
 		if (fd < 0) {
 			fprintf(stderr,"Unable to create output file %s: %s\n", 
@@ -323,13 +355,42 @@ writeFile( const char *filename, 		// output file to create
 	// create a local (this test only) parameter set
 	struct writeParms parms = *myparms;
 
+	// a version 2 file that is being rewritten keeps its block layout,
+	//	and the new data is one generation newer than the old
+	unsigned long generation = 1;
+	if (v2_rewrite && fd >= 0) {
+		long len = loadgen_direct ? loadgen_direct : DEFAULT_ALIGNMENT;
+		char *prev = 0;
+		if (posix_memalign( (void **) &prev, len, len ) == 0 &&
+		    pread( fd, prev, len, parms.offset ) >= header_size() &&
+		    checkHeaders( prev, 0, parms.offset ) == 0) {
+			parms.block_size = get_block_size( prev );
+			if (parms.file_length == 0)
+				parms.file_length = get_file_size( prev );
+			generation = get_generation( prev ) + 1;
+		}
+		free( prev );
+	}
+
 	// come up with a block size
+	//	(in version 2, random writes are whole blocks)
+	if (parms.block_size == 0 && loadgen_format == 2 && loadgen_rand_blk)
+		parms.block_size = loadgen_rand_blk;
 	if (parms.block_size == 0) {
 		parms.block_size = choose_bsize( loadgen_direct, bufs->size );
 	}
 
+	// a rewritten file's blocks must fit in our buffers
+	if (parms.block_size > bufs->size) {
+		fprintf(stderr, "Unable to rewrite %s: bsize=%d exceeds buffer size %d\n",
+			filename, parms.block_size, bufs->size );
+		loadgen_problem = "illegal block size";
+		if (fd >= 0)
+			close( fd );
+		return OUTPUT_FILE_ERROR;
+	}
+
 	// come up with a file length
-	unsigned long long fsize = myparms->file_length;
 	if (parms.file_length == 0) {
 		struct stat statb;
 		fstat( fd, &statb );
@@ -345,30 +406,76 @@ writeFile( const char *filename, 		// output file to create
 	if (parms.file_length == 0)
 		parms.file_length = choose_file_size( parms.block_size );
 
+	// version 2 files (but not devices) keep a map of the generation
+	//	in which each block was written, and a rewrite is always
+	//	newer than anything previously written to the file
+	struct stat statb;
+	if (loadgen_format == 2 && fd >= 0 && fstat( fd, &statb ) == 0 && S_ISREG(statb.st_mode)) {
+		long long blocks = (parms.file_length + parms.block_size - 1) / parms.block_size;
+		GenMap *map = loadgen_rewrite ? GenMap::load( filename ) : 0;
+		if (map && (map->bsize != parms.block_size || map->blocks != blocks)) {
+			delete map;
+			map = 0;
+		}
+		if (map == 0)
+			map = new GenMap( parms.block_size, blocks );
+		else if (map->newest() >= generation)
+			generation = map->newest() + 1;
+		map->generation = generation;
+		parms.genmap = map;
+	}
+
 	// now create header(s) for the chosen file size
 	for( int i = 0; i < bufs->buffers; i++ ) {
 		fileHeader( bufs->buffer(i), filename, parms.file_length );
+		setGeneration( bufs->buffer(i), generation );
+	}
+
+	// random rewrites leave holes, which must still be within the file
+	if (v2_rewrite && loadgen_rand_blk && fd >= 0) {
+		struct stat statb;
+		fstat( fd, &statb );
+		if (S_ISREG(statb.st_mode) && statb.st_size < parms.offset + parms.file_length)
+			ftruncate( fd, parms.offset + parms.file_length );
 	}
 		
 	// figure out how much data to write
 	if (parms.bytes_to_write == 0)
-		parms.bytes_to_write = fsize;
+		parms.bytes_to_write = parms.file_length;
 
 	// announce our intentions
-	if (loadgen_debug & D_FILES) 
-		fprintf(stderr, "# %s output file %s, bsize=%d, depth=%d, fsize=%lld/%lld\n", 
+	if (loadgen_debug & D_FILES) {
+		char gen[40] = "";
+		if (generation > 1)
+			snprintf( gen, sizeof gen, ", generation=%lu", generation );
+		fprintf(stderr, "# %s output file %s, bsize=%d, depth=%d, fsize=%lld/%lld%s\n", 
 			loadgen_rewrite ? "rewriting" : "creating",
-			filename, parms.block_size, parms.aio_depth, parms.bytes_to_write, parms.file_length);
+			filename, parms.block_size, parms.aio_depth, parms.bytes_to_write, parms.file_length,
+			gen );
+	}
 
 	// fill it full of data
 	stats->file_done();	// bump the file count
 	int status;
+	struct flushState flush;
+	flushOpen( &flush, fd, filename );
 	// FIX .. AIO depth=
-	status = singleWrite(filename, bufs, &parms, fd,  stats);
+	status = singleWrite(filename, bufs, &parms, fd, &flush, stats);
 
-	// close the file and free its name
+	// close the file and record the generations we wrote
+	if (status == 0)
+		status |= flushClose( &flush, stats );
 	if (!loadgen_simulate)
 		close( fd );
+	if (parms.genmap) {
+		if (!parms.genmap->save( filename )) {
+			fprintf(stderr, "Unable to save generation map for %s: %s\n",
+				filename, strerror( errno ));
+			loadgen_problem = "generation map write error";
+			status |= OUTPUT_FILE_ERROR;
+		}
+		delete parms.genmap;
+	}
 
 	return( status );
 }
@@ -380,6 +487,7 @@ writeFile( const char *filename, 		// output file to create
  * @param	Bufset for the pattern data write buffers
  * @param	writeParms for this file
  * @param	open write file descriptor
+ * @param	flush state for the file
  * @param	perfstats structure to accumulate results
  *
  * @return	status
@@ -388,6 +496,7 @@ int singleWrite(const char *filename,
 		Bufset *bufs,
 		struct writeParms *parms,
 		int fd,
+		struct flushState *flush,
 		perfstats *stats) {
 	int status = 0;
 	long long len = 0;
@@ -396,13 +505,24 @@ int singleWrite(const char *filename,
 
 	lseek( fd, offset, SEEK_SET );
 	while( len < parms->bytes_to_write && status == 0 ) {
+		// if we have been parked, we resume right here (at the same
+		//	offset), but a shutdown abandons the rest of the file
+		if (!parms->thread->keepRunning())
+			break;
+
 		// update the header for the next block
 		blockHeader( buf,  parms->block_size, offset );
 
 		// do the write
-		int bytes = (loadgen_rand_blk) ? loadgen_rand_blk : parms->block_size;
+		//	(version 2 blocks must be written whole, to remain verifiable)
+		int bytes = (loadgen_rand_blk && loadgen_format != 2) ? 
+				loadgen_rand_blk.load() : parms->block_size;
 		status |= timed_write( fd, buf, bytes, stats, filename, offset );
+		if (status == 0)
+			status |= flushWrite( flush, offset, bytes, stats );
 		len += bytes;
+		if (status == 0 && parms->genmap)
+			parms->genmap->written( (offset - parms->offset) / parms->block_size );
 
 		// see if we should do a seek
 		if (loadgen_rand_blk && loadgen_rewrite) {
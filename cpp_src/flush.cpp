@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "loadgen.h"
+#include "perfstats.h"
+#include "flush.h"
+#include "debug.h"
+
+static int policy = FLUSH_NONE;	// what we flush, and when
+static long long every = 0;	// bytes (or blocks) between flushes
+static bool dataOnly = false;	// fdatasync rather than fsync
+static const char *spec = 0;	// as it was given to us
+
+/*
+ * parse a flush policy
+ */
+const char *setFlush( const char *s ) {
+	spec = s;
+	const char *comma = strchr( s, ',' );
+	if (comma) {
+		if (strcmp( comma, ",data" ) != 0)
+			return "Malformed flush policy";
+		dataOnly = true;
+	}
+	size_t len = comma ? (size_t) (comma - s) : strlen( s );
+
+	const char *count = 0;
+	if (len == 5 && strncmp( s, "close", 5 ) == 0)
+		policy = FLUSH_CLOSE;
+	else if (len == 3 && strncmp( s, "dir", 3 ) == 0)
+		policy = FLUSH_DIR;
+	else if (strncmp( s, "bytes:", 6 ) == 0) {
+		policy = FLUSH_BYTES;
+		count = &s[6];
+	} else if (strncmp( s, "blocks:", 7 ) == 0) {
+		policy = FLUSH_BLOCKS;
+		count = &s[7];
+	} else if (strncmp( s, "range:", 6 ) == 0) {
+		policy = FLUSH_RANGE;
+		count = &s[6];
+	} else
+		return "Malformed flush policy";
+
+	// those that are periodic need a period
+	if (count) {
+		char num[32];
+		size_t n = s + len - count;
+		if (n == 0 || n >= sizeof num)
+			return "Invalid flush interval";
+		strncpy( num, count, n );
+		num[n] = 0;
+		every = (policy == FLUSH_BLOCKS) ? atoll( num ) : getSizeSpec( num );
+		if (every <= 0)
+			return "Invalid flush interval";
+	}
+
+	// sync_file_range never flushes the metadata anyway
+	if (policy == FLUSH_RANGE && dataOnly)
+		return "Range flushes are always data only";
+	return 0;
+}
+
+/*
+ * the flush policy in effect
+ */
+int flushPolicy() {
+	return policy;
+}
+
+/*
+ * describe the flush policy
+ */
+const char *flushSpec() {
+	return spec ? spec : "none";
+}
+
+/*
+ * time a flush, and note any failure
+ *
+ * @param	return from the flush
+ * @param	when it started
+ * @param	what was being flushed
+ * @param	statistics to update
+ * @return	status bits
+ */
+static int flushed( int ret, hires_time_t start, const char *name, perfstats *s ) {
+	if (ret != 0) {
+		fprintf(stderr, "flush error on %s: %s\n", name, strerror( errno ));
+		loadgen_problem = "file flush error";
+		return OUTPUT_FILE_ERROR;
+	}
+	hires_time_t elapsed = hires_time() - start;
+	s->flush_done( elapsed );
+	if (loadgen_debug & D_WRITES)
+		fprintf(stderr, "# Flush %s (%lluus)\n", name, elapsed );
+	return 0;
+}
+
+/*
+ * force a file's data (and, unless asked not to, metadata) out
+ */
+static int syncFile( int fd ) {
+	return dataOnly ? fdatasync( fd ) : fsync( fd );
+}
+
+/*
+ * start flushing a file
+ */
+void flushOpen( struct flushState *f, int fd, const char *name ) {
+	f->fd = fd;
+	f->name = name;
+	f->bytes = 0;
+	f->blocks = 0;
+	f->lo = f->hi = 0;
+	f->prevLo = f->prevHi = 0;
+}
+
+/*
+ * note a write, and flush if it is time
+ */
+int flushWrite( struct flushState *f, long long offset, int len, perfstats *s ) {
+	if (policy != FLUSH_BYTES && policy != FLUSH_BLOCKS && policy != FLUSH_RANGE)
+		return 0;
+
+	// note how much (and, for range flushes, where) we have written
+	if (f->bytes == 0 || offset < f->lo)
+		f->lo = offset;
+	if (f->bytes == 0 || offset + len > f->hi)
+		f->hi = offset + len;
+	f->bytes += len;
+	f->blocks++;
+	if ((policy == FLUSH_BLOCKS ? f->blocks : f->bytes) < every)
+		return 0;
+
+	f->bytes = 0;
+	f->blocks = 0;
+	if (f->fd < 0)
+		return 0;
+	hires_time_t start = hires_time();
+	if (policy != FLUSH_RANGE)
+		return flushed( syncFile( f->fd ), start, f->name, s );
+
+	// wait for the previous range to be written, and start on this one
+	int ret = 0;
+	if (f->prevHi > f->prevLo)
+		ret = sync_file_range( f->fd, f->prevLo, f->prevHi - f->prevLo,
+			SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE|SYNC_FILE_RANGE_WAIT_AFTER );
+	if (ret == 0)
+		ret = sync_file_range( f->fd, f->lo, f->hi - f->lo, SYNC_FILE_RANGE_WRITE );
+	f->prevLo = f->lo;
+	f->prevHi = f->hi;
+	return flushed( ret, start, f->name, s );
+}
+
+/*
+ * flush whatever the policy calls for before a file is closed
+ */
+int flushClose( struct flushState *f, perfstats *s ) {
+	if (f->fd < 0)
+		return 0;
+	hires_time_t start = hires_time();
+	if (policy == FLUSH_CLOSE)
+		return flushed( syncFile( f->fd ), start, f->name, s );
+	if (policy != FLUSH_RANGE)
+		return 0;
+
+	// a streaming writer leaves nothing dirty behind it
+	long long lo = f->prevLo, hi = f->prevHi;
+	if (f->bytes > 0) {
+		if (hi <= lo || f->lo < lo)
+			lo = f->lo;
+		if (f->hi > hi)
+			hi = f->hi;
+	}
+	if (hi <= lo)
+		return 0;
+	int ret = sync_file_range( f->fd, lo, hi - lo,
+		SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE|SYNC_FILE_RANGE_WAIT_AFTER );
+	return flushed( ret, start, f->name, s );
+}
+
+/*
+ * flush a directory (and the files in it) that a thread is done with
+ */
+int flushDirectory( const char *dir, perfstats *s ) {
+	if (policy != FLUSH_DIR || loadgen_simulate)
+		return 0;
+
+	hires_time_t start = hires_time();
+	int fd = open( dir, O_RDONLY );
+	if (fd < 0)
+		return flushed( -1, start, dir, s );
+
+	// a file or device is flushed on its own
+	struct stat statb;
+	if (fstat( fd, &statb ) == 0 && !S_ISDIR(statb.st_mode)) {
+		int ret = syncFile( fd );
+		close( fd );
+		return flushed( ret, start, dir, s );
+	}
+
+	// otherwise, all of its files and then the directory itself
+	int ret = 0;
+	DIR *d = fdopendir( dup( fd ));
+	if (d == 0)
+		ret = -1;
+	while( struct dirent *e = (d && ret == 0) ? readdir( d ) : 0 ) {
+		// (not every file system fills in the type)
+		if (e->d_type == DT_UNKNOWN) {
+			struct stat sb;
+			if (fstatat( fd, e->d_name, &sb, 0 ) != 0 || !S_ISREG(sb.st_mode))
+				continue;
+		} else if (e->d_type != DT_REG)
+			continue;
+		int f = openat( fd, e->d_name, O_RDONLY );
+		if (f < 0 || syncFile( f ) != 0)
+			ret = -1;
+		if (f >= 0)
+			close( f );
+	}
+	if (d)
+		closedir( d );
+	if (ret == 0)
+		ret = fsync( fd );
+	int err = errno;
+	close( fd );
+	errno = err;
+	return flushed( ret, start, dir, s );
+}
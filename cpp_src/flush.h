@@ -0,0 +1,103 @@
+/*
+ * flush (durability) policies
+ *
+ *	--sync makes every write synchronous (O_DSYNC), which is not how
+ *	databases and backup tools actually write.  A flush policy
+ *	instead writes normally, and periodically forces the data out:
+ *
+ *		bytes:N		fsync after every N bytes written to a file
+ *		blocks:N	fsync after every N writes to a file
+ *		close		fsync each file before it is closed
+ *		dir		fsync every file in a thread's directory (and
+ *				the directory itself) when it is done with it
+ *		range:N		stream the data out with sync_file_range,
+ *				starting writeback of each N bytes as they
+ *				are written, and waiting for the previous N
+ *				(which keeps the dirty memory for each file
+ *				under 2N, and the throughput smooth)
+ *
+ *	A ",data" suffix (e.g. bytes:1m,data) uses fdatasync instead of
+ *	fsync.  The time each flush takes goes into a latency histogram
+ *	of its own (reported on a DETAIL flush line), rather than into
+ *	the write latencies.
+ */
+
+#define	FLUSH_NONE	0
+#define	FLUSH_BYTES	1
+#define	FLUSH_BLOCKS	2
+#define	FLUSH_CLOSE	3
+#define	FLUSH_DIR	4
+#define	FLUSH_RANGE	5
+
+class perfstats;
+
+/**
+ * what a writer needs to remember about a file it is flushing
+ */
+struct flushState {
+	int		fd;		///< file being written (-1 if simulated)
+	const char *	name;		///< its name (for error messages)
+	long long	bytes;		///< bytes written since the last flush
+	long		blocks;		///< writes since the last flush
+	long long	lo, hi;		///< (range) extent not yet submitted
+	long long	prevLo, prevHi;	///< (range) extent being written back
+};
+
+/**
+ * parse a flush policy
+ *
+ * @param	policy[:count][,data]
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *setFlush( const char *spec );
+
+/**
+ * the flush policy in effect
+ *
+ * @return	FLUSH_NONE ... FLUSH_RANGE
+ */
+int flushPolicy();
+
+/**
+ * describe the flush policy (for the options dump)
+ */
+const char *flushSpec();
+
+/**
+ * start flushing a (newly opened) file
+ *
+ * @param	state to initialize
+ * @param	open file descriptor (-1 if simulated)
+ * @param	name of the file
+ */
+void flushOpen( struct flushState *f, int fd, const char *name );
+
+/**
+ * note a (successful) write, and flush if it is time
+ *
+ * @param	state of the file
+ * @param	offset of the write
+ * @param	length of the write
+ * @param	statistics to update
+ * @return	status bits
+ */
+int flushWrite( struct flushState *f, long long offset, int len, perfstats *s );
+
+/**
+ * flush whatever the policy calls for before a file is closed
+ *
+ * @param	state of the file
+ * @param	statistics to update
+ * @return	status bits
+ */
+int flushClose( struct flushState *f, perfstats *s );
+
+/**
+ * flush a directory (and the files in it) that a thread is done with
+ *	(or a file or device, if that is what the thread was given)
+ *
+ * @param	name of the directory
+ * @param	statistics to update
+ * @return	status bits
+ */
+int flushDirectory( const char *dir, perfstats *s );
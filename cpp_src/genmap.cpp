@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "genmap.h"
+
+/**
+ * A generation map records the generation each block of a file
+ * was last written in.  On disk, it is a header line followed
+ * by one line per run of blocks with the same generation:
+ *
+ *	#GEN bsize=4096 blocks=4096
+ *	4000 3
+ *	96 2
+ */
+#define	GEN_FORMAT	"#GEN bsize=%ld blocks=%lld\n"
+#define	RUN_FORMAT	"%lld %u\n"
+
+/**
+ * name of the map for a data file (.<name>.gen in the same directory)
+ *
+ * @param	name of the data file
+ * @return	malloc'd name of the map file
+ */
+static char *mapname( const char *filename ) {
+	const char *s = strrchr( filename, '/' );
+	int dirlen = s ? s + 1 - filename : 0;
+
+	char *name = 0;
+	if (asprintf( &name, "%.*s.%s.gen", dirlen, filename, &filename[dirlen] ) < 0)
+		return 0;
+	return name;
+}
+
+/**
+ * allocate a map with no known generations
+ *
+ * @param	block size of the file
+ * @param	number of blocks in the file
+ */
+GenMap::GenMap( long blocksize, long long numblocks ) {
+	bsize = blocksize;
+	blocks = numblocks;
+	generation = 1;
+	_gens = (unsigned *) calloc( numblocks > 0 ? numblocks : 1, sizeof *_gens );
+	if (_gens == 0)
+		blocks = 0;
+}
+
+GenMap::~GenMap() {
+	free( _gens );
+}
+
+/**
+ * read in the map for a file
+ *
+ * @param	name of the data file
+ * @return	new map (or NULL if there is no usable map)
+ */
+GenMap *GenMap::load( const char *filename ) {
+	char *name = mapname( filename );
+	FILE *f = name ? fopen( name, "r" ) : 0;
+	free( name );
+	if (f == 0)
+		return 0;
+
+	long bsize;
+	long long blocks;
+	GenMap *map = 0;
+	if (fscanf( f, GEN_FORMAT, &bsize, &blocks ) == 2 && bsize > 0 && blocks > 0) {
+		map = new GenMap( bsize, blocks );
+
+		// expand the runs, which must exactly cover the file
+		long long b = 0;
+		long long count;
+		unsigned gen;
+		while( b < map->blocks && fscanf( f, RUN_FORMAT, &count, &gen ) == 2 ) {
+			if (count <= 0 || count > map->blocks - b)
+				break;
+			while( count-- > 0 )
+				map->_gens[b++] = gen;
+		}
+		if (b != blocks || map->blocks != blocks) {
+			delete map;
+			map = 0;
+		}
+	}
+
+	fclose( f );
+	return map;
+}
+
+/**
+ * save the map for a file
+ *	(writing a new copy and renaming it over the old one)
+ *
+ * @param	name of the data file
+ * @return	true if it was successfully written
+ */
+bool GenMap::save( const char *filename ) {
+	char *name = mapname( filename );
+	char *temp = 0;
+	if (name == 0 || asprintf( &temp, "%s.new", name ) < 0) {
+		free( name );
+		return false;
+	}
+
+	bool ok = false;
+	FILE *f = fopen( temp, "w" );
+	if (f) {
+		fprintf( f, GEN_FORMAT, bsize, blocks );
+		for( long long b = 0; b < blocks; ) {
+			long long run = 1;
+			while( b + run < blocks && _gens[b + run] == _gens[b] )
+				run++;
+			fprintf( f, RUN_FORMAT, run, _gens[b] );
+			b += run;
+		}
+		ok = (fclose( f ) == 0) && rename( temp, name ) == 0;
+	}
+	if (!ok)
+		unlink( temp );
+
+	free( temp );
+	free( name );
+	return ok;
+}
+
+/**
+ * remove the map for a (deleted) file
+ *
+ * @param	name of the data file
+ */
+void GenMap::remove( const char *filename ) {
+	char *name = mapname( filename );
+	if (name)
+		unlink( name );
+	free( name );
+}
+
+/**
+ * @return	highest generation recorded for any block
+ */
+unsigned long GenMap::newest() {
+	unsigned long max = 0;
+	for( long long b = 0; b < blocks; b++ )
+		if (_gens[b] > max)
+			max = _gens[b];
+	return max;
+}
@@ -0,0 +1,79 @@
+/*
+ * per-file write generation maps
+ *
+ *	Every (version 2) block records the generation in which it
+ *	was written, but a block that was never rewritten (because the
+ *	write was lost) looks perfectly healthy on its own.  The map
+ *	remembers which generation each block of a file should be
+ *	in, so verification can detect stale (or impossible) blocks.
+ *
+ *	Maps are kept (run-length encoded, in text) in a hidden file
+ *	(.<name>.gen) beside the data file they describe.
+ */
+class GenMap {
+    public:
+	long bsize;		///< block size of the file
+	long long blocks;	///< number of blocks in the file
+	unsigned long generation;	///< generation now being written
+
+	/**
+	 * constructor for a map with no known generations
+	 *
+	 * @param	block size of the file
+	 * @param	number of blocks in the file
+	 */
+	GenMap( long blocksize, long long numblocks );
+
+	~GenMap();
+
+	/**
+	 * read in the map for a file
+	 *
+	 * @param	name of the data file
+	 * @return	new map (or NULL if there is no usable map)
+	 */
+	static GenMap *load( const char *filename );
+
+	/**
+	 * save the map for a file
+	 *
+	 * @param	name of the data file
+	 * @return	true if it was successfully written
+	 */
+	bool save( const char *filename );
+
+	/**
+	 * remove the map for a (deleted) file
+	 *
+	 * @param	name of the data file
+	 */
+	static void remove( const char *filename );
+
+	/**
+	 * @return	highest generation recorded for any block
+	 */
+	unsigned long newest();
+
+	/**
+	 * expected generation of a block
+	 *
+	 * @param	block number
+	 * @return	generation (0 if unknown or never written)
+	 */
+	unsigned long expected( long long block ) {
+		return (block >= 0 && block < blocks) ? _gens[block] : 0;
+	}
+
+	/**
+	 * note that a block has been written in the current generation
+	 *
+	 * @param	block number
+	 */
+	void written( long long block ) {
+		if (block >= 0 && block < blocks)
+			_gens[block] = generation;
+	}
+
+    private:
+	unsigned *_gens;	///< generation of each block
+};
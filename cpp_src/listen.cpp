@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+
+#include "loadgen.h"
+#include "bufset.h"
+#include "listen.h"
+
+// most addresses a name can resolve to (e.g. IPv4 and IPv6)
+#define	MAX_SOCKETS	8
+
+static int socks[MAX_SOCKETS];	// our listening sockets
+static int numSocks = 0;
+static pid_t sessions[MAX_SESSIONS];	// sessions still running
+static int numSessions = 0;
+
+/*
+ * open the listening sockets
+ *
+ * @param	[ADDRESS:]PORT (with an IPv6 address in brackets)
+ * @return	NULL if OK, else a description of the problem
+ */
+static const char *openSockets( const char *spec ) {
+	char *copy = strdup( spec );
+	char *host = 0;
+	char *port = copy;
+	char *colon = strrchr( copy, ':' );
+	if (colon) {
+		*colon = 0;
+		host = copy;
+		port = colon + 1;
+		if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+			host[strlen(host) - 1] = 0;
+			host++;
+		}
+		if (host[0] == 0 || strcmp( host, "*" ) == 0)
+			host = 0;
+	}
+
+	struct addrinfo hints, *list = 0;
+	memset( &hints, 0, sizeof hints );
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	int err = getaddrinfo( host, port, &hints, &list );
+	if (err) {
+		fprintf(stderr, "Unable to resolve %s: %s\n", spec, gai_strerror( err ));
+		free( copy );
+		return "Invalid listen address";
+	}
+
+	for( struct addrinfo *a = list; a && numSocks < MAX_SOCKETS; a = a->ai_next ) {
+		int fd = socket( a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol );
+		if (fd < 0)
+			continue;
+		int on = 1;
+		setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on );
+		if (a->ai_family == AF_INET6)	// (the IPv4 socket is separate)
+			setsockopt( fd, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof on );
+		if (bind( fd, a->ai_addr, a->ai_addrlen ) != 0 || listen( fd, SOMAXCONN ) != 0) {
+			fprintf(stderr, "Unable to listen on %s: %s\n", spec, strerror( errno ));
+			close( fd );
+			continue;
+		}
+		socks[numSocks++] = fd;
+	}
+	freeaddrinfo( list );
+	free( copy );
+	return numSocks > 0 ? 0 : "Unable to listen for masters";
+}
+
+/*
+ * collect the sessions that have finished
+ */
+static void reap() {
+	int status;
+	pid_t pid;
+	while( (pid = waitpid( -1, &status, WNOHANG )) > 0 ) {
+		for( int i = 0; i < numSessions; i++ )
+			if (sessions[i] == pid) {
+				sessions[i] = sessions[--numSessions];
+				break;
+			}
+		fprintf(stderr, "# session %d ended (status %d)\n", (int) pid,
+			WIFEXITED( status ) ? WEXITSTATUS( status ) : -WTERMSIG( status ));
+	}
+}
+
+/*
+ * start a session for a new connection
+ *
+ * @return	true if we are the session (rather than the listener)
+ */
+static bool session( int conn, const struct sockaddr_storage *addr, socklen_t len ) {
+	char who[NI_MAXHOST + NI_MAXSERV + 2] = "?";
+	char host[NI_MAXHOST], serv[NI_MAXSERV];
+	if (getnameinfo( (const struct sockaddr *) addr, len, host, sizeof host,
+			serv, sizeof serv, NI_NUMERICHOST|NI_NUMERICSERV ) == 0)
+		snprintf( who, sizeof who, "%s:%s", host, serv );
+
+	if (numSessions >= MAX_SESSIONS) {
+		static const char busy[] = "Arg Master. Too many sessions!\n";
+		ssize_t sent = write( conn, busy, sizeof busy - 1 );
+		(void) sent;	// (if not, they will see the close)
+		close( conn );
+		fprintf(stderr, "# refused session from %s\n", who );
+		return false;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0)
+		return true;
+	if (pid < 0)
+		fprintf(stderr, "Unable to fork session for %s: %s\n", who, strerror( errno ));
+	else {
+		sessions[numSessions++] = pid;
+		fprintf(stderr, "# session %d from %s\n", (int) pid, who );
+	}
+	close( conn );
+	return false;
+}
+
+/*
+ * accept connections from masters, forking a session for each
+ */
+const char *listenFor( const char *spec ) {
+	const char *problem = openSockets( spec );
+	if (problem)
+		return problem;
+
+	// signals are just more events
+	sigset_t signals, previous;
+	sigemptyset( &signals );
+	sigaddset( &signals, SIGCHLD );
+	sigaddset( &signals, SIGTERM );
+	sigaddset( &signals, SIGINT );
+	sigaddset( &signals, SIGHUP );
+	sigprocmask( SIG_BLOCK, &signals, &previous );
+	int sigfd = signalfd( -1, &signals, SFD_CLOEXEC );
+	int epfd = epoll_create1( EPOLL_CLOEXEC );
+	if (sigfd < 0 || epfd < 0) {
+		fprintf(stderr, "Unable to create listener: %s\n", strerror( errno ));
+		return "Unable to listen for masters";
+	}
+
+	struct epoll_event ev;
+	memset( &ev, 0, sizeof ev );
+	ev.events = EPOLLIN;
+	ev.data.fd = sigfd;
+	epoll_ctl( epfd, EPOLL_CTL_ADD, sigfd, &ev );
+	for( int i = 0; i < numSocks; i++ ) {
+		ev.data.fd = socks[i];
+		epoll_ctl( epfd, EPOLL_CTL_ADD, socks[i], &ev );
+	}
+
+	// buffers the sessions inherit, rather than each faulting in its own
+	//	(the listener takes no other switches, so this is sized for
+	//	the default block sizes)
+	if (!bufsetPool( SESSION_POOL ))
+		fprintf(stderr, "# unable to allocate (%d byte) session buffer pool\n", SESSION_POOL );
+
+	fprintf(stderr, "# listening on %s\n", spec );
+	bool stopping = false;
+	while( !stopping || numSessions > 0 ) {
+		struct epoll_event events[MAX_SOCKETS + 1];
+		int n = epoll_wait( epfd, events, MAX_SOCKETS + 1, -1 );
+		if (n < 0 && errno != EINTR) {
+			fprintf(stderr, "Listener wait failed: %s\n", strerror( errno ));
+			break;
+		}
+
+		for( int e = 0; e < n; e++ ) {
+			int fd = events[e].data.fd;
+
+			// a signal: a session has ended, or it is time to stop
+			if (fd == sigfd) {
+				struct signalfd_siginfo si;
+				if (read( sigfd, &si, sizeof si ) != sizeof si)
+					continue;
+				if (si.ssi_signo == SIGCHLD) {
+					reap();
+					continue;
+				}
+				if (!stopping) {
+					fprintf(stderr, "# listener shutting down (%d sessions)\n", numSessions );
+					for( int i = 0; i < numSocks; i++ )
+						close( socks[i] );	// (which removes them from the epoll set)
+					numSocks = 0;
+					stopping = true;
+				}
+				for( int i = 0; i < numSessions; i++ )
+					kill( sessions[i], SIGTERM );
+				continue;
+			}
+
+			// a new connection
+			struct sockaddr_storage addr;
+			socklen_t len = sizeof addr;
+			int conn = accept( fd, (struct sockaddr *) &addr, &len );
+			if (conn < 0)
+				continue;
+			if (!session( conn, &addr, len ))
+				continue;
+
+			// we are the session, whose master is on stdin/stdout
+			close( epfd );
+			close( sigfd );
+			for( int i = 0; i < numSocks; i++ )
+				close( socks[i] );
+			sigprocmask( SIG_SETMASK, &previous, 0 );
+			dup2( conn, 0 );
+			dup2( conn, 1 );
+			if (conn > 1)
+				close( conn );
+			return 0;
+		}
+	}
+
+	exit( 0 );
+}
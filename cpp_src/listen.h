@@ -0,0 +1,39 @@
+/*
+ * a built-in zombie server
+ *
+ *	A zombie has normally been an xinetd service (see loadzombie),
+ *	which starts a new loadgen for each connection from the master.
+ *	With --listen=[ADDRESS:]PORT, loadgen accepts the connections
+ *	itself: an epoll loop watches the listening socket(s) and a
+ *	signalfd, and forks a session for each connection, with the
+ *	connection as its standard input and output.  The session then
+ *	runs the usual "Yes Master?" protocol, exactly as if xinetd had
+ *	started it.
+ *
+ *	Everything loadgen knows about a run (its options, profile,
+ *	sweep and statistics) belongs to the process, so sessions are
+ *	processes of their own, but they are forked from a listener
+ *	that has already been loaded and initialized (rather than
+ *	exec'd), and any number of masters can have sessions at once
+ *	(up to MAX_SESSIONS).  The listener also fills a pool of I/O
+ *	buffer memory (see bufsetPool) before it accepts anything, which
+ *	the sessions' buffer sets are carved from.  A SIGTERM (or SIGINT or SIGHUP) to the
+ *	listener stops it accepting connections and shuts down its
+ *	sessions, and it exits when they have all finished.
+ */
+
+// most sessions we will run at once
+#define	MAX_SESSIONS	256
+
+// bytes of (already touched) buffer memory each session inherits
+#define	SESSION_POOL	(32*1024*1024)
+
+/**
+ * accept connections from masters, forking a session for each
+ *
+ * @param	[ADDRESS:]PORT to listen on
+ * @return	(only in a session) NULL, or (in the listener)
+ *		a description of the problem that prevented it
+ *		from listening
+ */
+const char *listenFor( const char *spec );
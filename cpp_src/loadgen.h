@@ -1,7 +1,10 @@
+#include <atomic>
+#include <time.h>
+
 /**
  * global information for demo load generation utility
  */
-extern bool loadgen_shutdown;	///< shut down the load generation
+extern std::atomic<bool> loadgen_shutdown;	///< shut down the load generation
 extern bool loadgen_simulate;	///< only pretend to generate data
 extern bool loadgen_delete;	///< remove files/directories after verification
 extern bool loadgen_read;	///< read back existing files
@@ -11,15 +14,25 @@ extern bool loadgen_halt;	///< stop on error
 extern bool loadgen_sync;	///< synchronous writes
 extern bool loadgen_zombie;	///< we are under remote control
 extern bool loadgen_once;	///< only one directory per thread
+extern bool loadgen_unique;	///< write un-dedupable data
 extern int  loadgen_direct;	///< direct buffer alignment
-extern int  loadgen_rand_blk;	///< random access r/w block size
-extern int  loadgen_bsize;	///< read/write block size
+extern std::atomic<int> loadgen_rand_blk;	///< random access r/w block size
+extern std::atomic<int> loadgen_bsize;	///< read/write block size
 extern long long loadgen_fsize;	///< size of each created file
 extern long long loadgen_data;	///< amount of data to read or write
-extern long long loadgen_rate;	///< target generation rate
-extern int  loadgen_update;	///< performance update interval
+extern std::atomic<long long> loadgen_rate;	///< target generation rate (per thread)
+extern int  loadgen_update;	///< performance update interval (ms)
 extern int  loadgen_maxfiles;	///< maximum number of files to create
-extern int  loadgen_depth;	///< number of concurrent I/O operations
+extern std::atomic<int> loadgen_depth;	///< number of concurrent I/O operations
+extern std::atomic<int> loadgen_mix;	///< percentage of mixed operations that are reads (-1: not mixed)
+extern int  loadgen_format;	///< pattern data format to write
+extern int  loadgen_split;	///< workers per file or device (for reads)
+extern bool loadgen_interleave;	///< split reads by block rather than range
+extern bool loadgen_steal;	///< idle workers take files from busy ones
+extern int loadgen_procs;	///< worker processes (if more than one)
+extern const char *loadgen_affinity;	///< worker placement policy (if any)
+extern int  loadgen_breakdown;	///< per-target/thread report breakdowns
+extern double loadgen_compress;	///< target compression ratio (if any)
 extern const char *loadgen_tag;	///< output tag
 extern const char *loadgen_problem;	///< the problem that took us down
 
@@ -28,15 +41,42 @@ extern int createData_d( char *to, int threads );
 extern int createData_l( char **list );
 extern int readData_d( const char *from, char *to_dir, int threads );
 extern int readData_l( char **list );
+extern int mixData_d( char *to, int threads );
+extern int mixData_l( char **list );
+
+/**
+ * have all of the mixed workers that have been started created
+ * (or extended) the files they work on
+ *
+ * @return	true if they are all generating the mixed load
+ */
+extern bool mixReady();
 
 /**
  * see if we have been told to change the number of threads we are running
+ *	(carrying out, and acknowledging, commands to change the load)
  *
- * @param maxSeconds (maximum number of seconds to wait)
+ * @param deadline	(CLOCK_MONOTONIC) time after which to stop waiting
  *
  * @return	-1 or a new thread count
  */
-extern int changeNumThreads( int maxSeconds );
+extern int changeNumThreads( const struct timespec *deadline );
+
+/**
+ * see if there is still someone who can tell us to change the
+ * number of threads (a master to whom we have not disconnected)
+ *
+ * @return	true if further commands are possible
+ */
+extern bool acceptingCommands();
+
+/**
+ * is there a command we have read, but not yet carried out
+ *	(so that a poll on stdin would not tell us about it)
+ *
+ * @return	true if changeNumThreads would return it at once
+ */
+extern bool commandPending();
 
 /**
  * check to make sure that a directory exists and is writeable
@@ -47,14 +87,27 @@ extern int changeNumThreads( int maxSeconds );
  */
 extern const char *checkdir( const char *name, bool create );
 extern bool checkdev( const char *name );
+extern long long devsize( const char *name );
 extern bool checkfile( const char *name );
 
 long long getSizeSpec( const char * );
+int getTimeSpec( const char * );
 long long getOffset( char *n );
 
+// largest number of threads we can be asked to run
+//	if we aren't told how many threads to create, we
+//	should expect commands to change this number over
+//	the course of the session (and define the threads
+//	as they are wanted).
+#define	MAX_THREADS	4096
+
+// block size for mixed read/write operations (if none is specified)
+#define	DEFAULT_MIX_BSIZE	4096
+
 // exit status bits
 #define 	SOURCE_DIRECTORY	0x01	///< could not find/open
 #define		TARGET_DIRECTORY	0x02	///< could not find/create
 #define		INPUT_FILE_ERROR	0x04	///< could not open/read
 #define		OUTPUT_FILE_ERROR	0x08	///< could not create/write
+#define		CHILD_ERROR		0x40	///< a child failed
 #define		RESOURCE_ERROR		0x80	///< memory, threads, ...
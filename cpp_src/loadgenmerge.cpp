@@ -0,0 +1,377 @@
+/**
+ * module:	loadgenmerge.cpp
+ *<P>
+ * purpose:
+ *	merge the REPORT lines from any number of loadgen logs (e.g. the
+ *	standard outputs of every zombie in a horde) into one time series
+ *
+ *	The logs are read in a single pass, as a merge of their (time
+ *	ordered) reports, so memory does not grow with their length.
+ *	Each report is put in the interval (of the common timeline, on
+ *	multiples of the interval since the epoch, as loadgen does) in
+ *	which it ended, and once every log has moved past an interval,
+ *	its bytes are summed, its latency buckets are added together and
+ *	its percentiles are taken from the combined buckets (rather than
+ *	averaging each log's percentiles).  A REPORT line is printed for
+ *	each interval, and a TOTAL line for the whole run.
+ *
+ *	The logs give only the number of operations in each latency
+ *	bucket (us_buckets=), so the limits of the buckets are loadgen's
+ *	own (from perfstats.h), and percentiles are the upper limits of
+ *	the buckets in which they fall (or, beyond the last limit, the
+ *	last limit).
+ *
+ * usage:
+ *	loadgen-merge [-c] [-i interval] [-t tag] file ...
+ *
+ *	-c	comma separated values (with a header line) rather than
+ *		REPORT lines
+ *	-i	interval (seconds, or milliseconds with an ms suffix) of
+ *		the merged reports (default 5, like loadgen)
+ *	-t	tag for the merged reports (default merged)
+ *
+ *	a file named - is the standard input
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "perfstats.h"
+#include "report.h"
+
+// loadgen's latency buckets, the last of them unlimited
+#define	NUM_BUCKETS	(int) (sizeof latency_limits / sizeof latency_limits[0])
+
+// how long (ms) after the end of its interval a report can be made
+#define	REPORT_DELAY	50
+
+/*
+ * a log, and the next report we have read from it
+ */
+struct source {
+	const char *name;
+	FILE	*f;
+	char	*line;		///< (getline) buffer
+	size_t	size;		///< size of the buffer
+	bool	have;		///< there is a report (below)
+	long long bin;		///< (end of) the interval it belongs in
+	int	threads;
+	long long bytes;
+	long long buckets[NUM_BUCKETS];
+	long long lastBin;	///< the last interval it contributed to
+	int	binThreads;	///< its threads (at the end of) that interval
+};
+
+/*
+ * the sum of the reports in an interval (or the whole run)
+ */
+struct interval {
+	long long bin;		///< interval (ms since the epoch / interval)
+	int	sources;	///< logs with reports in it
+	int	threads;	///< their threads
+	long long reports;
+	long long bytes;
+	long long buckets[NUM_BUCKETS];
+};
+
+static long long width = 5000;		// interval (ms)
+static const char *tag = "merged";
+static bool csv = false;
+static long long late = 0;		// reports for intervals already printed
+static long long skipped = 0;		// unparseable reports
+
+/*
+ * when (ms since the epoch) a report was made
+ *
+ * @return	the time, or -1 if it has none
+ */
+static long long when( const char *line ) {
+	// mktime is expensive, so we only use it once an hour
+	static char lastHour[14];	// MM/DD/YYYY HH
+	static long long hourMs = -1;
+
+	const char *d = reportField( line, "date" );
+	const char *t = reportField( line, "time" );
+	int min, sec, ms = 0;
+	if (d == 0 || t == 0 || d[10] != ' ' || t[2] != ':' ||
+	    sscanf( &t[3], "%d:%d", &min, &sec ) != 2)
+		return -1;
+	if (t[8] == '.')		// (an update interval in ms)
+		ms = atoi( &t[9] );
+
+	if (memcmp( lastHour, d, 10 ) != 0 || memcmp( &lastHour[11], t, 2 ) != 0) {
+		struct tm tm;
+		memset( &tm, 0, sizeof tm );
+		if (sscanf( d, "%d/%d/%d", &tm.tm_mon, &tm.tm_mday, &tm.tm_year ) != 3 ||
+		    sscanf( t, "%d", &tm.tm_hour ) != 1)
+			return -1;
+		tm.tm_mon -= 1;
+		tm.tm_year -= 1900;
+		tm.tm_isdst = -1;
+		time_t secs = mktime( &tm );
+		if (secs < 0)
+			return -1;
+		hourMs = secs * 1000LL;
+		memcpy( lastHour, d, 10 );
+		memcpy( &lastHour[11], t, 2 );
+	}
+	return hourMs + (min * 60 + sec) * 1000LL + ms;
+}
+
+/*
+ * read the next report from a log
+ *
+ * @return	false if it has no more
+ */
+static bool next( struct source *s ) {
+	s->have = false;
+	while( getline( &s->line, &s->size, s->f ) > 0 ) {
+		const char *r = strstr( s->line, "REPORT date=" );
+		if (r == 0)
+			continue;
+
+		long long t = when( r );
+		const char *threads = reportField( r, "threads" );
+		if (t < 0 || threads == 0) {
+			skipped++;
+			continue;
+		}
+		long long delay = width / 4 < REPORT_DELAY ? width / 4 : REPORT_DELAY;
+		s->bin = (t - delay + width - 1) / width;
+		s->threads = atoi( threads );
+
+		const char *v = reportField( r, "bytes" );
+		s->bytes = v ? atoll( v ) : 0;
+		memset( s->buckets, 0, sizeof s->buckets );
+		if ((v = reportField( r, "us_buckets" )))
+			for( int i = 0; i < NUM_BUCKETS; i++ ) {
+				char *end;
+				s->buckets[i] = strtoll( v, &end, 10 );
+				if (*end != ',')
+					break;
+				v = end + 1;
+			}
+		s->have = true;
+		return true;
+	}
+	if (ferror( s->f ))
+		fprintf(stderr, "loadgen-merge: error reading %s: %s\n", s->name, strerror( errno ));
+	return false;
+}
+
+/*
+ * a latency percentile, from the combined buckets
+ */
+static long percentile( const struct interval *v, double pct ) {
+	long long total = 0;
+	for( int i = 0; i < NUM_BUCKETS; i++ )
+		total += v->buckets[i];
+	if (total == 0)
+		return 0;
+
+	long long want = (long long) ((pct * total + 99.999) / 100);
+	long long seen = 0;
+	for( int i = 0; i < NUM_BUCKETS; i++ ) {
+		seen += v->buckets[i];
+		if (seen >= want)
+			return (latency_limits[i] > 0) ? latency_limits[i] : latency_limits[i-1];
+	}
+	return latency_limits[NUM_BUCKETS - 2];
+}
+
+/*
+ * print a merged interval (or the totals)
+ *
+ * @param	REPORT (an interval) or TOTAL
+ * @param	the sums
+ * @param	how long (ms) they took
+ */
+static void print( const char *kind, const struct interval *v, long long ms ) {
+	// (and localtime is expensive, so it too is only used once an hour)
+	static time_t hourStart = -1;
+	static struct tm hourTm;
+	time_t secs = (time_t) ((v->bin * width) / 1000);
+	long into = (long) (secs - hourStart) + hourTm.tm_min * 60 + hourTm.tm_sec;
+	if (hourStart < 0 || secs < hourStart || into >= 3600) {
+		hourTm = *localtime( &secs );
+		hourStart = secs;
+		into = hourTm.tm_min * 60 + hourTm.tm_sec;
+	}
+	struct tm now = hourTm;
+	now.tm_min = into / 60;
+	now.tm_sec = into % 60;
+	struct tm *tm = &now;
+	char stamp[64];
+	if (width % 1000)
+		snprintf( stamp, sizeof stamp, "%02d/%02d/%04d%c%02d:%02d:%02d.%03lld",
+			tm->tm_mon+1, tm->tm_mday, tm->tm_year+1900, csv ? ',' : ' ',
+			tm->tm_hour, tm->tm_min, tm->tm_sec, (v->bin * width) % 1000 );
+	else
+		snprintf( stamp, sizeof stamp, "%02d/%02d/%04d%c%02d:%02d:%02d",
+			tm->tm_mon+1, tm->tm_mday, tm->tm_year+1900, csv ? ',' : ' ',
+			tm->tm_hour, tm->tm_min, tm->tm_sec );
+	long long rate = ms > 0 ? v->bytes * 1000 / ms : 0;
+
+	if (csv) {
+		printf("%s,%s,%s,%d,%d,%lld,%lld,%.3f,%lld,%ld,%ld,%ld,%ld",
+			kind, stamp, tag, v->sources, v->threads, v->reports, v->bytes,
+			ms / 1000.0, rate, percentile( v, 50 ), percentile( v, 90 ),
+			percentile( v, 99 ), percentile( v, 99.9 ));
+		for( int i = 0; i < NUM_BUCKETS; i++ )
+			printf(",%lld", v->buckets[i] );
+		printf("\n");
+		return;
+	}
+
+	char *space = strchr( stamp, ' ' );
+	*space = 0;
+	printf("%s date=%s time=%s tag=%s sources=%d threads=%d reports=%lld bytes=%lld ",
+		kind, stamp, space + 1, tag, v->sources, v->threads, v->reports, v->bytes );
+	if (ms % 1000)
+		printf("seconds=%.3f ", ms / 1000.0 );
+	else
+		printf("seconds=%lld ", ms / 1000 );
+	printf("rate=%lld p50_us=%ld p90_us=%ld p99_us=%ld p999_us=%ld us_buckets=",
+		rate, percentile( v, 50 ), percentile( v, 90 ), percentile( v, 99 ),
+		percentile( v, 99.9 ));
+	for( int i = 0; i < NUM_BUCKETS; i++ )
+		printf( i == 0 ? "%lld" : ",%lld", v->buckets[i] );
+	printf("\n");
+}
+
+/*
+ * add an interval into the totals
+ */
+static void accumulate( struct interval *total, const struct interval *v ) {
+	if (total->reports == 0)
+		total->bin = v->bin;
+	if (v->threads > total->threads)
+		total->threads = v->threads;
+	total->reports += v->reports;
+	total->bytes += v->bytes;
+	for( int i = 0; i < NUM_BUCKETS; i++ )
+		total->buckets[i] += v->buckets[i];
+}
+
+static void usage( const char *cmd ) {
+	fprintf(stderr, "Usage: %s [-c] [-i interval] [-t tag] file ...\n", cmd);
+	fprintf(stderr, "\t-c ... comma separated values\n");
+	fprintf(stderr, "\t-i ... interval of the merged reports (seconds, or #ms)\n");
+	fprintf(stderr, "\t-t ... tag for the merged reports\n");
+	exit( 2 );
+}
+
+int main( int argc, char **argv ) {
+	int c;
+	while( (c = getopt( argc, argv, "ci:t:" )) != -1 ) {
+		switch( c ) {
+		    case 'c':
+			csv = true;
+			break;
+		    case 'i': {
+			char *end;
+			double n = strtod( optarg, &end );
+			width = (long long) (strcmp( end, "ms" ) == 0 ? n : n * 1000);
+			if (width <= 0 || (*end && strcmp( end, "ms" ) != 0))
+				usage( argv[0] );
+			break;
+		    }
+		    case 't':
+			tag = optarg;
+			break;
+		    default:
+			usage( argv[0] );
+		}
+	}
+	int numSources = argc - optind;
+	if (numSources < 1)
+		usage( argv[0] );
+
+	// open the logs, and find each one's first report
+	struct source *sources = (struct source *) calloc( numSources, sizeof (struct source) );
+	for( int i = 0; i < numSources; i++ ) {
+		struct source *s = &sources[i];
+		s->name = argv[optind + i];
+		s->f = strcmp( s->name, "-" ) == 0 ? stdin : fopen( s->name, "r" );
+		if (s->f == 0) {
+			fprintf(stderr, "%s: unable to open %s: %s\n", argv[0], s->name, strerror( errno ));
+			exit( 1 );
+		}
+		s->lastBin = -1;
+		next( s );
+	}
+
+	if (csv) {
+		printf("kind,date,time,tag,sources,threads,reports,bytes,seconds,rate,p50_us,p90_us,p99_us,p999_us");
+		for( int i = 0; i < NUM_BUCKETS; i++ )
+			if (latency_limits[i] > 0)
+				printf(",le_%ldus", latency_limits[i] );
+			else
+				printf(",gt_%ldus", latency_limits[i-1] );
+		printf("\n");
+	}
+
+	// merge the reports, an interval at a time
+	struct interval current, total;
+	memset( &current, 0, sizeof current );
+	memset( &total, 0, sizeof total );
+	current.bin = -1;
+	long long lastBin = -1;
+	for(;;) {
+		// the log whose next report is earliest
+		struct source *s = 0;
+		for( int i = 0; i < numSources; i++ )
+			if (sources[i].have && (s == 0 || sources[i].bin < s->bin))
+				s = &sources[i];
+
+		// every log has moved past the current interval
+		if (current.reports > 0 && (s == 0 || s->bin > current.bin)) {
+			print( "REPORT", &current, width );
+			accumulate( &total, &current );
+			lastBin = current.bin;
+			memset( &current, 0, sizeof current );
+		}
+		if (s == 0)
+			break;
+
+		if (s->bin <= lastBin) {	// (an out of order log)
+			late++;
+			next( s );
+			continue;
+		}
+
+		// add it to the interval
+		current.bin = s->bin;
+		current.reports++;
+		current.bytes += s->bytes;
+		for( int i = 0; i < NUM_BUCKETS; i++ )
+			current.buckets[i] += s->buckets[i];
+		if (s->lastBin != current.bin) {
+			current.sources++;
+			current.threads += s->threads;
+		} else	// (it reports more often than we do)
+			current.threads += s->threads - s->binThreads;
+		s->lastBin = current.bin;
+		s->binThreads = s->threads;
+		next( s );
+	}
+
+	// the whole run (from the start of its first interval)
+	if (total.reports > 0) {
+		total.sources = 0;
+		for( int i = 0; i < numSources; i++ )
+			if (sources[i].lastBin >= 0)
+				total.sources++;
+		long long ms = (lastBin - total.bin + 1) * width;
+		total.bin = lastBin;
+		print( "TOTAL", &total, ms );
+	}
+	fflush( stdout );
+	if (late || skipped)
+		fprintf(stderr, "%s: ignored %lld out of order and %lld unparseable reports\n",
+			argv[0], late, skipped );
+	exit( total.reports > 0 ? 0 : 1 );
+}
@@ -0,0 +1,290 @@
+/**
+ * module:	loadgenstat.cpp
+ *<P>
+ * purpose:
+ *	dump (or follow) the live statistics that a running loadgen
+ *	publishes in its (--stats-shm=) shared memory segment
+ *
+ *	Snapshots are taken by copying the segment under its sequence
+ *	lock, so sampling costs no system calls and never delays the
+ *	load generator.  Each snapshot is printed as a STATS line
+ *	(describing the most recent reporting interval, followed by
+ *	totals since loadgen started), optionally followed by a
+ *	THREAD line (ending with its name) for each of the threads.
+ *
+ * usage:
+ *	loadgen-stat [-f] [-t] [-i ms] name
+ *
+ *	-f	follow: wait for the segment to appear, and print a new
+ *		snapshot after each update, until loadgen shuts down
+ *	-t	include per-thread statistics
+ *	-i	how often (in ms) to check for updates when following
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "statshm.h"
+
+static const char *stateNames[] = { "starting", "running", "parked", "exited", "done" };
+
+static int segFd = -1;			// the open segment
+static void *segMap = 0;		// our mapping of it
+static size_t segSize = 0;		// how much of it we have mapped
+static char *snap = 0;			// our most recent snapshot
+static size_t snapSize = 0;		// size of the snapshot buffer
+
+/*
+ * open and map the segment
+ *
+ * @param	name (of a shm object) or path (of a file)
+ * @return	true if it exists and has been initialized
+ */
+static bool attach( const char *name ) {
+	if (strchr( name, '/' )) {
+		segFd = open( name, O_RDONLY|O_CLOEXEC );
+	} else {
+		char shmname[256];
+		snprintf( shmname, sizeof shmname, "/%s", name );
+		segFd = shm_open( shmname, O_RDONLY|O_CLOEXEC, 0 );
+	}
+	if (segFd < 0)
+		return false;
+
+	// it may have been created, but not yet initialized
+	struct stat st;
+	if (fstat( segFd, &st ) == 0 && (size_t) st.st_size >= sizeof (struct statsSegment)) {
+		segMap = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, segFd, 0 );
+		if (segMap != MAP_FAILED) {
+			segSize = st.st_size;
+			struct statsSegment *seg = (struct statsSegment *) segMap;
+			if (seg->magic == STATS_MAGIC)
+				return true;
+			munmap( segMap, segSize );
+		}
+		segMap = 0;
+	}
+	close( segFd );
+	segFd = -1;
+	return false;
+}
+
+/*
+ * re-map the segment (after it has grown)
+ */
+static bool remap() {
+	struct stat st;
+	if (fstat( segFd, &st ) != 0)
+		return false;
+	void *p = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, segFd, 0 );
+	if (p == MAP_FAILED)
+		return false;
+	munmap( segMap, segSize );
+	segMap = p;
+	segSize = st.st_size;
+	return true;
+}
+
+/*
+ * take a consistent snapshot of the segment
+ *
+ * @return	the snapshot (or NULL if the segment is unusable)
+ */
+static struct statsSegment *snapshot() {
+	struct statsSegment *seg = (struct statsSegment *) segMap;
+	for( int tries = 1; ; tries++ ) {
+		// updates are brief, so a writer that never finishes has died
+		if (tries > 1000) {
+			if (tries > 2000)
+				return 0;
+			struct timespec pause = { 0, 1000000 };
+			nanosleep( &pause, 0 );
+		}
+
+		uint64_t before = seg->seq.load( std::memory_order_acquire );
+		if (before & 1)			// an update is in progress
+			continue;
+
+		// the segment may have grown since we mapped it
+		size_t need = seg->hdr_size + (size_t) seg->num_threads * seg->thread_size;
+		if (need > segSize) {
+			if (seg->seq.load( std::memory_order_acquire ) != before)
+				continue;
+			if (!remap())
+				return 0;
+			seg = (struct statsSegment *) segMap;
+			continue;
+		}
+
+		if (snapSize < segSize) {
+			snap = (char *) realloc( snap, segSize );
+			if (snap == 0)
+				return 0;
+			snapSize = segSize;
+		}
+		memcpy( snap, segMap, need );
+
+		// if nothing changed while we were copying, we're done
+		std::atomic_thread_fence( std::memory_order_acquire );
+		if (seg->seq.load( std::memory_order_relaxed ) == before)
+			return (struct statsSegment *) snap;
+	}
+}
+
+/*
+ * estimate a latency percentile from bucket counts
+ *	(the same way loadgen does for its machine readable reports)
+ */
+static long long percentile( const struct statsSegment *s, const struct statsCounters *c, double pct ) {
+	long long total = 0;
+	for( unsigned i = 0; i < s->num_buckets; i++ )
+		total += c->buckets[i];
+	if (total == 0)
+		return 0;
+
+	long long want = (long long) ((pct * total + 99.999) / 100);
+	long long seen = 0;
+	for( unsigned i = 0; i < s->num_buckets; i++ ) {
+		seen += c->buckets[i];
+		if (seen >= want)
+			return (s->limits[i] > 0) ? s->limits[i] : c->max_us;
+	}
+	return c->max_us;
+}
+
+static const char *stateName( uint32_t state ) {
+	return state < sizeof stateNames / sizeof stateNames[0] ? stateNames[state] : "unknown";
+}
+
+/*
+ * print out a snapshot
+ */
+static void print( const struct statsSegment *s, bool threads ) {
+	time_t secs = s->update_us / 1000000;
+	struct tm *tm = localtime( &secs );
+	long long usecs = s->update_us - s->start_us;
+	const struct statsCounters *c = &s->interval;
+
+	printf("STATS date=%02d/%02d/%04d time=%02d:%02d:%02d.%03lld tag=%s pid=%d state=%s updates=%llu ",
+		tm->tm_mon+1, tm->tm_mday, tm->tm_year+1900, tm->tm_hour, tm->tm_min, tm->tm_sec,
+		(long long) (s->update_us / 1000) % 1000, s->tag, s->pid, stateName( s->state ),
+		(unsigned long long) s->updates );
+	printf("threads=%u parked=%u exited=%u ", s->running, s->parked, s->exited );
+	printf("bytes=%lld seconds=%.3f rate=%lld reads=%lld writes=%lld files=%lld ",
+		(long long) c->bytes, usecs / 1000000.0,
+		usecs > 0 ? (long long) (c->bytes * 1000000 / usecs) : 0LL,
+		(long long) c->reads, (long long) c->writes, (long long) c->files );
+	printf("p50_us=%lld p99_us=%lld us_buckets=",
+		percentile( s, c, 50 ), percentile( s, c, 99 ));
+	for( unsigned i = 0; i < s->num_buckets; i++ )
+		printf( i == 0 ? "%lld" : ",%lld", (long long) c->buckets[i] );
+
+	c = &s->totals;
+	printf(" total_bytes=%lld total_reads=%lld total_writes=%lld total_files=%lld min_us=%lld max_us=%lld\n",
+		(long long) c->bytes, (long long) c->reads, (long long) c->writes,
+		(long long) c->files, (long long) c->min_us, (long long) c->max_us );
+
+	for( unsigned i = 0; threads && i < s->num_threads; i++ ) {
+		const struct statsThread *t = statsSlot( (struct statsSegment *) s, i );
+		c = &t->totals;
+		// (names can contain blanks, so the name comes last)
+		printf("THREAD %u state=%s bytes=%lld reads=%lld writes=%lld files=%lld min_us=%lld max_us=%lld p99_us=%lld name=%s\n",
+			i, stateName( t->state ), (long long) c->bytes,
+			(long long) c->reads, (long long) c->writes, (long long) c->files,
+			(long long) c->min_us, (long long) c->max_us, percentile( s, c, 99 ), t->name );
+	}
+	fflush( stdout );
+}
+
+static void usage( const char *cmd ) {
+	fprintf(stderr, "Usage: %s [-f] [-t] [-i ms] name\n", cmd);
+	fprintf(stderr, "\t-f ... follow (until loadgen shuts down)\n");
+	fprintf(stderr, "\t-t ... include per-thread statistics\n");
+	fprintf(stderr, "\t-i ... how often to check for updates (ms)\n");
+	exit( 2 );
+}
+
+int main( int argc, char **argv ) {
+	bool follow = false;
+	bool threads = false;
+	long interval = 100;		// ms
+
+	int c;
+	while( (c = getopt( argc, argv, "fti:" )) != -1 ) {
+		switch( c ) {
+		    case 'f':
+			follow = true;
+			break;
+		    case 't':
+			threads = true;
+			break;
+		    case 'i':
+			interval = atol( optarg );
+			if (interval <= 0)
+				usage( argv[0] );
+			break;
+		    default:
+			usage( argv[0] );
+		}
+	}
+	if (optind != argc - 1)
+		usage( argv[0] );
+	const char *name = argv[optind];
+
+	struct timespec nap;
+	nap.tv_sec = interval / 1000;
+	nap.tv_nsec = (interval % 1000) * 1000000;
+
+	// find the segment (waiting for it to appear if we are following)
+	while( !attach( name )) {
+		if (!follow) {
+			fprintf(stderr, "%s: no loadgen statistics in %s\n", argv[0], name);
+			exit( 1 );
+		}
+		nanosleep( &nap, 0 );
+	}
+
+	struct statsSegment *s = snapshot();
+	if (s == 0 || s->version != STATS_VERSION) {
+		fprintf(stderr, "%s: unusable statistics segment %s\n", argv[0], name);
+		exit( 1 );
+	}
+	if (!follow) {
+		print( s, threads );
+		exit( 0 );
+	}
+
+	// print each new update (and our final state)
+	uint64_t updates = 0;
+	uint32_t state = STATS_STARTING;
+	for(;;) {
+		if (s->updates != updates || (s->state == STATS_DONE && state != STATS_DONE)) {
+			if (s->updates > 0 || s->state == STATS_DONE)
+				print( s, threads );
+			updates = s->updates;
+			state = s->state;
+		}
+		if (state == STATS_DONE)
+			break;
+
+		// make sure there is still someone updating it
+		if (kill( s->pid, 0 ) != 0 && errno == ESRCH) {
+			fprintf(stderr, "%s: loadgen (pid %d) is no longer running\n", argv[0], s->pid);
+			exit( 1 );
+		}
+
+		nanosleep( &nap, 0 );
+		if ((s = snapshot()) == 0) {
+			fprintf(stderr, "%s: unable to re-map %s\n", argv[0], name);
+			exit( 1 );
+		}
+	}
+	exit( 0 );
+}
@@ -37,6 +37,18 @@
 #include <sys/stat.h>
 
 #include "loadgen.h"
+#include "affinity.h"
+#include "report.h"
+#include "statshm.h"
+#include "profile.h"
+#include "autotune.h"
+#include "sweep.h"
+#include "workerprocs.h"
+#include "flush.h"
+#include "wal.h"
+#include "listen.h"
+#include "submaster.h"
+#include "pattern.h"
 #include "debug.h"
 #include "perfstats.h"
 
@@ -70,14 +82,35 @@ static struct myargs {
 	{"threads",	't',		"initial number of up-load threads" },
 	{"update",	'u',		"update interval" },
 	{"rate",	'R',		"target bandwidth" },
+	{"profile",	'p',		"load profile (file or in-line)" },
+	{"slo",		'L',		"latency SLO for a saturation search" },
 	{"direct",	'A',		"alignment" },
 	{"depth",	'a',		"concurrent ops" },
 	{"random",	'z',		"block size" },
+	{"mix",		'x',		"percentage of operations that are reads" },
+	{"wal",		'g',		"record=#,group=#,window=time,committers=#" },
+	{"sweep",	'Y',		"parameters to sweep" },
+	{"matrix",	'Q',		"file for sweep results" },
+	{"listen",	'N',		"[address:]port on which to accept masters" },
+	{"children",	'c',		"number of local children, or host:port list" },
+	{"format",	'F',		"pattern data format (1 or 2)" },
+	{"unique",	'U',		0	 },
+	{"compress-ratio",'C',		"target compression ratio" },
+	{"split",	'X',		"workers per file or device" },
+	{"interleave",	'I',		0	 },
+	{"steal",	'W',		0	 },
+	{"procs",	'K',		"worker processes" },
+	{"affinity",	'P',		"compact, scatter, nodes:list or cpus:list" },
+	{"report-format",'f',		"text, json, csv or binary" },
+	{"report-file",	'O',		"file for reports" },
+	{"breakdown",	'B',		"targets, threads or all" },
+	{"stats-shm",	'm',		"shared memory segment for live statistics" },
 	{"read",	'r',		0	 },
 	{"verify",	'v',		0	 },
 	{"rewrite",	'w',		0	 },
 	{"delete",	'd',		0	 },
 	{"sync",	's',		0	 },
+	{"flush",	'e',		"bytes:#, blocks:#, close, dir or range:# (,data)" },
 	{"halt",	'H',		0	 },
 	{"simulate",	'S',		0 	 },
 	{"onceonly",	'1',		0	 },
@@ -106,21 +139,31 @@ bool loadgen_read = false;	///< read back existing files
 bool loadgen_verify = false;	///< verify generated directories/files
 bool loadgen_delete = false;	///< delete files/dirs after verification
 bool loadgen_rewrite = false;	///< rewrite already existing files
-bool loadgen_shutdown = false;	///< shut down the load generation
+std::atomic<bool> loadgen_shutdown(false);	///< shut down the load generation
 bool loadgen_simulate = false;	///< only simulate load generation
 bool loadgen_halt = false;	///< halt on error
 bool loadgen_sync = false;	///< synchronous writes
 bool loadgen_zombie = false;	///< under remote control
 bool loadgen_once = false;	///< only one directory per thread
-int  loadgen_bsize = 0;		///< read/write block size
-long long loadgen_rate = 0;	///< target write/read bandwidth
+bool loadgen_unique = false;	///< write un-dedupable data
+double loadgen_compress = 0;	///< target compression ratio (if any)
+int  loadgen_split = 1;		///< workers per file or device (for reads)
+bool loadgen_interleave = false;	///< split reads by block rather than range
+bool loadgen_steal = false;	///< idle workers take files from busy ones
+int  loadgen_procs = 1;		///< worker processes (if more than one)
+const char *loadgen_affinity = 0;	///< worker placement policy (if any)
+int  loadgen_breakdown = 0;	///< per-target/thread report breakdowns
+std::atomic<int> loadgen_bsize(0);	///< read/write block size
+std::atomic<long long> loadgen_rate(0);	///< target write/read bandwidth
 long long loadgen_fsize = 0;	///< size of each created file
 long long loadgen_data = 0;	///< how much data to read or write
-int loadgen_update = 5;		///< statistics update interval in seconds
+int loadgen_update = 5000;	///< statistics update interval (ms)
 int loadgen_maxfiles = 0;	///< maximum number of files to create
 int  loadgen_direct = 0;	///< direct buffer alignment
-int  loadgen_rand_blk = 0;	///< random access r/w block size
-int  loadgen_depth = 0;		///< number of concurrent I/O operations
+std::atomic<int> loadgen_rand_blk(0);	///< random access r/w block size
+std::atomic<int> loadgen_depth(0);	///< number of concurrent I/O operations
+std::atomic<int> loadgen_mix(-1);	///< percentage of mixed operations that are reads
+int  loadgen_format = 1;	///< pattern data format to write
 const char *loadgen_tag = 0;	///< tag for this zombie
 const char *loadgen_problem = 0;	///< the problem that shut us down
 
@@ -163,6 +206,16 @@ main( int argc, const char **argv) {
 	// default generation parameters
 	char  	   **tgts = 0;		// directories where we create/verify data
 	const char  *src = 0;		// directory from which we copy data
+	const char  *rpt_format = 0;	// format for reports
+	const char  *rpt_file = 0;	// file for reports
+	const char  *stats_shm = 0;	// segment for live statistics
+	const char  *profile = 0;	// load profile
+	const char  *slo = 0;		// latency SLO (for a saturation search)
+	const char  *sweep = 0;		// parameter sweep
+	const char  *matrix = 0;	// file for sweep results
+	const char  *children = 0;	// children (of a sub-master)
+	const char  *flush = 0;		// flush policy
+	const char  *wal = 0;		// WAL (group commit) workload
 	int         threads = 1;	// number of load generation threads
 	int 	    targets = 0;	// number of specified targets
 
@@ -177,6 +230,17 @@ main( int argc, const char **argv) {
 	char *ap = getArgSpec( myargs );
 	int opt_index = 0;
 
+	// a listener forks a session for each master that connects,
+	//	which then gets its arguments like any other zombie
+	if (argc == 2 && strncmp( argv[1], "--listen=", 9 ) == 0) {
+		loadgen_problem = listenFor( &argv[1][9] );
+		if (loadgen_problem) {
+			fprintf(stderr, " %s\n", loadgen_problem);
+			exit( -1 );
+		}
+		argc = 1;
+	}
+
 	// if there were no command line arguments get them from stdin
 	if (argc < 2) {
 		argv = read_args();
@@ -226,7 +290,14 @@ main( int argc, const char **argv) {
 			continue;
 
 		    case 'u':
-			loadgen_update = atoi( optarg );
+			loadgen_update = getTimeSpec( optarg );
+			if (loadgen_update <= 0) {
+				loadgen_problem = "Invalid update interval";
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
 			continue;
 			
 		    case 't':
@@ -273,6 +344,28 @@ main( int argc, const char **argv) {
 		    	loadgen_sync = true;
 			continue;
 
+		    case 'g':
+			wal = optarg;
+			loadgen_problem = setWal( optarg );
+			if (loadgen_problem) {
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
+		    case 'e':
+			flush = optarg;
+			loadgen_problem = setFlush( optarg );
+			if (loadgen_problem) {
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
 		    case 'S':
 		    	loadgen_simulate = true;
 			continue;
@@ -289,6 +382,155 @@ main( int argc, const char **argv) {
 		    	loadgen_rate = getSizeSpec(optarg);
 			continue;
 
+		    case 'x':
+			loadgen_mix = atoi(optarg);
+			if (loadgen_mix < 0 || loadgen_mix > 100) {
+				loadgen_problem = "Invalid read/write mix";
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
+		    case 'Y':
+			sweep = optarg;
+			loadgen_problem = setSweep( optarg );
+			if (loadgen_problem) {
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
+		    case 'Q':
+			matrix = optarg;
+			continue;
+
+		    case 'F':
+		    	loadgen_format = atoi(optarg);
+			continue;
+
+		    case 'p':
+			profile = optarg;
+			loadgen_problem = setProfile( optarg );
+			if (loadgen_problem) {
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
+		    case 'L':
+			slo = optarg;
+			loadgen_problem = setSLO( optarg );
+			if (loadgen_problem) {
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
+		    case 'U':
+		    	loadgen_unique = true;
+			continue;
+
+		    case 'X':
+		    	loadgen_split = atoi(optarg);
+			if (loadgen_split < 1)
+				loadgen_split = 1;
+			continue;
+
+		    case 'I':
+		    	loadgen_interleave = true;
+			continue;
+
+		    case 'W':
+		    	loadgen_steal = true;
+			continue;
+
+		    case 'K':
+			loadgen_procs = atoi(optarg);
+			if (loadgen_procs < 1 || loadgen_procs > MAX_PROCS) {
+				loadgen_problem = "Invalid number of worker processes";
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
+		    case 'f':
+			rpt_format = optarg;
+			continue;
+
+		    case 'O':
+			rpt_file = optarg;
+			continue;
+
+		    case 'm':
+			stats_shm = optarg;
+			continue;
+
+		    case 'B':
+			if (strcmp( optarg, "targets" ) == 0)
+				loadgen_breakdown = BREAKDOWN_TARGETS;
+			else if (strcmp( optarg, "threads" ) == 0)
+				loadgen_breakdown = BREAKDOWN_THREADS;
+			else if (strcmp( optarg, "all" ) == 0)
+				loadgen_breakdown = BREAKDOWN_TARGETS|BREAKDOWN_THREADS;
+			else {
+				loadgen_problem = "Unknown report breakdown";
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
+		    case 'P':
+		    	loadgen_affinity = optarg;
+			loadgen_problem = setAffinity( optarg );
+			if (loadgen_problem) {
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
+		    case 'C':
+		    	loadgen_compress = atof(optarg);
+			if (loadgen_compress < 1 || loadgen_compress > MAX_COMPRESS_RATIO) {
+				loadgen_problem = "Unsupported compression ratio";
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
+		    case 'c':
+			children = optarg;
+			loadgen_problem = setChildren( optarg );
+			if (loadgen_problem) {
+				if (loadgen_zombie)
+					fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+				fprintf(stderr, " %s\n", loadgen_problem);
+				exit( -1 );
+			}
+			continue;
+
+		    case 'N':
+			loadgen_problem = "A listener takes no other switches";
+			if (loadgen_zombie)
+				fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+			fprintf(stderr, " %s\n", loadgen_problem);
+			exit( -1 );
+
 		   case '?':
 			usage_info( argv[0] );
 			exit( 0 );
@@ -309,11 +551,128 @@ main( int argc, const char **argv) {
 	}
 
 
+	// a saturation search, sweep and load profile would fight over the threads
+	if ((slo != 0) + (sweep != 0) + (profile != 0) > 1) {
+		loadgen_problem = "Only one of a profile, SLO search or sweep can control the threads";
+		if (loadgen_zombie)
+			fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+		fprintf(stderr, " %s\n", loadgen_problem);
+		exit( -1 );
+	}
+
+	// a sub-master only passes thread counts on to its children,
+	//	and they each have statistics of their own
+	if (children && (slo || sweep || profile || stats_shm)) {
+		loadgen_problem = "A sub-master cannot run a profile, SLO search or sweep, or publish statistics";
+		if (loadgen_zombie)
+			fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+		fprintf(stderr, " %s\n", loadgen_problem);
+		exit( -1 );
+	}
+
+	// worker processes only share their thread descriptors,
+	//	not a sweep's fill count or the stealers' work queues
+	if (loadgen_procs > 1 && (sweep || loadgen_steal)) {
+		loadgen_problem = "Worker processes cannot sweep or steal";
+		if (loadgen_zombie)
+			fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+		fprintf(stderr, " %s\n", loadgen_problem);
+		exit( -1 );
+	}
+
+	// sweeps (and mixes) are done by the mixed read/write workers,
+	//	which do fixed size operations in files of their own
+	if (sweep || loadgen_mix >= 0) {
+		if (loadgen_read || src) {
+			loadgen_problem = "Mixed workloads cannot read or copy existing files";
+			if (loadgen_zombie)
+				fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+			fprintf(stderr, " %s\n", loadgen_problem);
+			exit( -1 );
+		}
+		if (loadgen_bsize == 0)
+			loadgen_bsize = loadgen_rand_blk ? loadgen_rand_blk.load() : DEFAULT_MIX_BSIZE;
+		if (loadgen_mix < 0)
+			loadgen_mix = 0;
+	}
+
+	// only the creators and copiers write whole files of their own
+	if (flush && (loadgen_read || loadgen_mix >= 0)) {
+		loadgen_problem = "Only creates and copies can flush";
+		if (loadgen_zombie)
+			fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+		fprintf(stderr, " %s\n", loadgen_problem);
+		exit( -1 );
+	}
+
+	// a WAL workload's producers and committers share one log
+	//	(and the committers do all of the flushing)
+	if (wal && (loadgen_read || src || loadgen_mix >= 0 || flush || loadgen_procs > 1)) {
+		loadgen_problem = "A WAL workload cannot read, copy, mix, flush or use worker processes";
+		if (loadgen_zombie)
+			fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+		fprintf(stderr, " %s\n", loadgen_problem);
+		exit( -1 );
+	}
+	if (wal && targets > 1) {
+		loadgen_problem = "A WAL workload has a single target";
+		if (loadgen_zombie)
+			fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+		fprintf(stderr, " %s\n", loadgen_problem);
+		exit( -1 );
+	}
+	if (sweep) {
+		if (sweepThreads() > 0)
+			threads = sweepThreads();
+		else if (threads < 1)
+			threads = 1;
+	}
+	if (matrix) {
+		loadgen_problem = sweep ? setMatrix( matrix ) : "A matrix file requires a sweep";
+		if (loadgen_problem) {
+			if (loadgen_zombie)
+				fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+			fprintf(stderr, " %s\n", loadgen_problem);
+			exit( -1 );
+		}
+	}
+
+	// set up any alternative report format or destination
+	loadgen_problem = setReports( rpt_format, rpt_file );
+	if (loadgen_problem) {
+		if (loadgen_zombie)
+			fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+		fprintf(stderr, " %s\n", loadgen_problem);
+		exit( -1 );
+	}
+
+	// unique (or compressible) data can only be described
+	//	by a version 2 header
+	if ((loadgen_unique || loadgen_compress > 0) && !loadgen_read)
+		loadgen_format = 2;
+
+	// make sure we know how to write the requested format
+	if (loadgen_format != 1 && loadgen_format != 2) {
+		loadgen_problem = "Unsupported pattern data format";
+		if (loadgen_zombie)
+			fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+		fprintf(stderr, " %s\n", loadgen_problem);
+		exit( -1 );
+	}
+
 	// define the latency reporting buckets (micro-seconds)
-	long limits[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512,
-			1000, 2000, 4000, 8000, 16000, 32000, 
-			64000, 128000, 256000, 512000, -1 };
-	perfstats::setlimits( limits );
+	perfstats::setlimits( latency_limits );
+
+	// publish live statistics for local monitors (if requested)
+	if (stats_shm) {
+		loadgen_problem = statsCreate( stats_shm );
+		if (loadgen_problem) {
+			if (loadgen_zombie)
+				fprintf(stdout, "%s %s!\n", argh, loadgen_problem);
+			fprintf(stderr, " %s\n", loadgen_problem);
+			exit( -1 );
+		}
+	}
 
 	// see if we are supposed to display our options
 	if (loadgen_debug & D_OPTS) {
@@ -335,7 +694,7 @@ main( int argc, const char **argv) {
 		if (loadgen_data)
 			fprintf(stderr, "#   data     = %lld bytes\n", loadgen_data );
 		if (loadgen_bsize)
-			fprintf(stderr, "#   bsize    = %d bytes\n", loadgen_bsize );
+			fprintf(stderr, "#   bsize    = %d bytes\n", loadgen_bsize.load() );
 		else
 			fprintf(stderr, "#   bsize    = random\n");
 
@@ -345,22 +704,66 @@ main( int argc, const char **argv) {
 		fprintf(stderr, "#   rewrite  = %s\n", loadgen_rewrite ? "true" : "false" );
 		fprintf(stderr, "#   verify   = %s\n", loadgen_verify ? "true" : "false" );
 		if (loadgen_rand_blk)
-			fprintf(stderr, "#   random   = %d\n", loadgen_rand_blk );
+			fprintf(stderr, "#   random   = %d\n", loadgen_rand_blk.load() );
 		fprintf(stderr, "#   direct   = %d\n", loadgen_direct );
 		if (loadgen_depth > 1)
-			fprintf(stderr, "#   depth    = %d\n", loadgen_depth );
+			fprintf(stderr, "#   depth    = %d\n", loadgen_depth.load() );
+		if (loadgen_format != 1)
+			fprintf(stderr, "#   format   = %d\n", loadgen_format );
+		if (loadgen_unique)
+			fprintf(stderr, "#   unique   = true\n" );
+		if (loadgen_compress > 0)
+			fprintf(stderr, "#   compress = %.2f\n", loadgen_compress );
+		if (loadgen_split > 1)
+			fprintf(stderr, "#   split    = %d%s\n", loadgen_split,
+				loadgen_interleave ? " (interleaved)" : "" );
+		if (loadgen_steal)
+			fprintf(stderr, "#   steal    = true\n" );
+		if (loadgen_procs > 1)
+			fprintf(stderr, "#   procs    = %d\n", loadgen_procs );
+		if (loadgen_affinity)
+			fprintf(stderr, "#   affinity = %s\n", loadgen_affinity );
 		fprintf(stderr, "#   delete   = %s\n", loadgen_delete ? "true" : "false" );
 		fprintf(stderr, "#   sync     = %s\n", loadgen_sync ? "true" : "false" );
+		if (flush)
+			fprintf(stderr, "#   flush    = %s\n", flush );
 		if (loadgen_rate > 0)
-			fprintf(stderr, "#   rate     = %lld bytes/sec\n", loadgen_rate );
+			fprintf(stderr, "#   rate     = %lld bytes/sec\n", loadgen_rate.load() );
+		if (profile)
+			fprintf(stderr, "#   profile  = %s\n", profile );
+		if (slo)
+			fprintf(stderr, "#   slo      = %s\n", slo );
+		if (loadgen_mix >= 0)
+			fprintf(stderr, "#   mix      = %d%% reads\n", loadgen_mix.load() );
+		if (wal)
+			fprintf(stderr, "#   wal      = %s\n", wal );
+		if (sweep)
+			fprintf(stderr, "#   sweep    = %s\n", sweep );
+		if (matrix)
+			fprintf(stderr, "#   matrix   = %s\n", matrix );
+		if (children)
+			fprintf(stderr, "#   children = %s\n", children );
 		fprintf(stderr, "#   onceonly = %s\n", loadgen_once ? "true" : "false" );
 		fprintf(stderr, "#   halt     = %s\n", loadgen_halt ? "true" : "false" );
-		fprintf(stderr, "#   update   = %d\n", loadgen_update );
+		if (rpt_format || rpt_file)
+			fprintf(stderr, "#   reports  = %s%s%s\n", 
+				rpt_format ? rpt_format : "text",
+				rpt_file ? " to " : "", rpt_file ? rpt_file : "" );
+		if (loadgen_breakdown)
+			fprintf(stderr, "#   breakdown= %s\n",
+				loadgen_breakdown == BREAKDOWN_TARGETS ? "targets" :
+				loadgen_breakdown == BREAKDOWN_THREADS ? "threads" : "all" );
+		if (stats_shm)
+			fprintf(stderr, "#   stats    = %s\n", stats_shm );
+		if (loadgen_update % 1000)
+			fprintf(stderr, "#   update   = %dms\n", loadgen_update );
+		else
+			fprintf(stderr, "#   update   = %d\n", loadgen_update / 1000 );
 		fprintf(stderr, "#   simulate = %s\n", loadgen_simulate ? "true" : "false" );
 		fprintf(stderr, "#   num_buckets = %d\n", perfstats::num_buckets );
 		fprintf(stderr, "#   buckets = (" );
-		for( int i = 0; limits[i] > 0; i++ )
-			fprintf(stderr, "<=%luus,", limits[i]);
+		for( int i = 0; latency_limits[i] > 0; i++ )
+			fprintf(stderr, "<=%luus,", latency_limits[i]);
 		fprintf( stderr, ">)\n");
 		fprintf(stderr, "#   debug    = %s\n", getDebugOpts(loadgen_debug));
 		fprintf(stderr, "#\n");
@@ -383,11 +786,20 @@ main( int argc, const char **argv) {
 	// kick off the actual load generation
 	umask(0);
 	int ret = 0;
-	if (loadgen_read) {
+	if (children) {
+		ret = subMaster( argc, argv, threads );
+	} else if (loadgen_read) {
 		if (targets == 1 && checkdir( tgts[0], false) == 0)
 			ret = readData_d( src, tgts[0], threads );
 		else
 			ret = readData_l( tgts );
+	} else if (wal) {
+		ret = walData( tgts[0], threads );
+	} else if (loadgen_mix >= 0) {
+		if (targets == 1)
+			ret = mixData_d( tgts[0], threads );
+		else
+			ret = mixData_l( tgts );
 	} else {
 		if (src) {	// copy
 			ret = copyData( src, tgts[0], threads );
@@ -408,6 +820,7 @@ main( int argc, const char **argv) {
 			fprintf(stdout, "%s Cause unknown!\n", argh );
 		fflush( stdout );
 	}
+	statsClose();
 	exit( ret );
 }
 
@@ -441,6 +854,25 @@ getSizeSpec( const char *string ) {
 	return num;
 }
 
+/**
+ * parse a time specification (in seconds, unless it ends in ms,
+ * m or h) and return the resulting number of milliseconds.
+ */
+int 
+getTimeSpec( const char *string ) {
+	char *suffix;
+	double num = strtod( string, &suffix );
+
+	// see if there was a unit suffix
+	if (suffix[0] == 'm' && suffix[1] == 's')
+		return (int) num;
+	if (suffix[0] == 'm')
+		return (int) (num * 60 * 1000);
+	if (suffix[0] == 'h')
+		return (int) (num * 60 * 60 * 1000);
+	return (int) (num * 1000);
+}
+
 /*
  * see if a file name is followed by an offset, and 
  * if so, lex it off and null it out
@@ -473,7 +905,7 @@ long long getOffset( char *n ) {
 static char *
 getArgSpec( struct myargs *myp ) {
 	int i;
-	static char spec[64];
+	static char spec[128];
 	char *s = spec;
 
 	for( i = 0; myp[i].fullname; i++ ) {
@@ -0,0 +1,571 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sched.h>
+#include <string.h>
+#include <errno.h>
+#include <aio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "loadgen.h"
+#include "threadstatus.h"
+#include "pattern.h"
+#include "bufset.h"
+#include "sweep.h"
+#include "debug.h"
+
+void *mixDataThread( void * );
+
+// size of the region each worker uses (if no --length is specified)
+#define	DEFAULT_MIX_LENGTH	(64LL * 1024 * 1024)
+
+// workers that are still creating (or extending) their files
+static std::atomic<int> filling(0);
+
+/**
+ * parameters for a mixed read/write thread
+ *
+ *	Each worker does its reads and writes within its own region:
+ *	a file of its own (in a directory of its own), or its own
+ *	slice of a shared file or device.
+ */
+struct mixParms {
+	const char *	directory;		// directory for our file (or NULL)
+	const char *	path;			// file (or device) we work on
+	long long	offset;			// start of our region
+	long long	length;			// size of our region
+	ThreadStatus *	thread;			// worker doing this I/O
+
+	/**
+	 * allocate and initialize a mixed operation descriptor
+	 *
+	 * @param name		name of this thread
+	 * @param dir		directory to put our file in (or NULL)
+	 * @param file		file (or device) to work on
+	 */
+	mixParms( char *name, const char *dir, const char *file ) {
+		directory = dir;
+		path = file;
+		offset = 0;
+		length = loadgen_fsize ? loadgen_fsize : DEFAULT_MIX_LENGTH;
+
+		// allocate the thread status structure for it
+		// 	and add it to the known threads list
+		thread = new ThreadStatus( name, this );
+	}
+};
+
+/**
+ * Multi-Thread mixed read/write load generator
+ * -	each thread gets its own file (in its own sub-directory) or
+ *	its own slice of a file or device
+ * -	and does a mix of reads and writes within it
+ *
+ * @param to		directory, file or device to work on
+ * @param threads	number of initial threads
+ *			(if this is zero, don't start yet)
+ *
+ * @return		exit status (worst exit status from any thread)
+ */
+/*
+ * what the threads of mixData_d are defined from
+ *	(so that more of them can be defined as they are wanted)
+ */
+static char *mixTo = 0;			// directory (or file or device)
+static long long mixOffset = 0;		// base offset for all file I/O
+static bool mixOneFile = false;		// a file or device (not a directory)
+
+/**
+ * define a thread for mixData_d
+ *
+ * @param i		number of the thread
+ *
+ * @return		true if it could be defined
+ */
+static bool defineMixer( int i ) {
+	char *threadname = 0;
+	asprintf( &threadname, "Mixed Thread %04d", i );
+
+	struct mixParms *parms;
+	if (mixOneFile) {
+		parms = new mixParms( threadname, 0, mixTo );
+		parms->offset = mixOffset + i * parms->length;
+	} else {
+		char *dir = 0;
+		char *file = 0;
+		asprintf( &dir, "%s/Thread%04d", mixTo, i );
+		asprintf( &file, "%s/Thread%04d/FILE_000000", mixTo, i );
+		parms = new mixParms( threadname, dir, file );
+		parms->offset = mixOffset;
+	}
+	if (threadname == 0 || parms == 0 || parms->path == 0) {
+		loadgen_problem = "malloc failure";
+		return false;
+	}
+	parms->thread->target = mixTo;
+	return true;
+}
+
+int
+mixData_d( char *to, int threads ) {
+
+	// if there is an offset, note it and null it out
+	long long offset = getOffset(to);
+
+	// figure out what type of target it is
+	bool onefile = false;
+	if (checkdev( to ) || checkfile( to )) {
+		onefile = true;
+	} else {
+		const char *err = checkdir(to, true);
+		if (err) {
+			fprintf(stderr, "FATAL: target directory %s: %s\n", to, err );
+			loadgen_problem = "target directory access";
+			return TARGET_DIRECTORY;
+		}
+	}
+
+	// define the threads we are to start with, and (if we were not
+	//	told how many we may have) the rest as they are wanted
+	mixTo = to;
+	mixOffset = offset;
+	mixOneFile = onefile;
+	for( int i = 0; i < threads; i++ )
+		if (!defineMixer( i ))
+			return RESOURCE_ERROR;
+
+	// we just configure them, the thread manager does the real work
+	return ThreadStatus::manageThreads( mixDataThread, threads, 64*1024,
+			threads ? 0 : defineMixer );
+}
+
+/**
+ * Multi-Thread mixed read/write load generator where each thread is
+ *	assigned its own directory, file or device.
+ *
+ * @param list		list of targets
+ *
+ * @return		exit status (worst exit status from any thread)
+ */
+int
+mixData_l( char **list ) {
+
+	int threads = 0;
+	for( int i = 0; list[i] != 0; i++ ) {
+		// if there is an offset, note it and null it out
+		long long offset = getOffset(list[i]);
+
+		char *threadname = 0;
+		asprintf( &threadname, "Mixed Thread %04d", i );
+
+		struct mixParms *parms;
+		if (checkdev( list[i]) || checkfile( list[i])) {
+			parms = new mixParms( threadname, 0, list[i] );
+		} else {
+			const char *err = checkdir(list[i], false);
+			if (err) {
+				fprintf(stderr, "FATAL: target directory %s: %s\n", list[i], err );
+				loadgen_problem = "target directory access";
+				return TARGET_DIRECTORY;
+			}
+			char *file = 0;
+			asprintf( &file, "%s/FILE_000000", list[i] );
+			parms = new mixParms( threadname, list[i], file );
+		}
+		if (threadname == 0 || parms == 0 || parms->path == 0) {
+			loadgen_problem = "malloc failure";
+			return RESOURCE_ERROR;
+		}
+		parms->offset = offset;
+		parms->thread->target = list[i];
+		threads++;
+	}
+
+	// we just configure them, the thread manager does the real work
+	return ThreadStatus::manageThreads( mixDataThread, threads );
+}
+
+bool mixReady() {
+	return filling == 0;
+}
+
+/*
+ * make sure our region of the file exists, so there is something to read
+ *	(these writes are not part of the mixed load, and are not counted)
+ */
+static int fillRegion( int fd, struct mixParms *parms, Bufset *bufs ) {
+	struct stat statb;
+	if (fstat( fd, &statb ) != 0 || !S_ISREG(statb.st_mode))
+		return 0;	// devices are already as big as they will get
+	long long end = parms->offset + parms->length;
+	if (statb.st_size >= end)
+		return 0;
+
+	if (loadgen_debug & D_FILES)
+		fprintf(stderr, "# creating mixed file %s, fsize=%lld\n", parms->path, end );
+	char *buf = bufs->buffer(0);
+	long long offset = (statb.st_size > parms->offset) ? statb.st_size : parms->offset;
+	offset -= (offset - parms->offset) % bufs->size;
+	while( offset < end ) {
+		if (loadgen_shutdown)
+			break;
+		int len = (end - offset < bufs->size) ? (int) (end - offset) : bufs->size;
+		blockHeader( buf, len, offset );
+		if (pwrite( fd, buf, len, offset ) != len) {
+			fprintf(stderr, "write error to file %s: %s\n", parms->path, strerror( errno ));
+			loadgen_problem = "file write error";
+			return OUTPUT_FILE_ERROR;
+		}
+		offset += len;
+	}
+	return 0;
+}
+
+/**
+ * one operation slot of a mixed worker's queue
+ *
+ *	Each slot has its own descriptor, so that (with the POSIX AIO
+ *	implementation, which serializes the requests to each descriptor)
+ *	the operations in the queue really are concurrent.
+ */
+struct mixSlot {
+	struct aiocb	cb;		// the operation
+	bool		busy;		// it is in progress
+	bool		write;		// it is a write
+	hires_time_t	started;	// when it was submitted
+};
+
+/*
+ * open another descriptor for our file
+ *
+ * @param	parameters
+ * @return	file descriptor (-1 if simulated), or -2 on error
+ */
+static int openSlot( struct mixParms *parms ) {
+	if (loadgen_simulate)
+		return -1;
+
+	int opts = O_RDWR | O_CREAT;
+	if (loadgen_sync)
+		opts |= O_DSYNC;
+	if (loadgen_direct)
+		opts |= O_DIRECT;
+	int fd = open( parms->path, opts, 0666 );
+	if (fd < 0) {
+		fprintf(stderr,"Unable to create output file %s: %s\n",
+			parms->path, strerror( errno ));
+		loadgen_problem = "file create failure";
+		return -2;
+	}
+	return fd;
+}
+
+/*
+ * collect the operations that have completed
+ *
+ * @param	all of the slots
+ * @param	number of slots
+ * @param	wait for all of them (rather than at least one)
+ * @param	(hires) time after which to stop waiting (or 0)
+ * @param	parameters (for error messages)
+ * @param	statistics to update
+ * @param	(updated) number of operations in progress
+ * @return	status
+ */
+static int harvest( struct mixSlot *slots, int depth, bool all, hires_time_t until,
+		struct mixParms *parms, perfstats *stats, int *inflight ) {
+	int status = 0;
+	while( *inflight > 0 ) {
+		// wait for something to finish
+		const struct aiocb *list[MAX_MIX_DEPTH];
+		int n = 0;
+		for( int i = 0; i < depth; i++ )
+			if (slots[i].busy)
+				list[n++] = &slots[i].cb;
+		if (until == 0)
+			aio_suspend( list, n, 0 );
+		else {
+			hires_time_t now = hires_time();
+			if (now >= until)
+				break;
+			struct timespec timeout;
+			timeout.tv_sec = (until - now) / 1000000;
+			timeout.tv_nsec = ((until - now) % 1000000) * 1000;
+			aio_suspend( list, n, &timeout );
+		}
+
+		int done = 0;
+		for( int i = 0; i < depth; i++ ) {
+			struct mixSlot *s = &slots[i];
+			if (!s->busy || aio_error( &s->cb ) == EINPROGRESS)
+				continue;
+			hires_time_t elapsed = hires_time() - s->started;
+			int err = aio_error( &s->cb );
+			ssize_t ret = aio_return( &s->cb );
+			s->busy = false;
+			(*inflight)--;
+			done++;
+			if (ret < 0 || (s->write && (size_t) ret != s->cb.aio_nbytes)) {
+				fprintf(stderr, s->write ? "write error to file %s: %s\n" :
+					"Data read error on input file %s: %s\n",
+					parms->path, strerror( ret < 0 ? err : ENOSPC ));
+				loadgen_problem = s->write ? "file write error" : "file read error";
+				status |= s->write ? OUTPUT_FILE_ERROR : INPUT_FILE_ERROR;
+				continue;
+			}
+			stats->xfer_done( ret, elapsed, s->write );
+			if ((loadgen_debug & D_WRITES) && s->write)
+				fprintf(stderr, "# Write %zd bytes to %s(%lld)\n", ret,
+					parms->path, (long long) s->cb.aio_offset );
+		}
+		if (done > 0 && !all)
+			break;
+	}
+	return status;
+}
+
+/**
+ * this is the routine that each mixed load generation thread runs
+ *
+ * @param	ThreadStatus structure for this thread
+ */
+void *mixDataThread( void *sts ) {
+	int status = 0;		// this thread's exit status
+	Bufset *bufset = 0;	// read/write buffer set
+	struct mixSlot *slots = 0;	// our operation queue
+	int inflight = 0;	// operations in progress
+	int slotsOpen = 0;	// slots with open descriptors
+	long long ops = 0;	// operations submitted
+	long long pos = 0;	// next sequential offset (in our region)
+	hires_time_t next = 0;	// when our rate allows the next operation
+	bool counted = false;	// we are counted among the filling
+
+	struct ThreadStatus *mystatus = (struct ThreadStatus *) sts;
+	struct mixParms *myparms = (struct mixParms *) mystatus->parms;
+	int alignment = loadgen_direct > 0 ? loadgen_direct : DEFAULT_ALIGNMENT;
+	unsigned seed = (unsigned) (hires_time() ^ (unsigned long) mystatus);
+
+	// announce that we are starting up
+	mystatus->running = true;	// now set in manageThreads to avoid a race
+	if (loadgen_debug & D_THREADS) {
+		fprintf(stderr, "# Starting %s on %s on cpu %d\n", mystatus->name,
+			myparms->path, sched_getcpu() );
+	}
+	filling++;
+	counted = true;
+
+	// make sure we can create our directory
+	if (myparms->directory) {
+		const char *err = checkdir( myparms->directory, true );
+		if (err) {
+			fprintf(stderr, "FATAL: target directory %s: %s\n",
+				myparms->directory, err );
+			status = TARGET_DIRECTORY;
+			loadgen_problem = "target directory access";
+			goto exit;
+		}
+	}
+
+	// buffers for the largest blocks and deepest queue we expect
+	//	(which we will only have to re-allocate if we are asked
+	//	for even larger ones while we are running)
+	{
+		int bsize = loadgen_bsize;
+		int depth = (loadgen_depth > 1) ? loadgen_depth.load() : 1;
+		int swept_bsize, swept_depth;
+		if (sweepLimits( &swept_bsize, &swept_depth )) {
+			if (swept_bsize > bsize)
+				bsize = swept_bsize;
+			if (swept_depth > depth)
+				depth = swept_depth;
+		}
+		bufset = new Bufset( depth, bsize, alignment );
+		slots = (struct mixSlot *) calloc( MAX_MIX_DEPTH, sizeof *slots );
+		if (bufset->buffers == 0 || slots == 0) {
+			fprintf(stderr, "Unable to allocate (%d %d byte) data buffer for %s\n",
+				depth, bsize, mystatus->name );
+			status |= RESOURCE_ERROR;
+			loadgen_problem = "malloc failure";
+			goto exit;
+		}
+	}
+
+	// open a descriptor for each slot we expect to use
+	for( ; slotsOpen < bufset->buffers; slotsOpen++ ) {
+		int fd = openSlot( myparms );
+		if (fd < -1) {
+			status |= OUTPUT_FILE_ERROR;
+			goto exit;
+		}
+		slots[slotsOpen].cb.aio_fildes = fd;
+	}
+
+	// initialize the headers and data contents, and create our file
+	for( int i = 0; i < bufset->buffers; i++ ) {
+		char *b = bufset->buffer(i);
+		runHeader( b, loadgen_tag );
+		threadHeader( b, mystatus->name );
+		fileHeader( b, myparms->path, myparms->length );
+		fillData( b, bufset->size );
+	}
+	if (!loadgen_simulate)
+		status = fillRegion( slots[0].cb.aio_fildes, myparms, bufset );
+	filling--;
+	counted = false;
+
+	// generate the mixed load
+	while( status == 0 ) {
+		// finish what we started before we park (or shut down)
+		if (!mystatus->enable || loadgen_shutdown) {
+			status |= harvest( slots, MAX_MIX_DEPTH, true, 0, myparms, &mystatus->stats, &inflight );
+			if (!mystatus->keepRunning())
+				break;
+			next = 0;
+		}
+
+		// the shape of the load can change while we are running
+		int bsize = loadgen_bsize;
+		int depth = (loadgen_depth > 1) ? loadgen_depth.load() : 1;
+		if (depth > MAX_MIX_DEPTH)
+			depth = MAX_MIX_DEPTH;
+		if (bsize > myparms->length)
+			bsize = (int) myparms->length;
+
+		// operations still in progress keep their buffers
+		if (bsize > bufset->size || depth > bufset->buffers) {
+			status |= harvest( slots, MAX_MIX_DEPTH, true, 0, myparms, &mystatus->stats, &inflight );
+			Bufset *bigger = new Bufset( depth > bufset->buffers ? depth : bufset->buffers,
+						bsize > bufset->size ? bsize : bufset->size, alignment );
+			if (bigger->buffers == 0) {
+				fprintf(stderr, "Unable to allocate (%d %d byte) data buffer for %s\n",
+					depth, bsize, mystatus->name );
+				status |= RESOURCE_ERROR;
+				loadgen_problem = "malloc failure";
+				delete bigger;
+				break;
+			}
+			delete bufset;
+			bufset = bigger;
+			for( int i = 0; i < bufset->buffers; i++ ) {
+				char *b = bufset->buffer(i);
+				runHeader( b, loadgen_tag );
+				threadHeader( b, mystatus->name );
+				fileHeader( b, myparms->path, myparms->length );
+				fillData( b, bufset->size );
+			}
+		}
+		for( ; slotsOpen < depth; slotsOpen++ ) {
+			int fd = openSlot( myparms );
+			if (fd < -1) {
+				status |= OUTPUT_FILE_ERROR;
+				break;
+			}
+			slots[slotsOpen].cb.aio_fildes = fd;
+		}
+		if (status)
+			break;
+
+		// if the queue is full, wait for something to finish
+		if (inflight >= depth) {
+			status |= harvest( slots, MAX_MIX_DEPTH, false, 0, myparms, &mystatus->stats, &inflight );
+			continue;
+		}
+
+		// see if we need to stall before the next operation
+		long long rate = loadgen_rate;	// (which may be changed)
+		if (rate > 0) {
+			hires_time_t now = hires_time();
+			if (next < now)
+				next = now;	// (we don't make up for lost time)
+			else if (next > now) {
+				if (loadgen_debug & D_SLEEP)
+					fprintf(stderr, "# sleep %lluus\n", next - now );
+
+				// (noting what completes while we wait, so its
+				//	latency does not include our stall)
+				status |= harvest( slots, MAX_MIX_DEPTH, true, next, myparms,
+						&mystatus->stats, &inflight );
+				if (status)
+					break;
+				now = hires_time();
+				if (next > now)
+					usleep( (long) (next - now) );
+			}
+			next += (1000000ULL * bsize) / rate;
+		}
+
+		// choose an operation and a place to do it
+		//	(after any stall, in which the mix may have changed)
+		int mix = loadgen_mix;
+		int random = loadgen_rand_blk;
+		int i;
+		for( i = 0; slots[i].busy; i++ );
+		struct mixSlot *s = &slots[i];
+		long long blocks = myparms->length / bsize;
+		long long off;
+		if (random) {
+			off = choose_block( blocks ) * bsize;
+		} else {
+			if (pos + bsize > myparms->length)
+				pos = 0;
+			off = pos;
+			pos += bsize;
+		}
+		s->write = (int) (rand_r( &seed ) % 100) >= mix;
+		s->cb.aio_offset = myparms->offset + off;
+		s->cb.aio_nbytes = bsize;
+		s->cb.aio_buf = bufset->buffer( i % bufset->buffers );
+		s->cb.aio_sigevent.sigev_notify = SIGEV_NONE;
+		s->started = hires_time();
+
+		// simulated operations complete immediately
+		if (loadgen_simulate) {
+			mystatus->stats.xfer_done( bsize, 0, s->write );
+			ops++;
+			continue;
+		}
+
+		// but real ones may take a while
+		//	(in this mode, the data is not expected to be verifiable,
+		//	so a buffer shared by concurrent writes is fine)
+		if (s->write)
+			blockHeader( (char *) s->cb.aio_buf, bsize, s->cb.aio_offset );
+		int ret = s->write ? aio_write( &s->cb ) : aio_read( &s->cb );
+		if (ret != 0) {
+			fprintf(stderr, "Unable to queue %s to %s: %s\n",
+				s->write ? "write" : "read", myparms->path, strerror( errno ));
+			loadgen_problem = "aio failure";
+			status |= RESOURCE_ERROR;
+			break;
+		}
+		s->busy = true;
+		inflight++;
+		ops++;
+	}
+
+	// finish anything still in progress
+	if (slots)
+		status |= harvest( slots, MAX_MIX_DEPTH, true, 0, myparms, &mystatus->stats, &inflight );
+
+  exit:
+	if (counted)
+		filling--;
+	if (loadgen_debug & D_THREADS || status != 0) {
+		fprintf(stderr, "# Shutting down %s (en=%d, ops=%lld, sts=%x, stop=%d)\n",
+			mystatus->name, mystatus->enable.load(),
+			ops, status, loadgen_shutdown.load() );
+	}
+
+	for( int i = 0; slots && i < slotsOpen; i++ )
+		if (slots[i].cb.aio_fildes >= 0)
+			close( slots[i].cb.aio_fildes );
+	free( slots );
+	delete bufset;
+
+	// report my exit status and exit
+	mystatus->exiting( status );
+	pthread_exit(0);
+}
@@ -5,6 +5,12 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "loadgen.h"
+#include "pattern.h"
+#include "crc32c.h"
 
 static bool initialized = false;
 /**
@@ -112,9 +118,304 @@ struct buf_header {
 	char data[];
 };
 
+/**
+ * the (opt-in) version 2 format replaces the four text headers
+ *	with a single 64 byte binary header, that describes the
+ *	block well enough to verify it (with a CRC32C of the
+ *	payload) without reference to any other block.
+ *
+ *	All fields are in host byte order.
+ */
+#define	V2_MAGIC	"LOADGEN2"
+#define	V2_VERSION	2
+struct v2_header {
+	char		magic[8];	///< V2_MAGIC
+	uint16_t	version;	///< V2_VERSION
+	uint16_t	hdr_size;	///< sizeof (struct v2_header)
+	uint32_t	payload;	///< how the payload was generated
+	uint64_t	run_id;		///< creation time (high) and tag hash (low)
+	uint64_t	file_id;	///< hash of the file name
+	uint64_t	offset;		///< offset of this block in file
+	uint64_t	file_length;	///< intended length of file
+	uint32_t	bsize;		///< length of this block
+	uint32_t	generation;	///< write generation of this block
+	uint32_t	data_crc;	///< CRC32C of the payload
+	uint32_t	hdr_crc;	///< CRC32C of all of the above
+};
+
+// payload types
+#define	PAYLOAD_PATTERN	0	///< the standard staggered pattern
+#define	PAYLOAD_UNIQUE	1	///< keyed pseudo-random stream (never repeats)
+#define	PAYLOAD_COMPRESS 2	///< random and repeated segments (see below)
+
+// the high half of the payload word is a type-specific parameter
+#define	PAYLOAD_TYPE(p)		((p) & 0xffff)
+#define	PAYLOAD_PARAM(p)	((p) >> 16)
+
+#define	V2_HDR_CRC_LEN	(offsetof( struct v2_header, hdr_crc ))
+
+/**
+ * does this buffer begin with a version 2 header
+ */
+static inline bool is_v2( const char *buf ) {
+	return memcmp( buf, V2_MAGIC, sizeof ((struct v2_header *) 0)->magic ) == 0;
+}
+
+/**
+ * FNV-1a hash (of file names and tags)
+ */
+static uint64_t fnv_hash( const char *s ) {
+	uint64_t h = 0xcbf29ce484222325ULL;
+	while( *s ) {
+		h ^= (unsigned char) *s++;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/**
+ * unique payloads are a counter-mode pseudo-random stream:
+ *	word i of a block is a 64-bit mix of (key + i*GOLDEN),
+ *	where the key is derived from the run, file and offset
+ *	in the block header.  This means that no two blocks are
+ *	alike (so de-dupe can't help), any block can be regenerated
+ *	(and so verified) from its own header, and the words are
+ *	independent (so the loop pipelines, and vectorizes).
+ */
+#define	GOLDEN	0x9e3779b97f4a7c15ULL
+
+static inline uint64_t mix64( uint64_t z ) {
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * the generator key for a block
+ *	(so a rewritten block never repeats its previous contents)
+ */
+static inline uint64_t block_key( const struct v2_header *h ) {
+	return mix64( h->run_id ^ mix64( h->file_id ^
+			mix64( h->offset ^ mix64( h->generation ) ) ) );
+}
+
+#if defined(__x86_64__)
+/*
+ * with AVX-512DQ (which has a 64-bit vector multiply), we can mix
+ *	eight words at once, producing exactly the same stream
+ */
+typedef uint64_t words8 __attribute__((vector_size(64)));
+
+__attribute__((target("avx512f,avx512dq"), always_inline))
+static inline words8 mix64x8( words8 z ) {
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * generate the whole groups of eight words of a stream
+ *
+ * @return	number of words generated
+ */
+__attribute__((target("avx512f,avx512dq")))
+static long generate8( uint64_t key, char *buf, long words ) {
+	words8 ctr = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	ctr = ctr * GOLDEN + key;
+
+	long i;
+	for( i = 0; i + 8 <= words; i += 8 ) {
+		words8 v = mix64x8( ctr );
+		memcpy( &buf[i*8], &v, sizeof v );
+		ctr += 8 * GOLDEN;
+	}
+	return i;
+}
+
+/**
+ * compare the whole groups of eight words of a stream
+ *
+ * @param diffs	accumulated differences
+ * @return	number of words compared
+ */
+__attribute__((target("avx512f,avx512dq")))
+static long regenerate8( uint64_t key, const char *buf, long words, uint64_t *diffs ) {
+	words8 ctr = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	ctr = ctr * GOLDEN + key;
+	words8 d = { 0 };
+
+	long i;
+	for( i = 0; i + 8 <= words; i += 8 ) {
+		words8 v;
+		memcpy( &v, &buf[i*8], sizeof v );
+		d |= v ^ mix64x8( ctr );
+		ctr += 8 * GOLDEN;
+	}
+	for( int j = 0; j < 8; j++ )
+		*diffs |= d[j];
+	return i;
+}
+#endif
+
+/**
+ * can we generate eight words at a time
+ */
+static bool wide_generator() {
+#if defined(__x86_64__)
+	static int wide = -1;
+	if (wide < 0)
+		wide = __builtin_cpu_supports( "avx512dq" );
+	return wide;
+#else
+	return false;
+#endif
+}
+
+/**
+ * fill a buffer with the stream for a key
+ *
+ * @param key	generator key (see block_key)
+ * @param buf	buffer to be filled
+ * @param len	number of bytes to fill
+ */
+static void generate( uint64_t key, char *buf, long len ) {
+	long words = len / 8;
+	long i = 0;
+#if defined(__x86_64__)
+	if (wide_generator())
+		i = generate8( key, buf, words );
+#endif
+	uint64_t ctr = key + i * GOLDEN;
+
+	for( ; i < words; i++ ) {
+		uint64_t v = mix64( ctr += GOLDEN );
+		memcpy( &buf[i*8], &v, 8 );
+	}
+	if (len % 8) {
+		uint64_t v = mix64( ctr += GOLDEN );
+		memcpy( &buf[words*8], &v, len % 8 );
+	}
+}
+
+/**
+ * compare a buffer with the stream for a key
+ *
+ * @param key	generator key (see block_key)
+ * @param buf	buffer to be checked
+ * @param len	number of bytes to check
+ * @return	true if the buffer matches the stream
+ */
+static bool regenerate( uint64_t key, const char *buf, long len ) {
+	long words = len / 8;
+	long i = 0;
+	uint64_t diffs = 0;
+#if defined(__x86_64__)
+	if (wide_generator())
+		i = regenerate8( key, buf, words, &diffs );
+#endif
+	uint64_t ctr = key + i * GOLDEN;
+
+	// accumulate the differences so the loop has no branches
+	for( ; i < words; i++ ) {
+		uint64_t v;
+		memcpy( &v, &buf[i*8], 8 );
+		diffs |= v ^ mix64( ctr += GOLDEN );
+	}
+	if (len % 8) {
+		uint64_t v = 0, w = mix64( ctr += GOLDEN );
+		memcpy( &v, &buf[words*8], len % 8 );
+		memset( ((char *) &w) + len % 8, 0, 8 - len % 8 );
+		diffs |= v ^ w;
+	}
+
+	return diffs == 0;
+}
+
+/**
+ * compressible payloads are made up of SEGMENT byte segments,
+ *	each of which begins with (1/ratio) of its bytes from
+ *	the unique stream (at the same positions they would have
+ *	in a unique block), and is filled out by repeating the
+ *	first word of that segment.  A compressor can do nothing
+ *	with the random bytes, and reduces the rest to almost
+ *	nothing, so the block compresses by very nearly the
+ *	requested ratio ... and still never repeats.
+ *
+ *	The ratio is kept (in hundredths) in the payload parameter.
+ */
+#define	SEGMENT		512
+
+/**
+ * number of random bytes in each segment for a given ratio
+ *	(rounded to a multiple of the generator's word size)
+ */
+static inline long random_bytes( unsigned hundredths ) {
+	long r = ((SEGMENT * 100L / hundredths) + 4) & ~7L;
+	return (r < 8) ? 8 : r;
+}
+
+/**
+ * fill a buffer with a compressible version of the stream for a key
+ *
+ * @param key	generator key (see block_key)
+ * @param hundredths	compression ratio (in hundredths)
+ * @param buf	buffer to be filled
+ * @param len	number of bytes to fill
+ */
+static void generate_segments( uint64_t key, unsigned hundredths, char *buf, long len ) {
+	long r = random_bytes( hundredths );
+
+	for( long s = 0; s < len; s += SEGMENT ) {
+		long n = (len - s < SEGMENT) ? len - s : SEGMENT;
+		generate( key + (s/8) * GOLDEN, &buf[s], (n < r) ? n : r );
+		if (n <= r)
+			continue;
+
+		// repeat the first word (from a register, so it vectorizes)
+		uint64_t w;
+		memcpy( &w, &buf[s], 8 );
+		long i;
+		for( i = r; i + 8 <= n; i += 8 )
+			memcpy( &buf[s+i], &w, 8 );
+		memcpy( &buf[s+i], &w, n - i );
+	}
+}
+
+/**
+ * compare a buffer with the compressible stream for a key
+ *
+ * @param key	generator key (see block_key)
+ * @param hundredths	compression ratio (in hundredths)
+ * @param buf	buffer to be checked
+ * @param len	number of bytes to check
+ * @return	true if the buffer matches the stream
+ */
+static bool regenerate_segments( uint64_t key, unsigned hundredths, const char *buf, long len ) {
+	long r = random_bytes( hundredths );
+	bool ok = true;
+
+	for( long s = 0; s < len; s += SEGMENT ) {
+		long n = (len - s < SEGMENT) ? len - s : SEGMENT;
+		ok &= regenerate( key + (s/8) * GOLDEN, &buf[s], (n < r) ? n : r );
+		if (n <= r)
+			continue;
+
+		// the fill must start with the first word and repeat every 8 bytes
+		const char *p = &buf[s+r];
+		long seglen = n - r;
+		ok &= memcmp( p, &buf[s], (seglen < 8) ? seglen : 8 ) == 0;
+		if (seglen > 8)
+			ok &= memcmp( &p[8], p, seglen - 8 ) == 0;
+	}
+	return ok;
+}
+
 /**
  * return the length of a standard header
  * 	  (used for verification reads)
+ *
+ *	This is the larger of the two formats, so a read of
+ *	this size will get the headers for either.
  */
 long header_size() {
 
@@ -130,7 +431,27 @@ long header_size() {
 #define	BLK_FORMAT "#BLK bsize=%ld offset=%llu"
 
 // no read-back name should every be this large
-#define	MAX_NAME 64	
+#define	MAX_NAME 64
+
+// the constant parts of the block header (see BLK_FORMAT)
+static const char blk_bsize[] = "#BLK bsize=";
+static const char blk_offset[] = " offset=";
+#define	BLK_BSIZE_LEN	(sizeof blk_bsize - 1)
+#define	BLK_OFFSET_LEN	(sizeof blk_offset - 1)
+
+/**
+ * an empty (space padded, newline terminated) block header line,
+ *	which blockHeader copies in before filling in the numbers
+ */
+static const struct blk_line {
+	char line[WIDTH];
+
+	blk_line() {
+		memset( line, ' ', sizeof line );
+		memcpy( line, blk_bsize, BLK_BSIZE_LEN );
+		line[WIDTH-1] = '\n';
+	}
+} blk_empty;
 
 /**
  * each sub-section header is padded out to a 64 byte line
@@ -145,6 +466,83 @@ void linepad( char *s, int len ) {
 	s[last] = '\n';
 }
 
+// two digit pairs for fast decimal conversion
+static const char digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/**
+ * put_decimal ... render an unsigned number (same as %llu)
+ *
+ * @param p	where to put the digits
+ * @param v	value to be rendered
+ * @return	pointer to the byte after the last digit
+ */
+static inline char *put_decimal( char *p, unsigned long long v ) {
+	char tmp[20];
+	char *t = &tmp[sizeof tmp];
+
+	// two digits at a time, from the right
+	while( v >= 100 ) {
+		unsigned i = (unsigned) (v % 100) * 2;
+		v /= 100;
+		*--t = digit_pairs[i+1];
+		*--t = digit_pairs[i];
+	}
+	if (v >= 10) {
+		*--t = digit_pairs[v*2+1];
+		*--t = digit_pairs[v*2];
+	} else
+		*--t = (char) ('0' + v);
+
+	int len = &tmp[sizeof tmp] - t;
+	memcpy( p, t, len );
+	return p + len;
+}
+
+/**
+ * get_decimal ... parse an unsigned number (what we wrote with %llu)
+ *
+ * @param s	start of the digits
+ * @param v	where to put the parsed value
+ * @return	pointer to the byte after the last digit, or NULL if no digits
+ */
+static inline const char *get_decimal( const char *s, unsigned long long *v ) {
+	unsigned long long n = 0;
+	const char *start = s;
+
+	while( *s >= '0' && *s <= '9' && s - start < 20 )
+		n = (n * 10) + (*s++ - '0');
+
+	*v = n;
+	return (s == start) ? 0 : s;
+}
+
+/**
+ * parse_block_header ... hand-rolled equivalent of sscanf(BLK_FORMAT)
+ *
+ * @param line	the block header line
+ * @param bsize	where to put the block size
+ * @param offset where to put the offset
+ * @return	true if the line was well formed
+ */
+static bool parse_block_header( const char *line, long *bsize, long long *offset ) {
+	unsigned long long b, o;
+
+	if (memcmp( line, blk_bsize, BLK_BSIZE_LEN ))
+		return false;
+	const char *s = get_decimal( &line[BLK_BSIZE_LEN], &b );
+	if (s == 0 || memcmp( s, blk_offset, BLK_OFFSET_LEN ))
+		return false;
+	if (get_decimal( &s[BLK_OFFSET_LEN], &o ) == 0)
+		return false;
+
+	*bsize = (long) b;
+	*offset = (long long) o;
+	return true;
+}
+
 /**
  * runHeader ... initialize the run-header
  *
@@ -152,19 +550,40 @@ void linepad( char *s, int len ) {
  * @param tag	creating loadgen instance
  */
 void runHeader( char *buf, const char *tag ) {
-	// figure out where the run header goes
-	struct buf_header *b = (struct buf_header *) buf;
-	char *p = b->run_header;
-
 	// figure out what time it is
 	time_t now;
 	time( &now );
+
+	if (loadgen_format == 2) {
+		struct v2_header *h = (struct v2_header *) buf;
+		memset( h, 0, sizeof *h );
+		memcpy( h->magic, V2_MAGIC, sizeof h->magic );
+		h->version = V2_VERSION;
+		h->hdr_size = sizeof *h;
+		if (loadgen_compress > 0)
+			h->payload = PAYLOAD_COMPRESS |
+				((uint32_t) (loadgen_compress * 100 + 0.5) << 16);
+		else
+			h->payload = loadgen_unique ? PAYLOAD_UNIQUE : PAYLOAD_PATTERN;
+		h->run_id = ((uint64_t) now << 32) | (uint32_t) fnv_hash( tag ? tag : "" );
+		h->generation = 1;
+		return;
+	}
+
+	// figure out where the run header goes
+	struct buf_header *b = (struct buf_header *) buf;
+	char *p = b->run_header;
 	struct tm *tm = localtime( &now );
 
-	snprintf( p, sizeof b->run_header, RUN_FORMAT,
+	// a long tag is (deliberately) truncated to fit the header line
+	char line[2*WIDTH];
+	snprintf( line, sizeof line, RUN_FORMAT,
 		tm->tm_mon+1, tm->tm_mday, tm->tm_year+1900,
-		tm->tm_hour, tm->tm_min, tm->tm_sec, 
+		tm->tm_hour, tm->tm_min, tm->tm_sec,
 		tag );
+	size_t len = strnlen( line, sizeof b->run_header - 1 );
+	memcpy( p, line, len );
+	p[len] = 0;
 
 	linepad( (char *) p, sizeof b->run_header );
 }
@@ -176,6 +595,10 @@ void runHeader( char *buf, const char *tag ) {
  * @param name	directory in which thread operates
  */
 void threadHeader( char *buf, const char *name ) {
+	// version 2 headers don't record the directory
+	if (loadgen_format == 2)
+		return;
+
 	// figure out where the run header goes
 	struct buf_header *b = (struct buf_header *) buf;
 	char *p = b->thread_header;
@@ -192,33 +615,88 @@ void threadHeader( char *buf, const char *name ) {
  * @param len	intended length of file
  */
 void fileHeader( char *buf, const char *name, long long len ) {
-	// figure out where the run header goes
-	struct buf_header *b = (struct buf_header *) buf;
-	char *p = b->file_header;
-
 	// find the final part of the name
 	const char *s = name;
 	while(s[1]) s++;
 	while(s > name && s[-1] != '/') s--;
 
+	if (loadgen_format == 2) {
+		struct v2_header *h = (struct v2_header *) buf;
+		h->file_id = fnv_hash( s );
+		h->file_length = len;
+		h->generation = 1;
+		return;
+	}
+
+	// figure out where the file header goes
+	struct buf_header *b = (struct buf_header *) buf;
+	char *p = b->file_header;
+
 	snprintf( p, sizeof b->thread_header, FIL_FORMAT, s, len );
 	linepad( (char *) p, sizeof b->file_header );
 }
 
+/**
+ * setGeneration ... note the write generation of a (re)written file
+ *		     (version 2 only, version 1 has no place to put it)
+ *
+ * @param buf		buffer whose header should be updated
+ * @param generation	generation of the data we are about to write
+ */
+void setGeneration( char *buf, unsigned long generation ) {
+	if (loadgen_format == 2) {
+		struct v2_header *h = (struct v2_header *) buf;
+		h->generation = generation;
+		h->bsize = 0;		// a unique payload changes with the generation
+	}
+}
+
 /**
  * blockHeader ... initialize the block-header
  *
+ *	This is called for every block we write, so rather than
+ *	snprintf(BLK_FORMAT) and linepad, we copy in a pre-padded
+ *	template and render the two numbers over it.  The result
+ *	is byte-for-byte what the formatted version produced.
+ *
  * @param buf	data buffer
  * @param bsize	length of this block
  * @param offset of this block in file
  */
 void blockHeader( char *buf, long bsize, long long offset ) {
-	// figure out where the run header goes
+	if (loadgen_format == 2) {
+		struct v2_header *h = (struct v2_header *) buf;
+
+		h->offset = offset;
+
+		// a unique payload is regenerated for every block (and needs
+		//	no CRC, since verification regenerates it), but a
+		//	pattern only changes if the block size does
+		if (h->payload == PAYLOAD_UNIQUE) {
+			h->bsize = bsize;
+			h->data_crc = 0;
+			generate( block_key( h ), &buf[sizeof *h], bsize - sizeof *h );
+		} else if (PAYLOAD_TYPE( h->payload ) == PAYLOAD_COMPRESS) {
+			h->bsize = bsize;
+			h->data_crc = 0;
+			generate_segments( block_key( h ), PAYLOAD_PARAM( h->payload ),
+					&buf[sizeof *h], bsize - sizeof *h );
+		} else if (h->bsize != (uint32_t) bsize) {
+			h->bsize = bsize;
+			h->data_crc = crc32c( 0, &buf[sizeof *h], bsize - sizeof *h );
+		}
+		h->hdr_crc = crc32c( 0, h, V2_HDR_CRC_LEN );
+		return;
+	}
+
+	// figure out where the block header goes
 	struct buf_header *b = (struct buf_header *) buf;
 	char *p = b->block_header;
 
-	snprintf( p, sizeof b->block_header, BLK_FORMAT, bsize, offset);
-	linepad( (char *) p, sizeof b->thread_header );
+	memcpy( p, blk_empty.line, WIDTH );
+	p = put_decimal( &p[BLK_BSIZE_LEN], (unsigned long long) bsize );
+	memcpy( p, blk_offset, BLK_OFFSET_LEN );
+	put_decimal( &p[BLK_OFFSET_LEN], (unsigned long long) offset );
 }
 
 // 64 bytes of pattern data to be written out 63 bytes at a time
@@ -233,12 +711,45 @@ static char pattern[] = "123456789 abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQR
 void fillData ( char *buf, int bsize ) {
 	int i = sizeof (struct buf_header);
 
+	if (loadgen_format == 2) {
+		struct v2_header *h = (struct v2_header *) buf;
+		i = sizeof *h;
+		h->bsize = 0;		// data CRC must be recomputed
+	}
+
 	// fill the remainder of the block with a staggered data pattern
 	for( int x = 0; i < bsize; i++ ) {
 		buf[i] = ((i%64) == 63) ?  '\n' : pattern[(x++)%64];
 	}
 }
 
+/**
+ * checkHeader_v2 ... confirm the correctness of a version 2 header
+ *
+ * @param buf	buffer containing the block to be validated
+ * @param bsize	expected read/write block size
+ * @param offset expected offset of this block
+ *
+ * @return	NULL if header is correct, else an error string
+ */
+static const char *
+checkHeader_v2( const char *buf, int bsize, long long offset ) {
+	struct v2_header *h = (struct v2_header *) buf;
+
+	if (h->version != V2_VERSION || h->hdr_size != sizeof *h)
+		return "unsupported BLOCK header version";
+	if (h->hdr_crc != crc32c( 0, h, V2_HDR_CRC_LEN ))
+		return "BLOCK header checksum error";
+	if (h->bsize <= sizeof *h)
+		return "mal-formatted BLOCK header";
+	if (bsize != 0 && h->bsize != (uint32_t) bsize)
+		return "block-size mis-match";
+	if (h->offset != (uint64_t) offset)
+		return "offset mis-match";
+
+	return NULL;
+}
+
 /**
  * checkHeaders ... confirm the correctness of the various headers
  *
@@ -251,6 +762,9 @@ const char *
 checkHeaders( const char *buf, int bsize, long long offset ) {
 	struct buf_header *b = (struct buf_header *) buf;
 
+	if (is_v2( buf ))
+		return checkHeader_v2( buf, bsize, offset );
+
 	// start by ensuring that each header is present
 	//	we do a better job of validating the headers
 	//	on the first block, but since all but the
@@ -258,13 +772,13 @@ checkHeaders( const char *buf, int bsize, long long offset ) {
 	//	point in revalidating all the other headers
 	//	on every block (beyond seeing if they are
 	//	there at all)
-	if (strncmp( b->run_header, RUN_FORMAT, HEADER_LEN ))
+	if (memcmp( b->run_header, RUN_FORMAT, HEADER_LEN ))
 		return "No RUN header";
-	if (strncmp( b->thread_header, DIR_FORMAT, HEADER_LEN ))
+	if (memcmp( b->thread_header, DIR_FORMAT, HEADER_LEN ))
 		return "No DIR header";
-	if (strncmp( b->file_header, FIL_FORMAT, HEADER_LEN ))
+	if (memcmp( b->file_header, FIL_FORMAT, HEADER_LEN ))
 		return "No FILE header";
-	if (strncmp( b->block_header, BLK_FORMAT, HEADER_LEN ))
+	if (memcmp( b->block_header, BLK_FORMAT, HEADER_LEN ))
 		return "No BLOCK header";
 
 	// we should also make sure that each header ends with a newline
@@ -280,7 +794,7 @@ checkHeaders( const char *buf, int bsize, long long offset ) {
 	// make sure the block sizes and offsets agree
 	long this_bsize;
 	long long this_offset;
-	if (sscanf( b->block_header, BLK_FORMAT, &this_bsize, &this_offset ) != 2) 
+	if (!parse_block_header( b->block_header, &this_bsize, &this_offset ))
 		return "mal-formatted BLOCK header";
 	if (bsize != 0 && this_bsize != bsize)
 		return "block-size mis-match";
@@ -300,15 +814,56 @@ checkHeaders( const char *buf, int bsize, long long offset ) {
  */
 long
 get_block_size( const char * buf ) {
+	if (is_v2( buf ))
+		return ((struct v2_header *) buf)->bsize;
+
 	struct buf_header *b = (struct buf_header *) buf;
 	long this_bsize;
 	long long this_offset;
-	if (sscanf( b->block_header, BLK_FORMAT, &this_bsize, &this_offset ) == 2) 
+	if (parse_block_header( b->block_header, &this_bsize, &this_offset ))
 		return this_bsize;
 	else
 		return 0;
 }
 
+/**
+ * get_generation ... return the write generation of a block
+ *		      (assuming headers have already been verified)
+ *
+ * @param buf	buffer containing headers for this block
+ * @return	generation (0 if the format does not record one)
+ */
+unsigned long
+get_generation( const char * buf ) {
+	if (is_v2( buf ))
+		return ((struct v2_header *) buf)->generation;
+	return 0;
+}
+
+/**
+ * get_format ... return the format in which a block was written
+ *
+ * @param buf	buffer containing headers for this block
+ * @return	format number (1 or 2)
+ */
+int
+get_format( const char * buf ) {
+	return is_v2( buf ) ? 2 : 1;
+}
+
+/**
+ * unwritten ... is this a block that has never been written
+ *		 (a hole in a randomly written file reads back as zeroes)
+ *
+ * @param buf	buffer containing the block
+ * @param bsize	length of the block
+ * @return	true if every byte in the block is zero
+ */
+bool
+unwritten( const char *buf, int bsize ) {
+	return bsize > 0 && buf[0] == 0 && memcmp( buf, &buf[1], bsize - 1 ) == 0;
+}
+
 /**
  * get_file_size ... return the file size used for this file
  *		      (assuming headers have already been verified)
@@ -318,6 +873,9 @@ get_block_size( const char * buf ) {
  */
 long long
 get_file_size( const char * buf ) {
+	if (is_v2( buf ))
+		return ((struct v2_header *) buf)->file_length;
+
 	struct buf_header *b = (struct buf_header *) buf;
 	long long this_fsize;
 	char name[256];
@@ -340,40 +898,53 @@ const char *
 checkFile( const char *buf, const char *path ) {
 	struct buf_header *b = (struct buf_header *) buf;
 
-	// read off the creation time
-	//	if it parses, I'm going to call it right for now
-	//	but if I were cool I'd make sure the file was no
-	//	older than this date/time
-	int mon, day, year, hour, min, sec;
-	if (sscanf( b->run_header, RUN_READBK, &mon, &day, &year, &hour, &min, &sec  ) != 6) 
-		return "mal-formatted RUN header";
-
-	// read the directory name
-	// 	but don't validate it because we might want
-	//	over-constrain our ability to validate data
-	//	long after we forgot how we generated it
-	char dir[MAX_NAME];
-	if (sscanf( b->thread_header, DIR_FORMAT, dir  ) != 1) 
-		return "mal-formatted DIR header";
-
-	// read the file name and length
-	char file[MAX_NAME];
-	long long len;
-	if (sscanf( b->file_header, FIL_FORMAT, file, &len ) != 2) 
-		return "mal-formatted FILE header";
-
-	// validate the name
+	// find the final part of the name
 	const char *s;
 	for(s = path; *s && s[1]; s++);
 	while( s > path && s[-1] != '/' ) s--;
-	if (strcmp(s, file)) {
-		return "file name mis-match";
+
+	// version 2 headers only record a hash of the name
+	long long len;
+	if (is_v2( buf )) {
+		struct v2_header *h = (struct v2_header *) buf;
+		if (h->file_id != fnv_hash( s ))
+			return "file name mis-match";
+		len = h->file_length;
+	} else {
+		// read off the creation time
+		//	if it parses, I'm going to call it right for now
+		//	but if I were cool I'd make sure the file was no
+		//	older than this date/time
+		int mon, day, year, hour, min, sec;
+		if (sscanf( b->run_header, RUN_READBK, &mon, &day, &year, &hour, &min, &sec  ) != 6) 
+			return "mal-formatted RUN header";
+
+		// read the directory name
+		// 	but don't validate it because we might want
+		//	over-constrain our ability to validate data
+		//	long after we forgot how we generated it
+		char dir[MAX_NAME];
+		if (sscanf( b->thread_header, DIR_FORMAT, dir  ) != 1) 
+			return "mal-formatted DIR header";
+
+		// read the file name and length
+		char file[MAX_NAME];
+		if (sscanf( b->file_header, FIL_FORMAT, file, &len ) != 2) 
+			return "mal-formatted FILE header";
+
+		// validate the name
+		if (strcmp(s, file)) {
+			return "file name mis-match";
+		}
 	}
 
 	// validate the length
+	//	(a device is not the length of the file written on it)
 	struct stat statb;
 	if (stat( path, &statb ) < 0)
 		return "unable to stat";
+	if (S_ISBLK(statb.st_mode))
+		return NULL;
 	if (statb.st_size > len)
 		return "file too long";
 	if (statb.st_size < len)
@@ -393,6 +964,29 @@ checkFile( const char *buf, const char *path ) {
  */
 const char *
 checkData( const char *buf, int bsize ) {
+	// version 2 payloads are regenerated from (or checked against
+	//	the CRC in) their own header
+	if (is_v2( buf )) {
+		struct v2_header *h = (struct v2_header *) buf;
+		if ((uint32_t) bsize < h->bsize)
+			return "partial block";
+		if (h->payload == PAYLOAD_UNIQUE) {
+			if (!regenerate( block_key( h ), &buf[sizeof *h], h->bsize - sizeof *h ))
+				return "incorrect unique data";
+		} else if (PAYLOAD_TYPE( h->payload ) == PAYLOAD_COMPRESS) {
+			unsigned ratio = PAYLOAD_PARAM( h->payload );
+			if (ratio < 100 || ratio > MAX_COMPRESS_RATIO * 100)
+				return "unsupported compression ratio";
+			if (!regenerate_segments( block_key( h ), ratio,
+					&buf[sizeof *h], h->bsize - sizeof *h ))
+				return "incorrect compressible data";
+		} else if (h->payload != PAYLOAD_PATTERN)
+			return "unsupported payload type";
+		else if (h->data_crc != crc32c( 0, &buf[sizeof *h], h->bsize - sizeof *h ))
+			return "data checksum error";
+		return NULL;
+	}
+
 	int i = sizeof (struct buf_header);
 	for( int x = 0; i < bsize; i++ ) {
 		if (buf[i] == (((i%64) == 63) ? '\n' : pattern[(x++)%64]))
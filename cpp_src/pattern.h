@@ -5,16 +5,25 @@
  *	fileHeader:	header to describe the specific file
  *	blockHeader:	header to describe each block
  *	
+ *	setGeneration:	note the write generation of a rewritten file
+ *	
  *	fillData:	fill the remainder of a block with pattern data
  *	
  *	checkData	validate the correctness of a block
  *	fileLength	expected length of this file
+ *
+ *	Blocks are written in the format selected by loadgen_format
+ *	(1: four text header lines, 2: one binary header with CRC32Cs)
+ *	and the check routines recognize either.
  */
 void runHeader( char *buf, const char *tag );
 void threadHeader( char *buf, const char *name );
 void fileHeader( char *buf, const char *name, long long len );
 void blockHeader( char *buf, long bsize, long long offset );
 
+// note the generation of a file that is being (re)written
+void setGeneration( char *buf, unsigned long generation );
+
 // fill out the remainder of the block with pattern data
 void fillData( char *buf, int bsize );
 
@@ -36,6 +45,15 @@ long get_block_size( const char *buf );
 // length of the block size used for this file
 long long get_file_size( const char *buf );
 
+// write generation of this block (0 if not recorded)
+unsigned long get_generation( const char *buf );
+
+// format (1 or 2) this block was written in
+int get_format( const char *buf );
+
+// is this a never-written (all zero) block
+bool unwritten( const char *buf, int bsize );
+
 // largest supported block size
 long max_bsize();
 
@@ -43,9 +61,12 @@ long max_bsize();
 long choose_bsize( long alignment, long long maxlen );
 
 // choose a random block of a file
-long choose_block( long long max_blocks );
+long long choose_block( long long max_blocks );
 
 // choose a random file size
 long long choose_file_size( long bsize );
 
 #define	DEFAULT_ALIGNMENT	8192
+
+// largest supported --compress-ratio (8 random bytes in every 512)
+#define	MAX_COMPRESS_RATIO	64
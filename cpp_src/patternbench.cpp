@@ -0,0 +1,226 @@
+/**
+ * module:	patternbench.cpp
+ *<P>
+ * purpose:
+ *	micro-benchmark for the per-block pattern data routines
+ *
+ *	Every block we write goes through blockHeader, and every
+ *	block we verify goes through checkHeaders, so their cost
+ *	(in nanoseconds per block) bounds the IOPS we can drive.
+ *	For comparison, we also time the original snprintf/sscanf
+ *	implementation, and confirm that the two produce identical
+ *	block headers.  We also time the version 2 (binary header
+ *	with CRC32C) stamping and verification, and the rate at
+ *	which we can generate (and verify) unique data.
+ *
+ * usage:
+ *	patternbench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pattern.h"
+#include "crc32c.h"
+
+int loadgen_format = 1;		///< format written by the pattern routines
+bool loadgen_unique = false;	///< write un-dedupable data
+double loadgen_compress = 0;	///< target compression ratio (if any)
+
+#define	BSIZE		4096
+#define	BIGSIZE		(1024*1024)
+#define	WIDTH		64
+#define	BLK_LINE	(3*WIDTH)	// offset of the block header line
+#define	BLK_FORMAT	"#BLK bsize=%ld offset=%llu"
+
+/**
+ * the way blockHeader used to do it (for comparison)
+ */
+static void oldBlockHeader( char *buf, long bsize, long long offset ) {
+	char *p = &buf[BLK_LINE];
+	snprintf( p, WIDTH, BLK_FORMAT, bsize, offset );
+
+	int i;
+	for( i = 0; i < WIDTH-1 && p[i] != 0; i++ );
+	while( i < WIDTH-1 )
+		p[i++] = ' ';
+	p[WIDTH-1] = '\n';
+}
+
+/**
+ * the way checkHeaders used to parse the block header (for comparison)
+ */
+static bool oldCheckBlock( const char *buf, long bsize, long long offset ) {
+	if (strncmp( &buf[0], "#RUN ", 5 ) || strncmp( &buf[WIDTH], "#DIR ", 5 ) ||
+	    strncmp( &buf[2*WIDTH], "#FIL ", 5 ) || strncmp( &buf[BLK_LINE], "#BLK ", 5 ))
+		return false;
+
+	long this_bsize;
+	long long this_offset;
+	if (sscanf( &buf[BLK_LINE], BLK_FORMAT, &this_bsize, &this_offset ) != 2)
+		return false;
+	return this_bsize == bsize && this_offset == offset;
+}
+
+/**
+ * high resolution (monotonic) time in nanoseconds
+ */
+static double now_ns() {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+int main( int argc, char **argv ) {
+	long iterations = (argc > 1) ? atol( argv[1] ) : 10000000;
+	static char buf1[BSIZE], buf2[BSIZE];
+	int errors = 0;
+
+	// build a complete block the normal way
+	runHeader( buf1, "patternbench" );
+	threadHeader( buf1, "/bench" );
+	fileHeader( buf1, "/bench/FILE_000000", 1LL << 40 );
+	fillData( buf1, BSIZE );
+	memcpy( buf2, buf1, BSIZE );
+
+	// confirm the new headers are byte-identical to the old ones
+	long long samples[] = { 0, 1, 9, 10, 99, 100, 4095, 4096, 65536,
+		1000000007LL, 1LL << 40, 999999999999999999LL, -1 };
+	long sizes[] = { 256, 4096, 2*1024*1024, 2147483647L };
+	for( unsigned s = 0; s < sizeof sizes/sizeof sizes[0]; s++ )
+		for( int o = 0; samples[o] >= 0; o++ ) {
+			blockHeader( buf1, sizes[s], samples[o] );
+			oldBlockHeader( buf2, sizes[s], samples[o] );
+			if (memcmp( buf1, buf2, BSIZE )) {
+				fprintf(stderr, "header mismatch: bsize=%ld offset=%lld\n",
+					sizes[s], samples[o] );
+				errors++;
+			}
+			if (checkHeaders( buf1, sizes[s], samples[o] ) != 0) {
+				fprintf(stderr, "header rejected: bsize=%ld offset=%lld\n",
+					sizes[s], samples[o] );
+				errors++;
+			}
+		}
+
+	// time the old and new header generation
+	double start = now_ns();
+	for( long i = 0; i < iterations; i++ )
+		oldBlockHeader( buf2, BSIZE, i * BSIZE );
+	double old_gen = (now_ns() - start) / iterations;
+
+	start = now_ns();
+	for( long i = 0; i < iterations; i++ )
+		blockHeader( buf1, BSIZE, i * BSIZE );
+	double new_gen = (now_ns() - start) / iterations;
+
+	// time the old and new header checking
+	start = now_ns();
+	for( long i = 0; i < iterations; i++ )
+		if (!oldCheckBlock( buf2, BSIZE, (iterations - 1) * BSIZE ))
+			errors++;
+	double old_chk = (now_ns() - start) / iterations;
+
+	start = now_ns();
+	for( long i = 0; i < iterations; i++ )
+		if (checkHeaders( buf1, BSIZE, (iterations - 1) * BSIZE ) != 0)
+			errors++;
+	double new_chk = (now_ns() - start) / iterations;
+
+	printf("blockHeader:  %7.1f ns/block (snprintf: %7.1f)\n", new_gen, old_gen );
+	printf("checkHeaders: %7.1f ns/block (sscanf:   %7.1f)\n", new_chk, old_chk );
+
+	// make sure we are computing the right CRC
+	if (crc32c( 0, "123456789", 9 ) != 0xe3069283) {
+		fprintf(stderr, "incorrect CRC32C\n");
+		errors++;
+	}
+
+	// time the version 2 format: a new header for every block,
+	//	and a full header/payload check for every block
+	loadgen_format = 2;
+	runHeader( buf1, "patternbench" );
+	fileHeader( buf1, "/bench/FILE_000000", 1LL << 40 );
+	fillData( buf1, BSIZE );
+
+	start = now_ns();
+	for( long i = 0; i < iterations; i++ )
+		blockHeader( buf1, BSIZE, i * BSIZE );
+	double v2_gen = (now_ns() - start) / iterations;
+
+	start = now_ns();
+	for( long i = 0; i < iterations; i++ )
+		if (checkHeaders( buf1, BSIZE, (iterations - 1) * BSIZE ) != 0 ||
+		    checkData( buf1, BSIZE ) != 0)
+			errors++;
+	double v2_chk = (now_ns() - start) / iterations;
+
+	// and the version 1 data check, for comparison
+	loadgen_format = 1;
+	runHeader( buf2, "patternbench" );
+	fillData( buf2, BSIZE );
+	start = now_ns();
+	for( long i = 0; i < iterations/10; i++ )
+		if (checkData( buf2, BSIZE ) != 0)
+			errors++;
+	double v1_chk = (now_ns() - start) / (iterations/10);
+
+	printf("v2 header:    %7.1f ns/block\n", v2_gen );
+	printf("v2 verify:    %7.1f ns/%d byte block (v1 pattern: %7.1f, crc32 %s)\n",
+		v2_chk, BSIZE, v1_chk, crc32c_hardware() ? "hardware" : "software" );
+
+	// time unique data generation and verification
+	//	in larger blocks, where the per-block costs disappear
+	static char big[BIGSIZE];
+	long blocks = (iterations / 100) + 1;
+	loadgen_format = 2;
+	loadgen_unique = true;
+	runHeader( big, "patternbench" );
+	fileHeader( big, "/bench/FILE_000000", 1LL << 40 );
+	fillData( big, BIGSIZE );
+
+	start = now_ns();
+	for( long i = 0; i < blocks; i++ )
+		blockHeader( big, BIGSIZE, i * BIGSIZE );
+	double gen_gbs = ((double) blocks * BIGSIZE) / (now_ns() - start);
+
+	start = now_ns();
+	for( long i = 0; i < blocks; i++ )
+		if (checkData( big, BIGSIZE ) != 0)
+			errors++;
+	double chk_gbs = ((double) blocks * BIGSIZE) / (now_ns() - start);
+
+	// two successive blocks should have nothing in common
+	memcpy( buf1, big, BSIZE );
+	blockHeader( big, BIGSIZE, blocks * BIGSIZE );
+	if (memcmp( &buf1[WIDTH], &big[WIDTH], BSIZE - WIDTH ) == 0) {
+		fprintf(stderr, "unique data repeated\n");
+		errors++;
+	}
+	printf("unique data:  %7.2f GB/s generate, %7.2f GB/s verify\n",
+		gen_gbs, chk_gbs );
+
+	// and the same for 4:1 compressible data
+	loadgen_compress = 4;
+	runHeader( big, "patternbench" );
+	fillData( big, BIGSIZE );
+
+	start = now_ns();
+	for( long i = 0; i < blocks; i++ )
+		blockHeader( big, BIGSIZE, i * BIGSIZE );
+	gen_gbs = ((double) blocks * BIGSIZE) / (now_ns() - start);
+
+	start = now_ns();
+	for( long i = 0; i < blocks; i++ )
+		if (checkData( big, BIGSIZE ) != 0)
+			errors++;
+	chk_gbs = ((double) blocks * BIGSIZE) / (now_ns() - start);
+	printf("4:1 data:     %7.2f GB/s generate, %7.2f GB/s verify\n",
+		gen_gbs, chk_gbs );
+
+	if (errors)
+		printf("%d errors\n", errors );
+
+	return errors ? 1 : 0;
+}
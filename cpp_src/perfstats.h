@@ -3,6 +3,12 @@
 /* maximum number of latency buckets	*/
 #define	MAX_LATENCY_BUCKETS	24
 
+/* the latency reporting buckets (micro-seconds), the last unlimited
+ *	(also used by loadgen-merge, since the reports give only counts) */
+static const long latency_limits[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512,
+			1000, 2000, 4000, 8000, 16000, 32000,
+			64000, 128000, 256000, 512000, -1 };
+
 typedef long long unsigned hires_time_t;
 
 /**
@@ -13,36 +19,45 @@ class perfstats {
     public:
 	long		total_files;	///< total files processed
 	long long 	total_bytes;	///< total bytes written
+	long		reads;		///< read operations
+	long		writes;		///< write operations
 	hires_time_t	total_usecs;	///< total usecs spent doing I/O
 	hires_time_t	min_time;	///< minimum time per IO op
 	hires_time_t	max_time;	///< maximum time per IO op
-	long		*buckets;	///< latency bucket counters
+	long		buckets[MAX_LATENCY_BUCKETS];	///< latency bucket counters
+	long		flushes;	///< flush (fsync, sync_file_range) operations
+	hires_time_t	flush_usecs;	///< total usecs spent flushing
+	hires_time_t	flush_max;	///< maximum time per flush
+	long		flush_buckets[MAX_LATENCY_BUCKETS];	///< flush latency bucket counters
 
 	static int num_buckets;
 	static long *limits;
 
+	// (everything is in-line, so that it can be in shared memory)
 	perfstats() {
-		buckets = new long[MAX_LATENCY_BUCKETS];
 		reset();
 	}
 
-	~perfstats() {
-		delete[] buckets;
-	}
-
 	void reset() {
 		total_files = 0;
 		total_bytes = 0;
+		reads = 0;
+		writes = 0;
 		total_usecs = 0ULL;
 		min_time = 0ULL;
 		max_time = 0ULL;
 		
 		for( int i = 0; i < MAX_LATENCY_BUCKETS; i++ )
 			buckets[i] = 0L;
+		flushes = 0;
+		flush_usecs = 0ULL;
+		flush_max = 0ULL;
+		for( int i = 0; i < MAX_LATENCY_BUCKETS; i++ )
+			flush_buckets[i] = 0L;
 	}
 
 
-	static void setlimits( long *p ) {
+	static void setlimits( const long *p ) {
 		if (limits == 0)
 			limits = new long[MAX_LATENCY_BUCKETS];
 
@@ -58,10 +73,18 @@ class perfstats {
 	perfstats &operator=( const perfstats &rhs ) {
 		this->total_files = rhs.total_files;
 		this->total_bytes = rhs.total_bytes;
+		this->reads = rhs.reads;
+		this->writes = rhs.writes;
+		this->total_usecs = rhs.total_usecs;
 		for( int i = 0; i < MAX_LATENCY_BUCKETS; i++ )
 			this->buckets[i] = rhs.buckets[i];
 		this->max_time = rhs.max_time;
 		this->min_time = rhs.min_time;
+		this->flushes = rhs.flushes;
+		this->flush_usecs = rhs.flush_usecs;
+		this->flush_max = rhs.flush_max;
+		for( int i = 0; i < MAX_LATENCY_BUCKETS; i++ )
+			this->flush_buckets[i] = rhs.flush_buckets[i];
 
 		return *this;
 	}
@@ -70,12 +93,21 @@ class perfstats {
 	perfstats &operator+=( const perfstats &rhs ) {
 		this->total_files += rhs.total_files;
 		this->total_bytes += rhs.total_bytes;
+		this->reads += rhs.reads;
+		this->writes += rhs.writes;
+		this->total_usecs += rhs.total_usecs;
 		for( int i = 0; i < MAX_LATENCY_BUCKETS; i++ )
 			this->buckets[i] += rhs.buckets[i];
 		if (rhs.max_time > this->max_time)
 			this->max_time = rhs.max_time;
-		if (this->min_time == 0 || rhs.min_time < this->min_time)
+		if (rhs.min_time != 0 && (this->min_time == 0 || rhs.min_time < this->min_time))
 			this->min_time = rhs.min_time;
+		this->flushes += rhs.flushes;
+		this->flush_usecs += rhs.flush_usecs;
+		for( int i = 0; i < MAX_LATENCY_BUCKETS; i++ )
+			this->flush_buckets[i] += rhs.flush_buckets[i];
+		if (rhs.flush_max > this->flush_max)
+			this->flush_max = rhs.flush_max;
 
 		return *this;
 	}
@@ -84,20 +116,33 @@ class perfstats {
 	perfstats &operator-=( const perfstats &rhs ) {
 		this->total_files -= rhs.total_files;
 		this->total_bytes -= rhs.total_bytes;
+		this->reads -= rhs.reads;
+		this->writes -= rhs.writes;
+		this->total_usecs -= rhs.total_usecs;
 		for( int i = 0; i < MAX_LATENCY_BUCKETS; i++ )
 			this->buckets[i] -= rhs.buckets[i];
 		if (rhs.max_time > this->max_time)
 			this->max_time = rhs.max_time;
-		if (this->min_time == 0 || rhs.min_time < this->min_time)
+		if (rhs.min_time != 0 && (this->min_time == 0 || rhs.min_time < this->min_time))
 			this->min_time = rhs.min_time;
+		this->flushes -= rhs.flushes;
+		this->flush_usecs -= rhs.flush_usecs;
+		for( int i = 0; i < MAX_LATENCY_BUCKETS; i++ )
+			this->flush_buckets[i] -= rhs.flush_buckets[i];
+		if (rhs.flush_max > this->flush_max)
+			this->flush_max = rhs.flush_max;
 
 		return *this;
 	}
 
-	void xfer_done( long long bytes, hires_time_t us ) {
+	void xfer_done( long long bytes, hires_time_t us, bool write ) {
 		// note the transfer
 		total_bytes += bytes;
 		total_usecs += us;
+		if (write)
+			writes++;
+		else
+			reads++;
 
 		// update the max/min transfer times
 		if (min_time == 0 || min_time > us)
@@ -106,16 +151,99 @@ class perfstats {
 			max_time = us;
 	
 		// put this operation into a bucket
+		buckets[bucket( us )]++;
+	}
+
+	// flushes have a histogram of their own (so writes are not skewed)
+	void flush_done( hires_time_t us ) {
+		flushes++;
+		flush_usecs += us;
+		if (flush_max < us)
+			flush_max = us;
+		flush_buckets[bucket( us )]++;
+	}
+
+	// the latency bucket into which an operation falls
+	static int bucket( hires_time_t us ) {
 		int i;
 		for( i = 0; i < MAX_LATENCY_BUCKETS && limits[i] > 0; i++ )
 			if (us <= (unsigned long) limits[i])
 				break;
-		buckets[i]++;
+		return i;
 	}
 
 	void file_done() {
 		total_files++;
 	}
+
+	/**
+	 * estimate a latency percentile from the bucket counts
+	 *
+	 * @param	percentile (e.g. 99.9)
+	 * @return	upper limit (in us) of the bucket containing it
+	 *		(max_time for the last, unbounded, bucket), or 0
+	 *		if there have been no operations
+	 */
+	long percentile( double pct ) const {
+		return percentile( buckets, max_time, pct );
+	}
+
+	/**
+	 * estimate a flush latency percentile (in the same way)
+	 */
+	long flush_percentile( double pct ) const {
+		return percentile( flush_buckets, flush_max, pct );
+	}
+
+	static long percentile( const long *counts, hires_time_t max, double pct ) {
+		long total = 0;
+		for( int i = 0; i < num_buckets; i++ )
+			total += counts[i];
+		if (total == 0)
+			return 0;
+
+		long want = (long) ((pct * total + 99.999) / 100);
+		long seen = 0;
+		for( int i = 0; i < num_buckets; i++ ) {
+			seen += counts[i];
+			if (seen >= want)
+				return (limits[i] > 0) ? limits[i] : (long) max;
+		}
+		return (long) max;
+	}
+
+	/**
+	 * estimate a latency percentile more finely, by assuming that
+	 *	the latencies are spread evenly through the bucket that
+	 *	contains it (and no higher than the longest we have seen)
+	 *
+	 * @param	percentile (e.g. 99.9)
+	 * @return	estimated latency (in us), or 0 if there
+	 *		have been no operations
+	 */
+	long interpolated( double pct ) const {
+		long total = 0;
+		for( int i = 0; i < num_buckets; i++ )
+			total += buckets[i];
+		if (total == 0)
+			return 0;
+
+		long want = (long) ((pct * total + 99.999) / 100);
+		long seen = 0;
+		for( int i = 0; i < num_buckets; i++ ) {
+			if (seen + buckets[i] < want) {
+				seen += buckets[i];
+				continue;
+			}
+			long low = (i > 0) ? limits[i-1] : 0;
+			long high = (limits[i] > 0 && limits[i] < (long) max_time) ? 
+					limits[i] : (long) max_time;
+			if (high <= low)
+				return high;
+			return low + (high - low) * (want - seen) / buckets[i];
+		}
+		return (long) max_time;
+	}
 };
 
 extern hires_time_t hires_time();
@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "loadgen.h"
+#include "profile.h"
+#include "debug.h"
+
+// most segments we will accept (in each timeline)
+#define	MAX_SEGMENTS	256
+
+// how often (ms) ramps and waves are re-evaluated
+#define	PROFILE_TICK	100
+
+// never (a time after anything we will ever be asked to do)
+#define	NEVER		(1LL << 62)
+
+enum shape { STEP, RAMP, SINE, SQUARE };
+
+struct segment {
+	enum shape shape;
+	double	low;		///< (initial) value
+	double	high;		///< (final/peak) value
+	long long period;	///< of a sine or square wave (ms)
+	double	duty;		///< fraction of a square wave spent high
+	long long start;	///< offset into the timeline (ms)
+	long long duration;	///< length of this segment (ms)
+};
+
+struct timeline {
+	int	num;			///< number of segments
+	long long length;		///< total length (ms)
+	struct segment segs[MAX_SEGMENTS];
+};
+
+#define	THREADS	0
+#define	RATE	1
+static struct timeline timelines[2];	// thread and rate timelines
+
+static bool profiled = false;	// we have a profile
+static bool repeating = false;	// it repeats
+static bool ending = false;	// it shuts us down when it is done
+static bool started = false;	// its clock has started
+static long long startTime;	// when it started (CLOCK_MONOTONIC ms)
+static long long overridden = -1;	// the master has the threads until then
+static int lastThreads = -1;	// the last thread count we asked for
+static long long rateOverridden = -1;	// the master has the rate until then
+
+/*
+ * parse one segment of a profile
+ *
+ * @param	segment to be parsed (which we trash)
+ * @param	characters that separate its fields
+ * @return	NULL if OK, else a description of the problem
+ */
+static const char *addSegment( char *s, const char *seps ) {
+	char *words[8];
+	int n = 0;
+	char *save = 0;
+	for( char *w = strtok_r( s, seps, &save ); w; w = strtok_r( 0, seps, &save )) {
+		if (n >= 8)
+			return "Malformed load profile";
+		words[n++] = w;
+	}
+	if (n == 0)
+		return 0;
+
+	if (strcmp( words[0], "repeat" ) == 0 && n == 1) {
+		repeating = true;
+		return 0;
+	}
+	if (strcmp( words[0], "end" ) == 0 && n == 1) {
+		ending = true;
+		return 0;
+	}
+
+	struct timeline *tl;
+	if (strcmp( words[0], "threads" ) == 0)
+		tl = &timelines[THREADS];
+	else if (strcmp( words[0], "rate" ) == 0)
+		tl = &timelines[RATE];
+	else
+		return "Malformed load profile";
+	if (tl->num >= MAX_SEGMENTS)
+		return "Too many load profile segments";
+
+	struct segment *seg = &tl->segs[tl->num];
+	seg->period = 0;
+	seg->duty = 0.5;
+	if (n == 4 && strcmp( words[1], "step" ) == 0) {
+		seg->shape = STEP;
+		seg->low = seg->high = getSizeSpec( words[2] );
+		seg->duration = getTimeSpec( words[3] );
+	} else if (n == 5 && strcmp( words[1], "ramp" ) == 0) {
+		seg->shape = RAMP;
+		seg->low = getSizeSpec( words[2] );
+		seg->high = getSizeSpec( words[3] );
+		seg->duration = getTimeSpec( words[4] );
+	} else if (n == 6 && strcmp( words[1], "sine" ) == 0) {
+		seg->shape = SINE;
+		seg->low = getSizeSpec( words[2] );
+		seg->high = getSizeSpec( words[3] );
+		seg->period = getTimeSpec( words[4] );
+		seg->duration = getTimeSpec( words[5] );
+	} else if ((n == 6 || n == 7) && strcmp( words[1], "square" ) == 0) {
+		seg->shape = SQUARE;
+		seg->low = getSizeSpec( words[2] );
+		seg->high = getSizeSpec( words[3] );
+		seg->period = getTimeSpec( words[4] );
+		seg->duration = getTimeSpec( words[5] );
+		if (n == 7)
+			seg->duty = atof( words[6] ) / 100;
+		if (seg->duty <= 0 || seg->duty >= 1)
+			return "Invalid load profile duty cycle";
+	} else
+		return "Malformed load profile";
+
+	if (seg->duration <= 0 || (seg->shape >= SINE && seg->period <= 0))
+		return "Invalid load profile duration";
+	if (tl == &timelines[THREADS] &&
+	    (seg->low < 0 || seg->high < 0 || seg->low > MAX_THREADS || seg->high > MAX_THREADS))
+		return "Invalid load profile thread count";
+	if (seg->low < 0 || seg->high < 0)
+		return "Invalid load profile rate";
+
+	seg->start = tl->length;
+	tl->length += seg->duration;
+	tl->num++;
+	return 0;
+}
+
+/*
+ * parse a profile (from a file or in-line)
+ */
+const char *setProfile( const char *spec ) {
+	const char *err = 0;
+
+	FILE *f = fopen( spec, "r" );
+	if (f) {
+		// one segment per line, with whitespace between the fields
+		char line[256];
+		while( err == 0 && fgets( line, sizeof line, f )) {
+			char *p = strchr( line, '#' );
+			if (p)
+				*p = 0;
+			err = addSegment( line, " \t\r\n:" );
+		}
+		fclose( f );
+	} else {
+		// comma separated segments, with colons between the fields
+		char *copy = strdup( spec );
+		char *save = 0;
+		for( char *s = strtok_r( copy, ",", &save ); s && err == 0; s = strtok_r( 0, ",", &save ))
+			err = addSegment( s, ":" );
+		free( copy );
+	}
+	if (err)
+		return err;
+
+	if (repeating && ending)
+		return "A load profile cannot both repeat and end";
+	if (timelines[THREADS].num == 0 && timelines[RATE].num == 0)
+		return "Empty load profile";
+	profiled = true;
+	return 0;
+}
+
+/*
+ * the value of a segment at some point in it
+ *
+ * @param	segment
+ * @param	time (ms) since the start of the segment
+ * @param	(returned) time (ms since the start of the segment)
+ *		at which the value will next change
+ * @return	value
+ */
+static double valueAt( const struct segment *seg, long long t, long long *next ) {
+	switch( seg->shape ) {
+	    case STEP:
+		*next = seg->duration;
+		return seg->low;
+
+	    case RAMP:
+		*next = t + PROFILE_TICK;
+		return seg->low + (seg->high - seg->low) * t / seg->duration;
+
+	    case SINE:
+		*next = t + PROFILE_TICK;
+		return seg->low + (seg->high - seg->low) *
+			(1 - cos( 2 * M_PI * (t % seg->period) / seg->period )) / 2;
+
+	    case SQUARE: {
+		long long phase = t % seg->period;
+		long long edge = (long long) (seg->duty * seg->period);
+		if (phase < edge) {
+			*next = t - phase + edge;
+			return seg->high;
+		}
+		*next = t - phase + seg->period;
+		return seg->low;
+	    }
+	}
+	return 0;
+}
+
+/*
+ * the value of a timeline at some point in it
+ *
+ * @param	timeline
+ * @param	time (ms) since the profile started
+ * @param	(returned) time at which the value will next change
+ * @param	(returned) time at which the current segment ends
+ * @return	value
+ */
+static double evaluate( const struct timeline *tl, long long t, long long *next, long long *end ) {
+	// when we run off the end, we start over or hold the last value
+	long long base = 0;
+	if (t >= tl->length) {
+		if (!repeating) {
+			const struct segment *last = &tl->segs[tl->num - 1];
+			long long ignore;
+			*next = NEVER;
+			*end = NEVER;
+			return valueAt( last, last->duration - 1, &ignore );
+		}
+		base = t - (t % tl->length);
+		t -= base;
+	}
+
+	int i = 0;
+	while( i < tl->num - 1 && t >= tl->segs[i].start + tl->segs[i].duration )
+		i++;
+	const struct segment *seg = &tl->segs[i];
+
+	long long when;
+	double v = valueAt( seg, t - seg->start, &when );
+	*end = base + seg->start + seg->duration;
+	*next = base + seg->start + when;
+	if (*next > *end)
+		*next = *end;
+	return v;
+}
+
+/*
+ * is there (still) a profile that can change the number of threads
+ */
+bool profileActive() {
+	if (!profiled || timelines[THREADS].num == 0)
+		return false;
+	if (repeating || !started)
+		return true;
+
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	long long t = now.tv_sec * 1000LL + now.tv_nsec / 1000000 - startTime;
+	return t < timelines[THREADS].length;
+}
+
+/*
+ * figure out what the profile calls for now
+ */
+int profileUpdate( const struct timespec *now, struct timespec *next ) {
+	long long ms = now->tv_sec * 1000LL + now->tv_nsec / 1000000;
+	if (!profiled) {
+		next->tv_sec = now->tv_sec + 86400;
+		next->tv_nsec = now->tv_nsec;
+		return -1;
+	}
+	if (!started) {
+		startTime = ms;
+		started = true;
+	}
+	long long t = ms - startTime;
+	long long soonest = NEVER;
+	long long when, end;
+
+	// the rate applies to every thread's next operation
+	if (timelines[RATE].num > 0) {
+		long long rate = (long long) (evaluate( &timelines[RATE], t, &when, &end ) + 0.5);
+		if (t < rateOverridden)
+			when = rateOverridden;
+		else if (rate != loadgen_rate) {
+			loadgen_rate = rate;
+			if (loadgen_debug & D_SLEEP)
+				fprintf(stderr, "# profile sets rate to %lld\n", rate );
+		}
+		if (when < soonest)
+			soonest = when;
+	}
+
+	// the thread count is ours, unless the master has taken it over
+	int threads = -1;
+	if (timelines[THREADS].num > 0) {
+		double v = evaluate( &timelines[THREADS], t, &when, &end );
+		if (t >= overridden) {
+			threads = (int) (v + 0.5);
+			if (threads != lastThreads && (loadgen_debug & D_CMDS))
+				fprintf(stderr, "# profile sets threads to %d\n", threads );
+			lastThreads = threads;
+		} else
+			when = overridden;
+		if (when < soonest)
+			soonest = when;
+	}
+
+	// see if it is time to shut down
+	if (ending) {
+		long long last = timelines[THREADS].length;
+		if (timelines[RATE].length > last)
+			last = timelines[RATE].length;
+		if (t >= last)
+			loadgen_shutdown = true;
+		else if (last < soonest)
+			soonest = last;
+	}
+
+	// and when we should next take a look
+	if (soonest == NEVER)
+		soonest = t + 86400000LL;
+	long long wake = startTime + soonest;
+	next->tv_sec = wake / 1000;
+	next->tv_nsec = (wake % 1000) * 1000000;
+	return threads;
+}
+
+/*
+ * the master has set the thread count, which it keeps until
+ * the next thread segment starts
+ */
+void profileOverride() {
+	if (!profiled || timelines[THREADS].num == 0 || !started)
+		return;
+
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	long long t = now.tv_sec * 1000LL + now.tv_nsec / 1000000 - startTime;
+	long long when;
+	evaluate( &timelines[THREADS], t, &when, &overridden );
+	lastThreads = -1;
+}
+
+/*
+ * the master has set the rate, which it keeps until the next
+ * rate segment starts
+ */
+void profileRateOverride() {
+	if (!profiled || timelines[RATE].num == 0 || !started)
+		return;
+
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	long long t = now.tv_sec * 1000LL + now.tv_nsec / 1000000 - startTime;
+	long long when;
+	evaluate( &timelines[RATE], t, &when, &rateOverridden );
+}
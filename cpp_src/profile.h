@@ -0,0 +1,74 @@
+#include <time.h>
+
+/*
+ * built-in load profiles
+ *
+ *	Rather than waiting for a master to send it thread counts, a
+ *	loadgen can follow its own timeline: a sequence of segments,
+ *	each of which controls the number of threads or the (per-thread)
+ *	rate for some period of time:
+ *
+ *	threads step N DURATION			hold N
+ *	threads ramp FROM TO DURATION		linear change from FROM to TO
+ *	threads sine LOW HIGH PERIOD DURATION	starting at LOW, peaking at
+ *						HIGH half way through each period
+ *	threads square LOW HIGH PERIOD DURATION [DUTY%]
+ *						HIGH for the first DUTY (default
+ *						50%) of each period, then LOW
+ *	rate ...				(the same shapes, in bytes/sec,
+ *						with the usual K/M/G suffixes)
+ *	repeat					go back to the start (of both)
+ *	end					shut down
+ *
+ *	Thread and rate segments form two independent timelines, which
+ *	both start when the thread manager does.  When a timeline runs
+ *	out, its last value is held (unless the profile repeats or ends).
+ *	Durations and periods are in seconds (or ms, m or h).  Thread
+ *	counts are re-evaluated frequently, so that threads are started
+ *	(and parked) one at a time over the course of a ramp.
+ *
+ *	A profile can be read from a file (one segment per line, with
+ *	# comments) or given in-line, with the fields of each segment
+ *	separated by colons and the segments by commas, e.g.
+ *
+ *		threads:ramp:1:8:60,threads:sine:2:8:600:3600,repeat
+ *
+ *	A thread count (or rate) from the master overrides the profile
+ *	until the next thread (or rate) segment starts.
+ */
+
+/**
+ * parse a profile
+ *
+ * @param	name of a profile file, or an in-line profile
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *setProfile( const char *spec );
+
+/**
+ * is there (still) a profile that can change the number of threads
+ *
+ * @return	true if there is
+ */
+bool profileActive();
+
+/**
+ * figure out what the profile calls for now
+ *	(updating loadgen_rate if the profile controls it)
+ *
+ * @param	current CLOCK_MONOTONIC time
+ * @param	(returned) CLOCK_MONOTONIC time of the next change
+ * @return	desired number of threads (or -1 if there is no
+ *		profile, or it does not currently control it)
+ */
+int profileUpdate( const struct timespec *now, struct timespec *next );
+
+/**
+ * note that the master has overridden the profile's thread count
+ */
+void profileOverride();
+
+/**
+ * note that the master has overridden the profile's rate
+ */
+void profileRateOverride();
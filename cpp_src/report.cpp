@@ -1,51 +1,536 @@
 #include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
 #include <time.h>
 
 #include "loadgen.h"
 #include "perfstats.h"
+#include "report.h"
 
 /* initialize the class statics	*/
 long *perfstats::limits = 0;
 int perfstats::num_buckets = 0;
 
-/**
- * generate an activity/bandwidth report
+// binary records are laid out for the largest possible number of buckets
+static_assert( REPORT_BUCKETS == MAX_LATENCY_BUCKETS, "report bucket count" );
+
+static int reportFormat = REPORT_TEXT;	// format of the (non-master) reports
+static FILE *reportFile = 0;		// where they go (if not stdout)
+static bool csvHeader = false;		// CSV header has been written
+static bool precise = false;		// text reports are for a submaster
+static struct timespec reportTime;	// time of the most recent report
+static struct tm reportTm;		// (broken down)
+
+/*
+ * set up the report format and (optional) report file
  */
-void 
-report( int threads, long microseconds, perfstats *s ) {
-	
+const char *setReports( const char *format, const char *file ) {
+	if (format == 0 || strcmp( format, "text" ) == 0)
+		reportFormat = REPORT_TEXT;
+	else if (strcmp( format, "precise" ) == 0) {
+		reportFormat = REPORT_TEXT;
+		precise = true;
+	} else if (strcmp( format, "json" ) == 0)
+		reportFormat = REPORT_JSON;
+	else if (strcmp( format, "csv" ) == 0)
+		reportFormat = REPORT_CSV;
+	else if (strcmp( format, "binary" ) == 0)
+		reportFormat = REPORT_BINARY;
+	else
+		return "Unknown report format";
+
+	if (file) {
+		reportFile = fopen( file, reportFormat == REPORT_BINARY ? "wb" : "w" );
+		if (reportFile == 0)
+			return "Unable to create report file";
+	} else if (reportFormat == REPORT_BINARY)
+		return "Binary reports require a report file";
+
+	return 0;
+}
+
+/*
+ * the date/time/tag prefix of a text report line
+ */
+static void textStamp( FILE *f, const char *kind, const struct tm *tm, const struct timespec *now ) {
+	// sub-second reporting intervals get sub-second times
+	bool msecs = (loadgen_update % 1000) != 0;
+
 	// print out a date/time header
-	time_t now;
-	time( &now );
-	struct tm *tm = localtime( &now );
-	fprintf(stdout, "REPORT date=%02d/%02d/%04d time=%02d:%02d:%02d ",
+	fprintf(f, "%s date=%02d/%02d/%04d time=%02d:%02d:%02d", kind,
 		tm->tm_mon+1, tm->tm_mday, tm->tm_year+1900,
 		tm->tm_hour, tm->tm_min, tm->tm_sec );
+	if (msecs)
+		fprintf(f, ".%03ld", now->tv_nsec / 1000000 );
+	fprintf(f, " ");
 
 	// print out the thread-tag
 	if (loadgen_tag)
-		fprintf(stdout, "tag=%s ", loadgen_tag );
+		fprintf(f, "tag=%s ", loadgen_tag );
+}
+
+/*
+ * the bytes/seconds/rate of a text report line
+ *
+ * @return	the buffer they were formatted in
+ */
+static const char *textRate( char *buf, size_t len, long microseconds, perfstats *s ) {
+	long long rate = microseconds > 0 ? (s->total_bytes * 1000000) / microseconds : 0;
+	if (precise)
+		snprintf( buf, len, "bytes=%lld seconds=%.6f rate=%lld ",
+			s->total_bytes, microseconds / 1000000.0, rate );
+	else if ((loadgen_update % 1000) != 0)
+		snprintf( buf, len, "bytes=%lld seconds=%.3f rate=%lld ",
+			s->total_bytes, microseconds / 1000000.0, rate );
+	else
+		snprintf( buf, len, "bytes=%lld seconds=%ld rate=%lld ",
+			s->total_bytes, (microseconds + 500000)/1000000, rate );
+	return buf;
+}
+
+/*
+ * the traditional report line, for the master (and humans)
+ */
+static void textReport( FILE *f, const struct tm *tm, const struct timespec *now,
+			int threads, long microseconds, perfstats *s ) {
+	textStamp( f, "REPORT", tm, now );
 
 	// print out the number of threads
-	fprintf(stdout, "threads=%d ", threads );
+	fprintf(f, "threads=%d ", threads );
+
+	// note the compression ratio we are writing (if one was requested)
+	if (loadgen_compress > 0 && !loadgen_read)
+		fprintf(f, "compress=%.2f ", loadgen_compress );
 
 	// print out the achieved throughput
 	if (s->total_bytes > 0 || threads > 0) {
-		long secs = (microseconds + 500000)/1000000;
-		fprintf(stdout, "bytes=%lld seconds=%ld rate=%lld ",
-			s->total_bytes, secs, (s->total_bytes * 1000000) / microseconds );
+		char rate[128];
+		fputs( textRate( rate, sizeof rate, microseconds, s ), f );
 
-#ifdef OBSOLETE
-		fprintf(stdout, "min_us=%llu max_us=%llu ",
-			s->min_time, s->max_time );
-#endif
+		// (which only a submaster, merging them, needs)
+		if (precise)
+			fprintf(f, "min_us=%llu max_us=%llu ",
+				s->min_time, s->max_time );
 
-		fprintf(stdout, "us_buckets=");
+		fprintf(f, "us_buckets=");
 		for( int i = 0; i < perfstats::num_buckets; i++ ) {
-			fprintf(stdout, i == 0 ? "%ld" : ",%ld", s->buckets[i] );
+			fprintf(f, i == 0 ? "%ld" : ",%ld", s->buckets[i] );
 		}
-		
-	} 
-	fprintf(stdout, "\n");
+
+	}
+	fprintf(f, "\n");
+}
+
+/*
+ * fill in a binary report record
+ *	(which is also the source of the JSON and CSV reports)
+ */
+static void fillRecord( struct reportRecord *r, const struct timespec *now,
+			int threads, long microseconds, perfstats *s ) {
+	memset( r, 0, sizeof *r );
+	r->magic = REPORT_MAGIC;
+	r->version = REPORT_VERSION;
+	r->size = sizeof *r;
+	r->end_us = now->tv_sec * 1000000LL + now->tv_nsec / 1000;
+	r->start_us = r->end_us - microseconds;
+	r->threads = threads;
+	r->num_buckets = perfstats::num_buckets;
+	r->bytes = s->total_bytes;
+	r->rate = microseconds > 0 ? (s->total_bytes * 1000000) / microseconds : 0;
+	r->files = s->total_files;
+	r->reads = s->reads;
+	r->writes = s->writes;
+	r->min_us = s->min_time;
+	r->max_us = s->max_time;
+	r->p50_us = s->percentile( 50 );
+	r->p90_us = s->percentile( 90 );
+	r->p99_us = s->percentile( 99 );
+	r->p999_us = s->percentile( 99.9 );
+	r->compress = (loadgen_compress > 0 && !loadgen_read) ? loadgen_compress : 0;
+	if (loadgen_tag)
+		strncpy( r->tag, loadgen_tag, sizeof r->tag - 1 );
+	for( int i = 0; i < REPORT_BUCKETS; i++ ) {
+		r->limits[i] = (i < perfstats::num_buckets) ? perfstats::limits[i] : -1;
+		r->buckets[i] = (i < perfstats::num_buckets) ? s->buckets[i] : 0;
+	}
+}
+
+/*
+ * a (JSON escaped) string
+ */
+static void jsonString( FILE *f, const char *s ) {
+	fputc( '"', f );
+	for( const char *p = s; *p; p++ ) {
+		if (*p == '"' || *p == '\\')
+			fprintf(f, "\\%c", *p);
+		else if ((unsigned char) *p < ' ')
+			fprintf(f, "\\u%04x", *p);
+		else
+			fputc( *p, f );
+	}
+	fputc( '"', f );
+}
+
+/*
+ * the date/time at the start of each JSON object
+ */
+static void jsonStamp( FILE *f, const struct tm *tm, long long end_us ) {
+	fprintf(f, "{\"date\":\"%02d/%02d/%04d\",\"time\":\"%02d:%02d:%02d.%03lld\"",
+		tm->tm_mon+1, tm->tm_mday, tm->tm_year+1900,
+		tm->tm_hour, tm->tm_min, tm->tm_sec, (end_us / 1000) % 1000 );
+}
+
+/*
+ * one JSON object per report
+ */
+static void jsonReport( FILE *f, const struct tm *tm, const struct reportRecord *r ) {
+	jsonStamp( f, tm, r->end_us );
+	fprintf(f, ",\"start_us\":%lld,\"end_us\":%lld",
+		(long long) r->start_us, (long long) r->end_us );
+
+	// the tag is the only string that comes from outside
+	fprintf(f, ",\"tag\":");
+	jsonString( f, r->tag );
+
+	fprintf(f, ",\"threads\":%u", r->threads );
+	if (r->compress > 0)
+		fprintf(f, ",\"compress\":%.2f", r->compress );
+	fprintf(f, ",\"bytes\":%lld,\"seconds\":%.6f,\"rate\":%lld",
+		(long long) r->bytes, (r->end_us - r->start_us) / 1000000.0,
+		(long long) r->rate );
+	fprintf(f, ",\"files\":%lld,\"reads\":%lld,\"writes\":%lld",
+		(long long) r->files, (long long) r->reads, (long long) r->writes );
+	fprintf(f, ",\"min_us\":%lld,\"max_us\":%lld",
+		(long long) r->min_us, (long long) r->max_us );
+	fprintf(f, ",\"p50_us\":%lld,\"p90_us\":%lld,\"p99_us\":%lld,\"p999_us\":%lld",
+		(long long) r->p50_us, (long long) r->p90_us,
+		(long long) r->p99_us, (long long) r->p999_us );
+
+	fprintf(f, ",\"bucket_limits_us\":[");
+	for( unsigned i = 0; i < r->num_buckets; i++ )
+		fprintf(f, i == 0 ? "%lld" : ",%lld", (long long) r->limits[i] );
+	fprintf(f, "],\"us_buckets\":[");
+	for( unsigned i = 0; i < r->num_buckets; i++ )
+		fprintf(f, i == 0 ? "%lld" : ",%lld", (long long) r->buckets[i] );
+	fprintf(f, "]}\n");
+}
+
+/*
+ * one CSV row per report (after a header row)
+ */
+static void csvReport( FILE *f, const struct tm *tm, const struct reportRecord *r ) {
+	if (!csvHeader) {
+		fprintf(f, "date,time,start_us,end_us,tag,threads,compress,bytes,seconds,rate,"
+			   "files,reads,writes,min_us,max_us,p50_us,p90_us,p99_us,p999_us" );
+		for( unsigned i = 0; i < r->num_buckets; i++ ) {
+			if (r->limits[i] > 0)
+				fprintf(f, ",le_%lldus", (long long) r->limits[i] );
+			else
+				fprintf(f, ",gt_%lldus", i > 0 ? (long long) r->limits[i-1] : 0LL );
+		}
+		fprintf(f, "\n");
+		csvHeader = true;
+	}
+
+	fprintf(f, "%02d/%02d/%04d,%02d:%02d:%02d.%03lld,%lld,%lld,",
+		tm->tm_mon+1, tm->tm_mday, tm->tm_year+1900,
+		tm->tm_hour, tm->tm_min, tm->tm_sec, (long long) (r->end_us / 1000) % 1000,
+		(long long) r->start_us, (long long) r->end_us );
+
+	// quote the tag if it would confuse a CSV reader
+	if (strpbrk( r->tag, ",\"\n" )) {
+		fputc( '"', f );
+		for( const char *p = r->tag; *p; p++ ) {
+			if (*p == '"')
+				fputc( '"', f );
+			fputc( *p, f );
+		}
+		fputc( '"', f );
+	} else
+		fprintf(f, "%s", r->tag );
+
+	fprintf(f, ",%u,%.2f,%lld,%.6f,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld",
+		r->threads, r->compress, (long long) r->bytes,
+		(r->end_us - r->start_us) / 1000000.0, (long long) r->rate,
+		(long long) r->files, (long long) r->reads, (long long) r->writes,
+		(long long) r->min_us, (long long) r->max_us,
+		(long long) r->p50_us, (long long) r->p90_us,
+		(long long) r->p99_us, (long long) r->p999_us );
+	for( unsigned i = 0; i < r->num_buckets; i++ )
+		fprintf(f, ",%lld", (long long) r->buckets[i] );
+	fprintf(f, "\n");
+}
+
+/**
+ * generate an activity/bandwidth report
+ */
+void
+report( int threads, long microseconds, perfstats *s ) {
+
+	// note the time of this report (which its details share)
+	struct timespec now;
+	clock_gettime( CLOCK_REALTIME, &now );
+	struct tm *tm = localtime( &now.tv_sec );
+	reportTime = now;
+	reportTm = *tm;
+
+	// stdout (the master) gets text reports, unless it has been
+	//	asked for another format (and there is no report file)
+	if (reportFile || reportFormat == REPORT_TEXT) {
+		textReport( stdout, tm, &now, threads, microseconds, s );
+		fflush( stdout );
+	}
+
+	// and reports in other formats (or files) are in addition
+	FILE *f = reportFile ? reportFile : stdout;
+	if (reportFile && reportFormat == REPORT_TEXT) {
+		textReport( f, tm, &now, threads, microseconds, s );
+	} else if (reportFormat != REPORT_TEXT) {
+		struct reportRecord r;
+		fillRecord( &r, &now, threads, microseconds, s );
+		switch( reportFormat ) {
+		    case REPORT_JSON:
+			jsonReport( f, tm, &r );
+			break;
+		    case REPORT_CSV:
+			csvReport( f, tm, &r );
+			break;
+		    case REPORT_BINARY:
+			fwrite( &r, sizeof r, 1, f );
+			break;
+		}
+	}
+	fflush( f );
+}
+
+/*
+ * a line that accompanies the most recent report (e.g. a DETAIL line)
+ *	goes wherever the reports go: as a text line wherever the text
+ *	reports go, and as a JSON object if the reports are JSON (there
+ *	is no room for them in CSV or binary reports)
+ */
+struct reportLine {
+	FILE *text[2];		// where its text goes (if anywhere)
+	FILE *json;		// where its JSON goes (if anywhere)
+};
+
+/*
+ * start a line that accompanies the most recent report
+ *	(with the date, time and tag of that report)
+ *
+ * @param	(returned) where the line goes
+ * @param	kind of line (e.g. DETAIL)
+ */
+static void lineBegin( struct reportLine *l, const char *kind ) {
+	l->text[0] = (reportFile || reportFormat == REPORT_TEXT) ? stdout : 0;
+	l->text[1] = (reportFile && reportFormat == REPORT_TEXT) ? reportFile : 0;
+	l->json = (reportFormat == REPORT_JSON) ? (reportFile ? reportFile : stdout) : 0;
+
+	for( int i = 0; i < 2; i++ )
+		if (l->text[i])
+			textStamp( l->text[i], kind, &reportTm, &reportTime );
+	if (l->json) {
+		jsonStamp( l->json, &reportTm, reportTime.tv_sec * 1000000LL + reportTime.tv_nsec / 1000 );
+		fprintf(l->json, ",\"tag\":");
+		jsonString( l->json, loadgen_tag ? loadgen_tag : "" );
+	}
+}
+
+/*
+ * add to the text of the line
+ */
+static void lineText( struct reportLine *l, const char *fmt, ... )
+	__attribute__((format(printf, 2, 3)));
+static void lineText( struct reportLine *l, const char *fmt, ... ) {
+	for( int i = 0; i < 2; i++ ) {
+		if (l->text[i] == 0)
+			continue;
+		va_list args;
+		va_start( args, fmt );
+		vfprintf( l->text[i], fmt, args );
+		va_end( args );
+	}
+}
+
+/*
+ * add to the JSON of the line
+ */
+static void lineJson( struct reportLine *l, const char *fmt, ... )
+	__attribute__((format(printf, 2, 3)));
+static void lineJson( struct reportLine *l, const char *fmt, ... ) {
+	if (l->json == 0)
+		return;
+	va_list args;
+	va_start( args, fmt );
+	vfprintf( l->json, fmt, args );
+	va_end( args );
+}
+
+/*
+ * finish the line, and get it to its readers
+ */
+static void lineEnd( struct reportLine *l ) {
+	lineText( l, "\n" );
+	lineJson( l, "}\n" );
 	fflush( stdout );
+	if (reportFile)
+		fflush( reportFile );
+}
+
+/**
+ * generate a breakdown of the most recent report
+ */
+void
+detailReport( const char *target, int thread, int threads, long microseconds, perfstats *s ) {
+	struct reportLine l;
+	lineBegin( &l, "DETAIL" );
+	if (thread >= 0) {
+		lineText( &l, "thread=%d target=%s ", thread, target );
+		lineJson( &l, ",\"detail\":\"thread\",\"thread\":%d", thread );
+	} else {
+		lineText( &l, "target=%s threads=%d ", target, threads );
+		lineJson( &l, ",\"detail\":\"target\",\"threads\":%d", threads );
+	}
+	if (l.json) {
+		fprintf(l.json, ",\"target\":");
+		jsonString( l.json, target );
+	}
+
+	char rate[128];
+	lineText( &l, "%sfiles=%ld p50_us=%ld p90_us=%ld p99_us=%ld p999_us=%ld",
+		textRate( rate, sizeof rate, microseconds, s ),
+		s->total_files, s->percentile( 50 ), s->percentile( 90 ),
+		s->percentile( 99 ), s->percentile( 99.9 ));
+	lineJson( &l, ",\"bytes\":%lld,\"seconds\":%.6f,\"rate\":%lld",
+		s->total_bytes, microseconds / 1000000.0,
+		microseconds > 0 ? (s->total_bytes * 1000000) / microseconds : 0 );
+	lineJson( &l, ",\"files\":%ld,\"reads\":%ld,\"writes\":%ld",
+		s->total_files, s->reads, s->writes );
+	lineJson( &l, ",\"p50_us\":%ld,\"p90_us\":%ld,\"p99_us\":%ld,\"p999_us\":%ld",
+		s->percentile( 50 ), s->percentile( 90 ),
+		s->percentile( 99 ), s->percentile( 99.9 ));
+	lineEnd( &l );
+}
+
+/**
+ * summarize the fairness of the most recent report
+ */
+void
+fairnessReport( int threads, long long min_rate, long long max_rate, double jain ) {
+	struct reportLine l;
+	lineBegin( &l, "DETAIL" );
+	lineText( &l, "fairness threads=%d min_rate=%lld max_rate=%lld jain=%.4f",
+		threads, min_rate, max_rate, jain );
+	lineJson( &l, ",\"detail\":\"fairness\",\"threads\":%d,\"min_rate\":%lld,\"max_rate\":%lld,\"jain\":%.4f",
+		threads, min_rate, max_rate, jain );
+	lineEnd( &l );
+}
+
+/**
+ * report the flushes (and their latencies) of the most recent report
+ */
+void
+flushReport( const char *policy, long microseconds, perfstats *s ) {
+	struct reportLine l;
+	lineBegin( &l, "DETAIL" );
+	lineText( &l, "flush policy=%s flushes=%ld flush_us=%llu max_us=%llu "
+		"p50_us=%ld p90_us=%ld p99_us=%ld p999_us=%ld us_buckets=",
+		policy, s->flushes, s->flush_usecs, s->flush_max,
+		s->flush_percentile( 50 ), s->flush_percentile( 90 ),
+		s->flush_percentile( 99 ), s->flush_percentile( 99.9 ));
+	lineJson( &l, ",\"detail\":\"flush\",\"policy\":" );
+	if (l.json)
+		jsonString( l.json, policy );
+	lineJson( &l, ",\"seconds\":%.6f,\"flushes\":%ld,\"flush_us\":%llu,\"max_us\":%llu",
+		microseconds / 1000000.0, s->flushes, s->flush_usecs, s->flush_max );
+	lineJson( &l, ",\"p50_us\":%ld,\"p90_us\":%ld,\"p99_us\":%ld,\"p999_us\":%ld",
+		s->flush_percentile( 50 ), s->flush_percentile( 90 ),
+		s->flush_percentile( 99 ), s->flush_percentile( 99.9 ));
+	lineJson( &l, ",\"us_buckets\":[" );
+	for( int b = 0; b < perfstats::num_buckets; b++ ) {
+		lineText( &l, b == 0 ? "%ld" : ",%ld", s->flush_buckets[b] );
+		lineJson( &l, b == 0 ? "%ld" : ",%ld", s->flush_buckets[b] );
+	}
+	lineJson( &l, "]" );
+	lineEnd( &l );
+}
+
+/**
+ * report the commits (and the groups they were committed in) of a
+ *	WAL workload in the most recent report
+ */
+void
+walReport( long microseconds, perfstats *commits, perfstats *groups ) {
+	long long perSec = microseconds > 0 ? (commits->writes * 1000000LL) / microseconds : 0;
+	double perGroup = groups->writes > 0 ? (double) commits->writes / groups->writes : 0;
+	long long groupBytes = groups->writes > 0 ? groups->total_bytes / groups->writes : 0;
+
+	struct reportLine l;
+	lineBegin( &l, "DETAIL" );
+	lineText( &l, "wal commits=%ld commits_per_sec=%lld "
+		"p50_us=%ld p90_us=%ld p99_us=%ld p999_us=%ld "
+		"groups=%ld records_per_group=%.1f bytes_per_group=%lld "
+		"sync_p50_us=%ld sync_p99_us=%ld sync_max_us=%llu",
+		commits->writes, perSec,
+		commits->percentile( 50 ), commits->percentile( 90 ),
+		commits->percentile( 99 ), commits->percentile( 99.9 ),
+		groups->writes, perGroup, groupBytes,
+		groups->flush_percentile( 50 ), groups->flush_percentile( 99 ),
+		groups->flush_max );
+	lineJson( &l, ",\"detail\":\"wal\",\"seconds\":%.6f,\"commits\":%ld,\"commits_per_sec\":%lld",
+		microseconds / 1000000.0, commits->writes, perSec );
+	lineJson( &l, ",\"p50_us\":%ld,\"p90_us\":%ld,\"p99_us\":%ld,\"p999_us\":%ld",
+		commits->percentile( 50 ), commits->percentile( 90 ),
+		commits->percentile( 99 ), commits->percentile( 99.9 ));
+	lineJson( &l, ",\"groups\":%ld,\"records_per_group\":%.1f,\"bytes_per_group\":%lld",
+		groups->writes, perGroup, groupBytes );
+	lineJson( &l, ",\"sync_p50_us\":%ld,\"sync_p99_us\":%ld,\"sync_max_us\":%llu",
+		groups->flush_percentile( 50 ), groups->flush_percentile( 99 ),
+		groups->flush_max );
+	lineEnd( &l );
+}
+
+/**
+ * report a saturation search trial (or the chosen operating point)
+ */
+void
+tuneReport( const char *kind, int threads, long long rate, long p50,
+		double pct, long pslo, long slo, const char *result ) {
+	// percentiles are named the way the reports name them (e.g. p999)
+	char name[32];
+	snprintf( name, sizeof name, "p%g", pct );
+	char *d = strchr( name, '.' );
+	if (d)
+		memmove( d, d + 1, strlen( d ));
+
+	struct reportLine l;
+	lineBegin( &l, "TUNE" );
+	lineText( &l, "%s threads=%d rate=%lld p50_us=%ld %s_us=%ld slo_us=%ld result=%s",
+		kind, threads, rate, p50, name, pslo, slo, result );
+	lineJson( &l, ",\"tune\":\"%s\",\"threads\":%d,\"rate\":%lld,\"p50_us\":%ld,\"%s_us\":%ld,\"slo_us\":%ld,\"result\":\"%s\"",
+		kind, threads, rate, p50, name, pslo, slo, result );
+	lineEnd( &l );
+}
+
+/**
+ * report the results of a parameter sweep cell
+ */
+void
+sweepReport( int bsize, int depth, int threads, int mix,
+		long long microseconds, long long rate, long long iops, perfstats *s ) {
+	struct reportLine l;
+	lineBegin( &l, "SWEEP" );
+	lineText( &l, "bsize=%d depth=%d threads=%d mix=%d seconds=%.3f bytes=%lld rate=%lld iops=%lld ",
+		bsize, depth, threads, mix, microseconds / 1000000.0, s->total_bytes, rate, iops );
+	lineText( &l, "reads=%ld writes=%ld p50_us=%ld p90_us=%ld p99_us=%ld p999_us=%ld",
+		s->reads, s->writes, s->percentile( 50 ), s->percentile( 90 ),
+		s->percentile( 99 ), s->percentile( 99.9 ));
+	lineJson( &l, ",\"sweep\":\"cell\",\"bsize\":%d,\"depth\":%d,\"threads\":%d,\"mix\":%d",
+		bsize, depth, threads, mix );
+	lineJson( &l, ",\"seconds\":%.6f,\"bytes\":%lld,\"rate\":%lld,\"iops\":%lld,\"reads\":%ld,\"writes\":%ld",
+		microseconds / 1000000.0, s->total_bytes, rate, iops, s->reads, s->writes );
+	lineJson( &l, ",\"p50_us\":%ld,\"p90_us\":%ld,\"p99_us\":%ld,\"p999_us\":%ld",
+		s->percentile( 50 ), s->percentile( 90 ),
+		s->percentile( 99 ), s->percentile( 99.9 ));
+	lineEnd( &l );
 }
@@ -0,0 +1,168 @@
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * machine readable throughput reports
+ *
+ *	Each reporting interval normally produces a single text line
+ *	(REPORT key=value ...) on stdout, for the master.  Reports can
+ *	also be produced as JSON lines, CSV (with a header line), or
+ *	fixed size binary records, and written to a file (in which case
+ *	the master still gets its text reports on stdout).  A submaster
+ *	(--children=) asks its children for "precise" text reports, which
+ *	give the length of each interval to the microsecond and add the
+ *	fastest and slowest operations, so that it can merge them.
+ *
+ *	The binary records are described below, so that tools can
+ *	read them without parsing anything.  All fields are in the
+ *	byte order of the machine that wrote them.
+ *
+ *	Each report can optionally be followed by a breakdown (DETAIL
+ *	lines, or JSON objects with a "detail" field) for each target
+ *	and/or thread, and a summary of how fairly the throughput was
+ *	divided among the threads, so that one slow target or starved
+ *	thread is not averaged away.  (CSV and binary reports do not
+ *	include breakdowns.)
+ *
+ *	A saturation search (--slo=) reports each of its trials, and
+ *	the operating point it chose, the same way (as TUNE lines), as
+ *	does a parameter sweep (--sweep=) for each of its cells (SWEEP).
+ */
+#define	REPORT_TEXT	0
+#define	REPORT_JSON	1
+#define	REPORT_CSV	2
+#define	REPORT_BINARY	3
+
+// optional breakdowns of each report
+#define	BREAKDOWN_TARGETS	0x01	///< a DETAIL line for each target
+#define	BREAKDOWN_THREADS	0x02	///< a DETAIL line for each thread
+
+#define	REPORT_MAGIC	0x5052474cU	///< "LGRP" (in little-endian order)
+#define	REPORT_VERSION	1
+#define	REPORT_BUCKETS	24		///< (must be MAX_LATENCY_BUCKETS)
+#define	REPORT_TAGLEN	64
+
+struct reportRecord {
+	uint32_t magic;			///< REPORT_MAGIC
+	uint16_t version;		///< REPORT_VERSION
+	uint16_t size;			///< size of this record
+	int64_t	start_us;		///< interval start (us since the epoch)
+	int64_t	end_us;			///< interval end (us since the epoch)
+	uint32_t threads;		///< threads running at end of interval
+	uint32_t num_buckets;		///< latency buckets in use
+	int64_t	bytes;			///< bytes transferred in the interval
+	int64_t	rate;			///< bytes per second
+	int64_t	files;			///< files completed in the interval
+	int64_t	reads;			///< read operations in the interval
+	int64_t	writes;			///< write operations in the interval
+	int64_t	min_us;			///< fastest operation (whole run)
+	int64_t	max_us;			///< slowest operation (whole run)
+	int64_t	p50_us;			///< latency percentiles (bucket limits)
+	int64_t	p90_us;
+	int64_t	p99_us;
+	int64_t	p999_us;
+	double	compress;		///< requested compression ratio (or 0)
+	char	tag[REPORT_TAGLEN];	///< instance tag (null terminated)
+	int64_t	limits[REPORT_BUCKETS];	///< bucket upper limits (-1: none)
+	int64_t	buckets[REPORT_BUCKETS];	///< operations in each bucket
+};
+
+/**
+ * set up the report format and (optional) report file
+ *
+ * @param	format (text, json, csv or binary)
+ * @param	file to which reports should (also) be written (or NULL)
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *setReports( const char *format, const char *file );
+
+/**
+ * pull a field out of a text report line
+ *	(for those that read them: a submaster, and loadgen-merge)
+ *
+ * @param	the report line
+ * @param	name of the field
+ * @return	pointer to its value (or NULL if it is not there)
+ */
+inline const char *reportField( const char *line, const char *name ) {
+	size_t len = strlen( name );
+	for( const char *s = strstr( line, name ); s; s = strstr( s + 1, name ) )
+		if ((s == line || s[-1] == ' ') && s[len] == '=')
+			return s + len + 1;
+	return 0;
+}
+
+class perfstats;
+
+/**
+ * generate a breakdown (DETAIL) of the most recent report
+ *	(in text or JSON, wherever the reports are going)
+ *
+ * @param	target (directory, file or device)
+ * @param	index of the thread (or -1 for the whole target)
+ * @param	number of threads running on the target
+ * @param	length of the interval (us)
+ * @param	statistics for the interval
+ */
+void detailReport( const char *target, int thread, int threads, long microseconds, perfstats *s );
+
+/**
+ * summarize the fairness of the most recent report
+ *
+ * @param	number of threads running
+ * @param	lowest per-thread rate (bytes/second)
+ * @param	highest per-thread rate (bytes/second)
+ * @param	Jain's fairness index of the per-thread rates
+ */
+void fairnessReport( int threads, long long min_rate, long long max_rate, double jain );
+
+/**
+ * report the flushes (and their latencies) of the most recent report
+ *
+ * @param	the flush policy
+ * @param	length of the interval (in microseconds)
+ * @param	statistics for the interval
+ */
+void flushReport( const char *policy, long microseconds, perfstats *s );
+
+/**
+ * report the commits (and the groups they were committed in) of a
+ *	WAL workload in the most recent report
+ *
+ * @param	length of the interval (in microseconds)
+ * @param	statistics of the commits (from the producers)
+ * @param	statistics of the groups (from the committers)
+ */
+void walReport( long microseconds, perfstats *commits, perfstats *groups );
+
+/**
+ * report a saturation search trial (or the chosen operating point)
+ *	(in text or JSON, wherever the reports are going)
+ *
+ * @param	"trial" or "chosen"
+ * @param	number of threads
+ * @param	throughput (bytes/second)
+ * @param	median latency (us)
+ * @param	SLO percentile
+ * @param	latency at that percentile (us)
+ * @param	SLO latency (us)
+ * @param	outcome of the trial
+ */
+void tuneReport( const char *kind, int threads, long long rate, long p50,
+		double pct, long pslo, long slo, const char *result );
+
+/**
+ * report the results of a parameter sweep cell
+ *	(in text or JSON, wherever the reports are going)
+ *
+ * @param	block size
+ * @param	queue depth
+ * @param	number of threads
+ * @param	percentage of operations that were reads
+ * @param	length of the measurement window (us)
+ * @param	throughput (bytes/second)
+ * @param	operations per second
+ * @param	statistics for the measurement window
+ */
+void sweepReport( int bsize, int depth, int threads, int mix,
+		long long microseconds, long long rate, long long iops, perfstats *s );
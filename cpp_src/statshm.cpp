@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "loadgen.h"
+#include "threadstatus.h"
+#include "statshm.h"
+
+// the segment carries all of the latency buckets we could be using
+static_assert( STATS_BUCKETS == MAX_LATENCY_BUCKETS, "stats bucket count" );
+static_assert( std::atomic<uint64_t>::is_always_lock_free, "lock-free sequence" );
+
+static struct statsSegment *seg = 0;	// our mapping of the segment
+static size_t segSize = 0;		// how much of it we have mapped
+static int segFd = -1;			// the open segment
+static char *segName = 0;		// its name (for removal)
+static bool segFile = false;		// it is a file (not a shm object)
+
+/*
+ * (re)size and (re)map the segment
+ *
+ * @return	true if successful
+ */
+static bool mapSegment( size_t size ) {
+	if (ftruncate( segFd, size ) != 0)
+		return false;
+
+	void *p = mmap( 0, size, PROT_READ|PROT_WRITE, MAP_SHARED, segFd, 0 );
+	if (p == MAP_FAILED)
+		return false;
+
+	if (seg)
+		munmap( seg, segSize );
+	seg = (struct statsSegment *) p;
+	segSize = size;
+	return true;
+}
+
+/*
+ * create the statistics segment
+ */
+const char *statsCreate( const char *name ) {
+	// names containing a slash are files, others are shm objects
+	segFile = strchr( name, '/' ) != 0;
+	if (segFile) {
+		segName = strdup( name );
+	} else {
+		segName = (char *) malloc( strlen( name ) + 2 );
+		if (segName)
+			sprintf( segName, "/%s", name );
+	}
+	if (segName == 0)
+		return "malloc failure";
+
+	// monitors still attached to an old segment should keep it
+	//	(rather than having it truncated out from under them)
+	if (segFile)
+		unlink( segName );
+	else
+		shm_unlink( segName );
+
+	int flags = O_RDWR|O_CREAT|O_EXCL|O_CLOEXEC;
+	segFd = segFile ? open( segName, flags, 0644 ) : shm_open( segName, flags, 0644 );
+	if (segFd < 0)
+		return "Unable to create statistics segment";
+	if (!mapSegment( sizeof (struct statsSegment) ))
+		return "Unable to map statistics segment";
+
+	// fill in the parts of the header that never change
+	seg->magic = STATS_MAGIC;
+	seg->version = STATS_VERSION;
+	seg->hdr_size = sizeof (struct statsSegment);
+	seg->thread_size = sizeof (struct statsThread);
+	seg->pid = getpid();
+	if (loadgen_tag)
+		strncpy( seg->tag, loadgen_tag, sizeof seg->tag - 1 );
+	seg->num_buckets = perfstats::num_buckets;
+	seg->update_ms = loadgen_update;
+	for( int i = 0; i < STATS_BUCKETS; i++ )
+		seg->limits[i] = (i < perfstats::num_buckets) ? perfstats::limits[i] : -1;
+	seg->seq.store( 0 );
+	seg->state = STATS_STARTING;
+
+	return 0;
+}
+
+/*
+ * the writer's half of the sequence lock
+ */
+static void beginUpdate() {
+	uint64_t s = seg->seq.load( std::memory_order_relaxed );
+	seg->seq.store( s + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+}
+
+static void endUpdate() {
+	uint64_t s = seg->seq.load( std::memory_order_relaxed );
+	seg->seq.store( s + 1, std::memory_order_release );
+}
+
+/*
+ * make room for (and name) the threads we will be managing
+ */
+void statsThreads( ThreadStatus **all, int defined ) {
+	if (seg == 0)
+		return;
+
+	// readers that see the new thread count will re-map it
+	beginUpdate();
+	size_t size = sizeof (struct statsSegment) + defined * sizeof (struct statsThread);
+	if (!mapSegment( size )) {
+		fprintf(stderr, "WARNING: unable to grow statistics segment for %d threads\n", defined);
+		endUpdate();
+		return;
+	}
+
+	// (the threads we already had keep their slots)
+	for( int i = seg->num_threads; i < defined; i++ ) {
+		struct statsThread *t = statsSlot( seg, i );
+		strncpy( t->name, all[i]->name, sizeof t->name - 1 );
+		t->state = STATS_STARTING;
+	}
+	seg->num_threads = defined;
+	seg->state = STATS_RUNNING;
+	endUpdate();
+}
+
+/*
+ * copy a set of perfstats into the segment
+ */
+static void counters( struct statsCounters *c, const perfstats *s ) {
+	c->files = s->total_files;
+	c->bytes = s->total_bytes;
+	c->reads = s->reads;
+	c->writes = s->writes;
+	c->usecs = s->total_usecs;
+	c->min_us = s->min_time;
+	c->max_us = s->max_time;
+	for( int i = 0; i < STATS_BUCKETS; i++ )
+		c->buckets[i] = s->buckets[i];
+}
+
+/*
+ * publish the statistics at the end of a reporting interval
+ */
+void statsPublish( ThreadStatus **all, int started, long microseconds,
+		const perfstats *sum, const perfstats *delta ) {
+	if (seg == 0)
+		return;
+
+	struct timespec now;
+	clock_gettime( CLOCK_REALTIME, &now );
+
+	beginUpdate();
+	seg->updates++;
+	seg->update_us = now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+	seg->start_us = seg->update_us - microseconds;
+	seg->started = started;
+	seg->running = 0;
+	seg->parked = 0;
+	seg->exited = 0;
+	for( int i = 0; i < started && i < (int) seg->num_threads; i++ ) {
+		struct statsThread *t = statsSlot( seg, i );
+		if (!all[i]->running) {
+			t->state = STATS_EXITED;
+			seg->exited++;
+		} else if (all[i]->parked) {
+			t->state = STATS_PARKED;
+			seg->parked++;
+		} else {
+			t->state = STATS_RUNNING;
+			seg->running++;
+		}
+		counters( &t->totals, &all[i]->stats );
+	}
+	counters( &seg->totals, sum );
+	counters( &seg->interval, delta );
+	endUpdate();
+}
+
+/*
+ * note that we are done, and remove the segment
+ */
+void statsClose() {
+	if (seg == 0)
+		return;
+
+	beginUpdate();
+	seg->state = STATS_DONE;
+	endUpdate();
+
+	munmap( seg, segSize );
+	seg = 0;
+	close( segFd );
+	segFd = -1;
+	if (segFile)
+		unlink( segName );
+	else
+		shm_unlink( segName );
+	free( segName );
+	segName = 0;
+}
@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * live statistics, published in shared memory for local monitors
+ *
+ *	Reading our stdout is a privilege of the master.  A monitor on
+ *	the same machine can instead map a (named) statistics segment,
+ *	which the thread manager updates at the end of every reporting
+ *	interval with the aggregate and per-thread counters.  Sampling
+ *	it requires no system calls, and does not disturb the master.
+ *
+ *	The segment is a fixed header (the fields above seq never
+ *	change once the segment has been created) followed by one
+ *	statsThread slot for each defined thread.  Updates are
+ *	protected by a sequence lock: the writer makes seq odd before
+ *	it changes anything and even again when it is done, so a
+ *	reader can take a consistent snapshot by copying the segment
+ *	and then confirming that seq was (the same) even value before
+ *	and after the copy.  The writer never waits for the readers.
+ *
+ *	The segment only grows (as threads are defined), so a reader
+ *	that sees more thread slots than it has mapped should re-map
+ *	it.  All fields are in the byte order of the
+ *	machine that wrote them.
+ */
+#define	STATS_MAGIC	0x5453474cU	///< "LGST" (in little-endian order)
+#define	STATS_VERSION	1
+#define	STATS_BUCKETS	24		///< (must be MAX_LATENCY_BUCKETS)
+#define	STATS_NAMELEN	64
+
+// states of the generator (and of each thread)
+#define	STATS_STARTING	0		///< threads not yet defined/started
+#define	STATS_RUNNING	1		///< generating load
+#define	STATS_PARKED	2		///< (thread) waiting to be resumed
+#define	STATS_EXITED	3		///< (thread) finished
+#define	STATS_DONE	4		///< (generator) shut down
+
+struct statsCounters {
+	int64_t	files;			///< files completed
+	int64_t	bytes;			///< bytes transferred
+	int64_t	reads;			///< read operations
+	int64_t	writes;			///< write operations
+	int64_t	usecs;			///< time spent doing I/O
+	int64_t	min_us;			///< fastest operation (0: none yet)
+	int64_t	max_us;			///< slowest operation
+	int64_t	buckets[STATS_BUCKETS];	///< operations in each latency bucket
+};
+
+struct statsThread {
+	char	name[STATS_NAMELEN];	///< display name (null terminated)
+	uint32_t state;			///< STATS_STARTING ... STATS_EXITED
+	uint32_t pad;
+	struct statsCounters totals;	///< since the thread was started
+};
+
+struct statsSegment {
+	uint32_t magic;			///< STATS_MAGIC
+	uint16_t version;		///< STATS_VERSION
+	uint16_t hdr_size;		///< offset of the first thread slot
+	uint32_t thread_size;		///< size of each thread slot
+	int32_t	pid;			///< process publishing these statistics
+	char	tag[STATS_NAMELEN];	///< instance tag (null terminated)
+	uint32_t num_buckets;		///< latency buckets in use
+	uint32_t update_ms;		///< reporting interval
+	int64_t	limits[STATS_BUCKETS];	///< bucket upper limits (-1: none)
+
+	std::atomic<uint64_t> seq;	///< sequence lock (odd: being updated)
+
+	uint32_t state;			///< STATS_STARTING, _RUNNING or _DONE
+	uint32_t num_threads;		///< thread slots that follow
+	uint64_t updates;		///< number of updates published
+	int64_t	start_us;		///< when the current interval started
+	int64_t	update_us;		///< when it ended (us since the epoch)
+	uint32_t started;		///< threads that have been started
+	uint32_t running;		///< threads running (not parked)
+	uint32_t parked;		///< threads parked
+	uint32_t exited;		///< threads that have finished
+	struct statsCounters totals;	///< all threads, since we started
+	struct statsCounters interval;	///< all threads, most recent interval
+};
+
+/**
+ * the thread slots follow the header
+ *
+ * @param	segment
+ * @param	index of the desired thread
+ * @return	address of its slot
+ */
+inline struct statsThread *statsSlot( struct statsSegment *seg, unsigned i ) {
+	return (struct statsThread *) ((char *) seg + seg->hdr_size + i * seg->thread_size);
+}
+
+class ThreadStatus;
+class perfstats;
+
+/**
+ * create the statistics segment
+ *
+ * @param	name (of a POSIX shared memory object), or a file path
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *statsCreate( const char *name );
+
+/**
+ * make room for (and name) the threads we will be managing
+ *	(again whenever more of them are defined)
+ *
+ * @param	descriptors for all of the threads
+ * @param	number of threads
+ */
+void statsThreads( ThreadStatus **all, int defined );
+
+/**
+ * publish the statistics at the end of a reporting interval
+ *
+ * @param	descriptors for the threads that have been started
+ * @param	number of threads that have been started
+ * @param	length of the interval (us)
+ * @param	totals for all threads (since we started)
+ * @param	totals for all threads (in this interval)
+ */
+void statsPublish( ThreadStatus **all, int started, long microseconds,
+		const perfstats *sum, const perfstats *delta );
+
+/**
+ * note that we are done, and remove the segment
+ *	(monitors that have it mapped can still read the final values)
+ */
+void statsClose();
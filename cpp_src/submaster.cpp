@@ -0,0 +1,584 @@
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "loadgen.h"
+#include "perfstats.h"
+#include "report.h"
+#include "submaster.h"
+#include "debug.h"
+
+// longest line we expect from a child
+#define	CHILD_LINE	1024
+
+// most intervals we will hold, waiting for slow children to report
+#define	MAX_GROUPS	16
+
+// the states of a child
+#define	CHILD_STARTING	0	///< has not yet accepted its arguments
+#define	CHILD_RUNNING	1	///< generating load
+#define	CHILD_DONE	2	///< said goodbye
+#define	CHILD_FAILED	3	///< died (or never started)
+
+struct child {
+	const char *where;	///< HOST:PORT (or NULL for a local child)
+	pid_t	pid;		///< (local) process
+	int	in;		///< where our commands go
+	int	out;		///< where its reports come from
+	int	state;		///< CHILD_STARTING ... CHILD_FAILED
+	int	threads;	///< threads we have asked it for
+	long	lastSeq;	///< the last report it has made
+	int	buffered;	///< bytes in buf
+	char	buf[CHILD_LINE];	///< output not yet processed
+};
+
+/*
+ * the merged reports for one interval
+ */
+struct group {
+	long	seq;		///< which (of each child's) reports it is
+	int	threads;	///< total running threads
+	long	usecs;		///< (longest) length of the interval
+	perfstats stats;	///< total bytes and latency buckets
+};
+
+static struct child children[MAX_CHILDREN];
+static int numChildren = 0;
+static char *childSpec = 0;	// (which the where fields point into)
+
+static struct group groups[MAX_GROUPS];	// a ring, oldest first
+static int firstGroup = 0;
+static int numGroups = 0;
+static long nextSeq = 0;
+
+/*
+ * parse a description of our children
+ */
+const char *setChildren( const char *spec ) {
+	char *end;
+	long n = strtol( spec, &end, 10 );
+	if (*end == 0) {
+		if (n < 1 || n > MAX_CHILDREN)
+			return "Invalid number of children";
+		numChildren = (int) n;
+		return 0;
+	}
+
+	childSpec = strdup( spec );
+	char *save = 0;
+	for( char *s = strtok_r( childSpec, ",", &save ); s; s = strtok_r( 0, ",", &save )) {
+		if (numChildren >= MAX_CHILDREN)
+			return "Too many children";
+		if (strrchr( s, ':' ) == 0)
+			return "Children must be a number or HOST:PORT list";
+		children[numChildren++].where = s;
+	}
+	return numChildren > 0 ? 0 : "Children must be a number or HOST:PORT list";
+}
+
+/*
+ * start a local child, with pipes for its standard input and output
+ */
+static bool spawn( struct child *c ) {
+	int in[2], out[2];
+	if (pipe2( in, O_CLOEXEC ) != 0)
+		return false;
+	if (pipe2( out, O_CLOEXEC ) != 0) {
+		close( in[0] );
+		close( in[1] );
+		return false;
+	}
+
+	c->pid = fork();
+	if (c->pid == 0) {
+		dup2( in[0], 0 );
+		dup2( out[1], 1 );
+		execl( "/proc/self/exe", "loadgen", (char *) 0 );
+		_exit( 127 );
+	}
+	close( in[0] );
+	close( out[1] );
+	if (c->pid < 0) {
+		close( in[1] );
+		close( out[0] );
+		return false;
+	}
+	c->in = in[1];
+	c->out = out[0];
+	return true;
+}
+
+/*
+ * connect to a listening child
+ */
+static bool connectTo( struct child *c ) {
+	char *host = strdup( c->where );
+	char *colon = strrchr( host, ':' );
+	*colon = 0;
+	char *name = host;
+	if (name[0] == '[' && colon[-1] == ']') {
+		colon[-1] = 0;
+		name++;
+	}
+
+	struct addrinfo hints, *list = 0;
+	memset( &hints, 0, sizeof hints );
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	int fd = -1;
+	if (getaddrinfo( name, colon + 1, &hints, &list ) == 0) {
+		for( struct addrinfo *a = list; a && fd < 0; a = a->ai_next ) {
+			fd = socket( a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol );
+			if (fd >= 0 && connect( fd, a->ai_addr, a->ai_addrlen ) != 0) {
+				close( fd );
+				fd = -1;
+			}
+		}
+		freeaddrinfo( list );
+	}
+	free( host );
+	c->in = c->out = fd;
+	return fd >= 0;
+}
+
+/*
+ * forget a child that has finished (or failed)
+ */
+static void lose( struct child *c, int state ) {
+	if (c->in >= 0 && c->in != c->out)
+		close( c->in );
+	if (c->out >= 0)
+		close( c->out );
+	c->in = c->out = -1;
+	c->state = state;
+	if (c->pid > 0) {
+		waitpid( c->pid, 0, 0 );
+		c->pid = 0;
+	}
+}
+
+/*
+ * send a command (or arguments) to a child
+ */
+static void tell( struct child *c, const char *line ) {
+	if (c->in < 0)
+		return;
+	std::string s( line );
+	s += '\n';
+	if (write( c->in, s.c_str(), s.size() ) != (ssize_t) s.size())
+		fprintf(stderr, "# child %d: unable to send %s\n", (int) (c - children), line );
+}
+
+/*
+ * send a command to every running child
+ */
+static void tellAll( const char *line ) {
+	if (loadgen_debug & D_CMDS)
+		fprintf(stderr, "# children <- %s\n", line );
+	for( int i = 0; i < numChildren; i++ )
+		if (children[i].state == CHILD_RUNNING)
+			tell( &children[i], line );
+}
+
+/*
+ * take the next complete line from a child's output
+ *	(a line that is too long for the buffer is truncated)
+ *
+ * @param	child
+ * @param	(returned) the line, without its newline
+ * @return	true if there was a line
+ */
+static bool childLine( struct child *c, char *line ) {
+	char *nl = (char *) memchr( c->buf, '\n', c->buffered );
+	if (nl == 0 && c->buffered < CHILD_LINE - 1)
+		return false;
+	int len = nl ? (int) (nl - c->buf) : c->buffered;
+	memcpy( line, c->buf, len );
+	line[len] = 0;
+	if (len > 0 && line[len-1] == '\r')
+		line[len-1] = 0;
+	int used = nl ? len + 1 : len;
+	c->buffered -= used;
+	memmove( c->buf, &c->buf[used], c->buffered );
+	return true;
+}
+
+/*
+ * read whatever a child has to say
+ *
+ * @return	false if it has nothing more to say
+ */
+static bool childRead( struct child *c ) {
+	int got = read( c->out, &c->buf[c->buffered], CHILD_LINE - 1 - c->buffered );
+	if (got > 0)
+		c->buffered += got;
+	return got > 0 || (got < 0 && errno == EINTR);
+}
+
+/*
+ * wait (no longer than the deadline) for a child to say something
+ *
+ * @return	false if it has nothing more to say
+ */
+static bool childWait( struct child *c, time_t deadline ) {
+	struct pollfd p;
+	p.fd = c->out;
+	p.events = POLLIN;
+	int ms = (int) (deadline - time( 0 )) * 1000;
+	if (ms <= 0 || poll( &p, 1, ms ) <= 0)
+		return false;
+	return childRead( c );
+}
+
+/*
+ * build the switches for a child
+ *	(whose reports, for us, carry exact interval lengths and its
+ *	fastest and slowest operations)
+ *
+ * @param	switches (as in main)
+ * @param	child number
+ * @return	the child's arguments line
+ */
+static std::string childArgs( int argc, const char **argv, int n ) {
+	static const char *ours[] = { "--children=", "--report-format=", "--report-file=",
+					"--threads=", "--tag=", 0 };
+	char num[16];
+	snprintf( num, sizeof num, "%d", n );
+
+	std::string args;
+	for( int i = 1; i < argc; i++ ) {
+		bool skip = false;
+		for( int j = 0; ours[j]; j++ )
+			if (strncmp( argv[i], ours[j], strlen( ours[j] )) == 0)
+				skip = true;
+		if (skip)
+			continue;
+
+		std::string a( argv[i] );
+		for( size_t p = a.find( "%n" ); p != std::string::npos; p = a.find( "%n", p ))
+			a.replace( p, 2, num );
+		args += a + " ";
+	}
+	args += "--report-format=precise ";
+	args += std::string( "--tag=" ) + (loadgen_tag ? loadgen_tag : "loadgen") + "." + num;
+	return args;
+}
+
+/*
+ * divide a number of threads among the running children
+ */
+static void setThreads( int threads, bool initial ) {
+	int running = 0;
+	for( int i = 0; i < numChildren; i++ )
+		if (children[i].state == CHILD_RUNNING || (initial && children[i].state == CHILD_STARTING))
+			running++;
+
+	char cmd[32];
+	for( int i = 0, r = 0; i < numChildren; i++ ) {
+		struct child *c = &children[i];
+		if (c->state != CHILD_RUNNING && !(initial && c->state == CHILD_STARTING))
+			continue;
+		int share = threads / running + (r++ < threads % running);
+		if (!initial && share != c->threads) {
+			snprintf( cmd, sizeof cmd, "threads=%d", share );
+			if (loadgen_debug & D_CMDS)
+				fprintf(stderr, "# child %d <- %s\n", i, cmd );
+			tell( c, cmd );
+		}
+		c->threads = share;
+	}
+}
+
+/*
+ * report (and forget) the oldest interval
+ */
+static void emit() {
+	struct group *g = &groups[firstGroup];
+	report( g->threads, g->usecs, &g->stats );
+	firstGroup = (firstGroup + 1) % MAX_GROUPS;
+	numGroups--;
+}
+
+/*
+ * report every interval that every running child has reported
+ *
+ * @param	report them all, whether they are complete or not
+ */
+static void emitComplete( bool all ) {
+	while( numGroups > 0 ) {
+		struct group *g = &groups[firstGroup];
+		bool complete = true;
+		for( int i = 0; i < numChildren; i++ )
+			if (children[i].state == CHILD_RUNNING && children[i].lastSeq < g->seq)
+				complete = false;
+		if (!complete && !all)
+			return;
+		emit();
+	}
+}
+
+/*
+ * add a child's report to those of its siblings (for the same interval)
+ *
+ *	the children report on the same schedule, so the Nth report of
+ *	each is for the same interval (which their time stamps, a few
+ *	milliseconds apart, may not agree on)
+ */
+static void merge( struct child *c, const char *line ) {
+	const char *threads = reportField( line, "threads" );
+	if (threads == 0)
+		return;
+
+	// its next report goes with its siblings' next reports
+	//	(or, if it has fallen behind, with the oldest we still have)
+	struct group *g = 0;
+	for( int i = 0; i < numGroups && g == 0; i++ ) {
+		struct group *p = &groups[(firstGroup + i) % MAX_GROUPS];
+		if (p->seq > c->lastSeq)
+			g = p;
+	}
+
+	// or start a new one (if need be, reporting the oldest incomplete)
+	if (g == 0) {
+		if (numGroups == MAX_GROUPS)
+			emit();
+		g = &groups[(firstGroup + numGroups++) % MAX_GROUPS];
+		g->seq = nextSeq++;
+		g->threads = 0;
+		g->usecs = 0;
+		g->stats.reset();
+	}
+	c->lastSeq = g->seq;
+
+	g->threads += atoi( threads );
+	const char *v;
+	if ((v = reportField( line, "bytes" )))
+		g->stats.total_bytes += atoll( v );
+	if ((v = reportField( line, "seconds" ))) {
+		long usecs = (long) (atof( v ) * 1000000 + 0.5);
+		if (usecs > g->usecs)
+			g->usecs = usecs;
+	}
+	if ((v = reportField( line, "min_us" ))) {
+		hires_time_t t = strtoull( v, 0, 10 );
+		if (t != 0 && (g->stats.min_time == 0 || t < g->stats.min_time))
+			g->stats.min_time = t;
+	}
+	if ((v = reportField( line, "max_us" ))) {
+		hires_time_t t = strtoull( v, 0, 10 );
+		if (t > g->stats.max_time)
+			g->stats.max_time = t;
+	}
+	if ((v = reportField( line, "us_buckets" )))
+		for( int i = 0; i < MAX_LATENCY_BUCKETS && *v; i++ ) {
+			char *end;
+			g->stats.buckets[i] += strtol( v, &end, 10 );
+			if (*end != ',')
+				break;
+			v = end + 1;
+		}
+}
+
+/*
+ * deal with a line of output from a running child
+ */
+static void heard( struct child *c, const char *line ) {
+	int n = (int) (c - children);
+	if (strncmp( line, "REPORT ", 7 ) == 0)
+		merge( c, line );
+	else if (strncmp( line, "DETAIL ", 7 ) == 0) {
+		fprintf(stdout, "%s\n", line );
+		fflush( stdout );
+	} else if (strncmp( line, "Yes Master.", 11 ) == 0)
+		lose( c, CHILD_DONE );
+	else if (strncmp( line, "Arg Master.", 11 ) == 0) {
+		fprintf(stderr, "# child %d failed: %s\n", n, line + 11 );
+		lose( c, CHILD_FAILED );
+	} else if (strncmp( line, "NAK ", 4 ) == 0)
+		fprintf(stderr, "# child %d: %s\n", n, line );
+	// (and its acknowledgements and comments are of no interest)
+}
+
+/*
+ * start our children and give them their arguments
+ */
+static void startChildren( int argc, const char **argv, int threads ) {
+	for( int i = 0; i < numChildren; i++ ) {
+		struct child *c = &children[i];
+		c->in = c->out = -1;
+		c->lastSeq = -1;
+		c->state = CHILD_STARTING;
+		if (!(c->where ? connectTo( c ) : spawn( c ))) {
+			fprintf(stderr, "# child %d (%s): %s\n", i, c->where ? c->where : "local",
+				strerror( errno ));
+			lose( c, CHILD_FAILED );
+		}
+	}
+	setThreads( threads, true );
+
+	// each prompts for its arguments, and then (we hope) accepts them
+	char line[CHILD_LINE];
+	for( int pass = 0; pass < 2; pass++ ) {
+		time_t deadline = time( 0 ) + CHILD_TIMEOUT;
+		for( int i = 0; i < numChildren; i++ ) {
+			struct child *c = &children[i];
+			bool answered = false;
+			while( c->state == CHILD_STARTING && !answered ) {
+				if (!childLine( c, line )) {
+					if (!childWait( c, deadline )) {
+						fprintf(stderr, "# child %d did not %s\n", i,
+							pass == 0 ? "prompt for its arguments" : "accept its arguments" );
+						lose( c, CHILD_FAILED );
+					}
+					continue;
+				}
+				if (pass == 0 && strstr( line, "Yes Master?" )) {
+					std::string args = childArgs( argc, argv, i );
+					char count[32];
+					snprintf( count, sizeof count, " --threads=%d", c->threads );
+					args += count;
+					if (loadgen_debug & D_CMDS)
+						fprintf(stderr, "# child %d <- %s\n", i, args.c_str() );
+					tell( c, args.c_str() );
+					answered = true;
+				} else if (pass == 1 && strncmp( line, "Yes Master!", 11 ) == 0) {
+					c->state = CHILD_RUNNING;
+				} else if (strncmp( line, "Arg Master.", 11 ) == 0) {
+					fprintf(stderr, "# child %d failed: %s\n", i, line + 11 );
+					lose( c, CHILD_FAILED );
+				}
+			}
+		}
+	}
+}
+
+/*
+ * run the load on our children, merging their reports
+ */
+int subMaster( int argc, const char **argv, int threads ) {
+	// a child that goes away should not take us with it
+	signal( SIGPIPE, SIG_IGN );
+
+	startChildren( argc, argv, threads );
+
+	// what our children have been told
+	long long rate = loadgen_rate;
+	int bsize = loadgen_bsize, depth = loadgen_depth;
+	int random = loadgen_rand_blk, mix = loadgen_mix;
+	bool quit = false;
+
+	for(;;) {
+		// pass on any changes to the load
+		//	(even if our master has disconnected, we may yet
+		//	have to tell our children to shut down)
+		char cmd[64];
+		if (loadgen_shutdown && !quit) {
+			tellAll( "x" );
+			quit = true;
+		}
+		if (loadgen_rate != rate) {
+			rate = loadgen_rate;
+			snprintf( cmd, sizeof cmd, "rate=%lld", rate );
+			tellAll( cmd );
+		}
+		if (loadgen_bsize != bsize) {
+			bsize = loadgen_bsize;
+			snprintf( cmd, sizeof cmd, "bsize=%d", bsize );
+			tellAll( cmd );
+		}
+		if (loadgen_depth != depth) {
+			depth = loadgen_depth;
+			snprintf( cmd, sizeof cmd, "depth=%d", depth );
+			tellAll( cmd );
+		}
+		if (loadgen_rand_blk != random) {
+			random = loadgen_rand_blk;
+			snprintf( cmd, sizeof cmd, "random=%d", random );
+			tellAll( cmd );
+		}
+		if (loadgen_mix != mix) {
+			mix = loadgen_mix;
+			snprintf( cmd, sizeof cmd, "mix=%d", mix );
+			tellAll( cmd );
+		}
+
+		// report the intervals everyone has reported
+		emitComplete( false );
+
+		// wait for commands (from our master) or reports (from children)
+		struct pollfd fds[MAX_CHILDREN + 1];
+		struct child *who[MAX_CHILDREN + 1];
+		int n = 0;
+		for( int i = 0; i < numChildren; i++ )
+			if (children[i].state == CHILD_RUNNING) {
+				fds[n].fd = children[i].out;
+				fds[n].events = POLLIN;
+				who[n++] = &children[i];
+			}
+		if (n == 0)
+			break;
+		if (acceptingCommands() && !quit) {
+			fds[n].fd = 0;
+			fds[n].events = POLLIN;
+			who[n++] = 0;
+		}
+		if (poll( fds, n, -1 ) < 0)
+			continue;	// (probably a signal)
+
+		for( int i = 0; i < n; i++ ) {
+			if (fds[i].revents == 0)
+				continue;
+
+			// a command from our master
+			if (who[i] == 0) {
+				do {
+					struct timespec soon;
+					clock_gettime( CLOCK_MONOTONIC, &soon );
+					soon.tv_nsec += 1000000;
+					if (soon.tv_nsec >= 1000000000) {
+						soon.tv_sec++;
+						soon.tv_nsec -= 1000000000;
+					}
+					int t = changeNumThreads( &soon );
+					if (t >= 0 && !loadgen_shutdown)
+						setThreads( t, false );
+				} while( commandPending() && !loadgen_shutdown );
+				continue;
+			}
+
+			// or something from a child
+			struct child *c = who[i];
+			bool more = childRead( c );
+			char line[CHILD_LINE];
+			while( c->state == CHILD_RUNNING && childLine( c, line ))
+				heard( c, line );
+			if (!more && c->state == CHILD_RUNNING) {
+				fprintf(stderr, "# child %d went away\n", (int) (c - children) );
+				lose( c, CHILD_FAILED );
+			}
+		}
+	}
+
+	// report whatever we have left
+	emitComplete( true );
+
+	int failed = 0;
+	for( int i = 0; i < numChildren; i++ )
+		if (children[i].state != CHILD_DONE)
+			failed++;
+	if (failed) {
+		loadgen_problem = "child failure";
+		return CHILD_ERROR;
+	}
+	return 0;
+}
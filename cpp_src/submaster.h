@@ -0,0 +1,54 @@
+/*
+ * a sub-master, which runs its load on child loadgens
+ *
+ *	A master that parses every REPORT line from hundreds of zombies
+ *	becomes the bottleneck.  With --children=, a loadgen generates
+ *	no load itself, but is a master to its own children, and
+ *	reports to its master as a single zombie: the horde becomes a
+ *	tree.  The children are either
+ *
+ *		N			local loadgens (that we start), or
+ *		HOST:PORT,...		loadgens listening (--listen=) there
+ *
+ *	and each is given our own switches (other than --children,
+ *	--report-format and --report-file, which are ours), with its
+ *	own --tag (ours, followed by .N), its share of our threads, and
+ *	any %n in a switch replaced by its number (e.g. so that the
+ *	children of --target=/mnt/disk%n each have a target of their
+ *	own).
+ *
+ *	Thread counts from our master are divided among the children,
+ *	and rate (and block, depth, random and mix) changes passed on
+ *	to all of them.  They report on the same schedule, and each
+ *	child's Nth report is merged with the others' (latency buckets
+ *	and all) into one report of our own, once every (running) child
+ *	has made it.  Their DETAIL lines (for --breakdown) are
+ *	passed on as they are.  The children get their thread counts
+ *	from us, so a sub-master cannot run a profile, SLO search or
+ *	sweep.
+ */
+
+// most children we can have
+#define	MAX_CHILDREN	64
+
+// how long a child has to answer (seconds)
+#define	CHILD_TIMEOUT	10
+
+/**
+ * parse a description of our children
+ *
+ * @param	number of local children, or a comma separated list of
+ *		HOST:PORT where they are listening
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *setChildren( const char *spec );
+
+/**
+ * run the load on our children, merging their reports
+ *
+ * @param	number of switches (as in main)
+ * @param	the switches (as in main)
+ * @param	number of threads to start with
+ * @return	exit status
+ */
+int subMaster( int argc, const char **argv, int threads );
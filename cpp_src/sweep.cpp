@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "loadgen.h"
+#include "perfstats.h"
+#include "pattern.h"
+#include "sweep.h"
+#include "report.h"
+#include "debug.h"
+
+static const char *axisNames[SWEEP_AXES] = { "bsize", "depth", "threads", "mix" };
+
+enum phase { IDLE, RUNNING, DONE };
+
+static enum phase phase = IDLE;
+static long long values[SWEEP_AXES][MAX_SWEEP_STEPS];	// the values of each axis
+static int steps[SWEEP_AXES];	// number of values on each axis
+static int warmup = 1;		// intervals of warm-up in each cell
+static int measure = 1;		// intervals of measurement in each cell
+static FILE *matrix = 0;	// where the results go
+
+static int cells;		// number of cells in the sweep
+static int cell;		// the cell we are running
+static int setting[SWEEP_AXES];	// its value on each axis
+static int intervals;		// intervals (of this cell) so far
+static long long usecs;		// length of its measurement window
+static perfstats sum;		// statistics for its measurement window
+
+/*
+ * parse a sweep description
+ */
+const char *setSweep( const char *spec ) {
+	char *copy = strdup( spec );
+	char *save = 0;
+	const char *err = 0;
+	for( char *s = strtok_r( copy, ",", &save ); s && err == 0; s = strtok_r( 0, ",", &save )) {
+		char *v = strchr( s, '=' );
+		if (v == 0 || v[1] == 0) {
+			err = "Malformed sweep";
+			break;
+		}
+		*v++ = 0;
+
+		// the length of each cell's windows
+		if (strcmp( s, "warmup" ) == 0 || strcmp( s, "measure" ) == 0) {
+			int n = atoi( v );
+			if (s[0] == 'w' ? n < 0 : n < 1)
+				err = "Invalid sweep window";
+			else if (s[0] == 'w')
+				warmup = n;
+			else
+				measure = n;
+			continue;
+		}
+
+		int a;
+		for( a = 0; a < SWEEP_AXES; a++ )
+			if (strcmp( s, axisNames[a] ) == 0)
+				break;
+		if (a == SWEEP_AXES || steps[a] > 0) {
+			err = "Malformed sweep";
+			break;
+		}
+
+		// and the values of each axis
+		char *save2 = 0;
+		for( char *w = strtok_r( v, ":", &save2 ); w; w = strtok_r( 0, ":", &save2 )) {
+			if (steps[a] >= MAX_SWEEP_STEPS) {
+				err = "Too many sweep values";
+				break;
+			}
+			long long n = (a == SWEEP_BSIZE) ? getSizeSpec( w ) : atoll( w );
+			if ((a == SWEEP_BSIZE && (n <= 0 || n > max_bsize())) ||
+			    (a == SWEEP_DEPTH && (n < 1 || n > MAX_MIX_DEPTH)) ||
+			    (a == SWEEP_THREADS && (n < 1 || n > MAX_THREADS)) ||
+			    (a == SWEEP_MIX && (n < 0 || n > 100))) {
+				err = "Invalid sweep value";
+				break;
+			}
+			values[a][steps[a]++] = n;
+		}
+	}
+	free( copy );
+	if (err)
+		return err;
+
+	cells = 1;
+	for( int a = 0; a < SWEEP_AXES; a++ )
+		if (steps[a] > 0)
+			cells *= steps[a];
+	if (cells == 1 && steps[SWEEP_BSIZE] + steps[SWEEP_DEPTH] +
+			steps[SWEEP_THREADS] + steps[SWEEP_MIX] == 0)
+		return "Empty sweep";
+
+	phase = RUNNING;
+	return 0;
+}
+
+/*
+ * create the matrix file
+ */
+const char *setMatrix( const char *file ) {
+	matrix = fopen( file, "w" );
+	if (matrix == 0)
+		return "Unable to create matrix file";
+	fprintf(matrix, "bsize,depth,threads,mix,seconds,bytes,rate,iops,reads,writes,"
+			"p50_us,p90_us,p99_us,p999_us\n");
+	fflush( matrix );
+	return 0;
+}
+
+bool sweeping() {
+	return phase == RUNNING;
+}
+
+/*
+ * the largest value on an axis (or 0 if it is not swept)
+ */
+static long long largest( int a ) {
+	long long max = 0;
+	for( int i = 0; i < steps[a]; i++ )
+		if (values[a][i] > max)
+			max = values[a][i];
+	return max;
+}
+
+int sweepThreads() {
+	return (int) largest( SWEEP_THREADS );
+}
+
+bool sweepLimits( int *bsize, int *depth ) {
+	if (phase == IDLE)
+		return false;
+	*bsize = (int) largest( SWEEP_BSIZE );
+	*depth = (int) largest( SWEEP_DEPTH );
+	return true;
+}
+
+/*
+ * set up for the next cell
+ *
+ * @return	number of threads it calls for
+ */
+static int startCell() {
+	// the mix varies fastest, and the block size slowest
+	int n = cell;
+	for( int a = SWEEP_AXES - 1; a >= 0; a-- ) {
+		if (steps[a] > 1) {
+			setting[a] = (int) values[a][n % steps[a]];
+			n /= steps[a];
+		} else if (steps[a] == 1)
+			setting[a] = (int) values[a][0];
+	}
+	loadgen_bsize = setting[SWEEP_BSIZE];
+	loadgen_depth = setting[SWEEP_DEPTH];
+	loadgen_mix = setting[SWEEP_MIX];
+
+	intervals = 0;
+	usecs = 0;
+	sum.reset();
+	if (loadgen_debug & D_CMDS)
+		fprintf(stderr, "# sweep cell %d/%d: bsize=%d depth=%d threads=%d mix=%d\n",
+			cell + 1, cells, setting[SWEEP_BSIZE], setting[SWEEP_DEPTH],
+			setting[SWEEP_THREADS], setting[SWEEP_MIX] );
+	return setting[SWEEP_THREADS];
+}
+
+/*
+ * start the sweep
+ */
+int sweepStart( int max ) {
+	if (!sweeping())
+		return -1;
+
+	// axes that are not swept keep their (switch) values
+	setting[SWEEP_BSIZE] = loadgen_bsize;
+	setting[SWEEP_DEPTH] = (loadgen_depth > 1) ? loadgen_depth.load() : 1;
+	setting[SWEEP_THREADS] = max;
+	setting[SWEEP_MIX] = (loadgen_mix >= 0) ? loadgen_mix.load() : 0;
+
+	cell = 0;
+	return startCell();
+}
+
+/*
+ * note the results of a reporting interval
+ */
+int sweepInterval( int threads, long microseconds, perfstats *s ) {
+	if (!sweeping())
+		return setting[SWEEP_THREADS];
+
+	// if threads have finished, there can be no more cells
+	if (threads < setting[SWEEP_THREADS] || loadgen_shutdown) {
+		sweepEnd();
+		return 0;
+	}
+
+	// creating files is not warming up
+	if (!mixReady())
+		return setting[SWEEP_THREADS];
+	if (intervals++ < warmup)
+		return setting[SWEEP_THREADS];
+
+	sum += *s;
+	usecs += microseconds;
+	if (intervals < warmup + measure)
+		return setting[SWEEP_THREADS];
+
+	// this cell is done
+	long long rate = usecs > 0 ? (sum.total_bytes * 1000000) / usecs : 0;
+	long long iops = usecs > 0 ? ((sum.reads + sum.writes) * 1000000LL) / usecs : 0;
+	sweepReport( setting[SWEEP_BSIZE], setting[SWEEP_DEPTH], setting[SWEEP_THREADS],
+			setting[SWEEP_MIX], usecs, rate, iops, &sum );
+	if (matrix) {
+		fprintf(matrix, "%d,%d,%d,%d,%.6f,%lld,%lld,%lld,%ld,%ld,%ld,%ld,%ld,%ld\n",
+			setting[SWEEP_BSIZE], setting[SWEEP_DEPTH], setting[SWEEP_THREADS],
+			setting[SWEEP_MIX], usecs / 1000000.0, sum.total_bytes, rate, iops,
+			sum.reads, sum.writes, sum.percentile( 50 ), sum.percentile( 90 ),
+			sum.percentile( 99 ), sum.percentile( 99.9 ));
+		fflush( matrix );
+	}
+
+	if (++cell < cells)
+		return startCell();
+	sweepEnd();
+	return 0;
+}
+
+/*
+ * end the sweep
+ */
+void sweepEnd() {
+	if (!sweeping())
+		return;
+	phase = DONE;
+	if (cell < cells)
+		fprintf(stderr, "WARNING: sweep ended after %d of %d cells\n", cell, cells);
+	if (matrix) {
+		fclose( matrix );
+		matrix = 0;
+	}
+}
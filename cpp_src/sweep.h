@@ -0,0 +1,102 @@
+/*
+ * parameter sweeps
+ *
+ *	Characterizing a storage tier means measuring it across a range
+ *	of block sizes, queue depths, thread counts and read/write mixes.
+ *	Rather than running loadgen once for each combination, a sweep
+ *	runs every cell of the cartesian product in a single process,
+ *	with the mixed read/write workers, which keep their buffers and
+ *	files from one cell to the next.  A sweep is described by a
+ *	list of axes (and their values), and the number of reporting
+ *	intervals in each cell's warm-up and measurement windows, e.g.
+ *
+ *		bsize=4k:64k:1m,depth=1:8,threads=1:4:16,mix=100:70:0,warmup=1,measure=2
+ *
+ *	Mix is the percentage of operations that are reads.  An axis
+ *	that is not swept keeps the value given by its own switch.
+ *	Cells are run with the mix varying fastest (and block size
+ *	slowest).  Intervals in which workers are still creating their
+ *	files do not count as warm-up.  When a cell's measurement window
+ *	is over, its results are reported (as a SWEEP line) and added
+ *	to the (CSV) matrix file, and when the last cell is done, we
+ *	shut down.
+ */
+
+// the axes of a sweep
+#define	SWEEP_BSIZE	0
+#define	SWEEP_DEPTH	1
+#define	SWEEP_THREADS	2
+#define	SWEEP_MIX	3
+#define	SWEEP_AXES	4
+
+// most values we will accept for any one axis
+#define	MAX_SWEEP_STEPS	32
+
+// deepest queue a mixed worker can be asked for
+#define	MAX_MIX_DEPTH	256
+
+class perfstats;
+
+/**
+ * parse a sweep description
+ *
+ * @param	comma separated list of axis=value:value... and
+ *		warmup=intervals or measure=intervals
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *setSweep( const char *spec );
+
+/**
+ * create the matrix file for the sweep results
+ *
+ * @param	name of the file
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *setMatrix( const char *file );
+
+/**
+ * is a sweep (still) in progress
+ *
+ * @return	true if it is
+ */
+bool sweeping();
+
+/**
+ * the most threads any cell of the sweep will need
+ *
+ * @return	number of threads (or 0 if threads are not swept)
+ */
+int sweepThreads();
+
+/**
+ * the largest blocks and deepest queue any cell of the sweep will need
+ *	(so workers can allocate their buffers once)
+ *
+ * @param	(returned) largest block size
+ * @param	(returned) deepest queue
+ * @return	false if there is no sweep
+ */
+bool sweepLimits( int *bsize, int *depth );
+
+/**
+ * start the sweep
+ *
+ * @param	number of threads available
+ * @return	number of threads for the first cell
+ */
+int sweepStart( int max );
+
+/**
+ * note the results of a reporting interval
+ *
+ * @param	number of threads that were running
+ * @param	length of the interval (us)
+ * @param	statistics for the interval
+ * @return	number of threads for the current (or next) cell
+ */
+int sweepInterval( int threads, long microseconds, perfstats *s );
+
+/**
+ * end the sweep (early, if it is still in progress)
+ */
+void sweepEnd();
@@ -1,34 +1,83 @@
 #include <stdio.h>
+#include <string.h>
 #include <malloc.h>
 #include <unistd.h>
+#include <time.h>
 
 #include "loadgen.h"
 #include "threadstatus.h"
+#include "affinity.h"
+#include "statshm.h"
+#include "report.h"
+#include "profile.h"
+#include "autotune.h"
+#include "sweep.h"
+#include "workerprocs.h"
+#include "flush.h"
+#include "wal.h"
 #include "debug.h"
 
+/*
+ * threads that have exited (but not yet been harvested)
+ *	(which are in shared memory if there are worker processes)
+ */
+struct exitList {
+	pthread_mutex_t lock;		///< protects the rest
+	pthread_cond_t wait;		///< signalled when a thread exits
+	ThreadStatus *exited;		///< exited, awaiting harvest
+	int live;			///< started, not yet exited
+};
+static struct exitList localExits = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0 };
+
 // real implementations of the ThreadStatus class
 ThreadStatus *ThreadStatus::listHead = 0;	// head of list descriptors
+ThreadStatus *ThreadStatus::listTail = 0;	// tail of list descriptors
+struct exitList *ThreadStatus::exits = &localExits;	// exited threads
+
+/*
+ * descriptors are in shared memory if there are worker processes
+ */
+void *ThreadStatus::operator new( size_t size ) {
+	void *p = procsShared( size );
+	return p ? p : ::operator new( size );
+}
+
+void ThreadStatus::operator delete( void *p ) {
+	if (!procsOwns( p ))	// (shared memory goes when we do)
+		::operator delete( p );
+}
 
 /*
- * allocate and initialize a new threadStatus 
+ * allocate and initialize a new threadStatus
  */
 ThreadStatus::ThreadStatus( char *threadName, void *threadParms ) {
 	// initialize the new descriptor
 	name = threadName;
 	parms = threadParms;
+	target = 0;
 	enable = false;
 	started = false;
 	running = false;
+	parked = false;
 	exit_status = 0;
 	_next = 0;
+	_nextExit = 0;
+	procsInitLock( &_lock, &_wakeup );
+
+	// the worker processes must also be able to report their exits
+	if (exits == &localExits && procsOwns( this )) {
+		exits = (struct exitList *) procsShared( sizeof (struct exitList) );
+		procsInitLock( &exits->lock, &exits->wait );
+		exits->exited = 0;
+		exits->live = 0;
+	}
 
 	// add us to the end of the chain
-	ThreadStatus *t;
-	for( t = listHead; t && t->_next; t = t->_next);
-	if (t)
-		t->_next = this;
+	if (listTail)
+		listTail->_next = this;
 	else
 		listHead = this;
+	listTail = this;
 }
 
 /*
@@ -47,7 +96,9 @@ ThreadStatus::~ThreadStatus() {
 		}
 	} else if (prev->_next == this) {
 		prev->_next = _next;
-	} 
+	}
+	if (listTail == this)
+		listTail = prev;
 	_next = 0;
 
 	// free up the stuff we point to
@@ -55,7 +106,293 @@ ThreadStatus::~ThreadStatus() {
 	name = 0;
 	free( parms );
 	parms = 0;
+	pthread_cond_destroy( &_wakeup );
+	pthread_mutex_destroy( &_lock );
+}
+
+/*
+ * a disabled worker waits here until it is re-enabled
+ */
+bool ThreadStatus::park() {
+	pthread_mutex_lock( &_lock );
+	while( !enable && !loadgen_shutdown ) {
+		parked = true;
+		pthread_cond_wait( &_wakeup, &_lock );
+	}
+	parked = false;
+	pthread_mutex_unlock( &_lock );
+
+	return !loadgen_shutdown;
+}
+
+/*
+ * wake up a parked worker (re-enabling it, or so it can shut down)
+ */
+void ThreadStatus::unpark( bool reenable ) {
+	pthread_mutex_lock( &_lock );
+	if (reenable)
+		enable = true;
+	pthread_cond_signal( &_wakeup );
+	pthread_mutex_unlock( &_lock );
+}
+
+/*
+ * a worker reports its exit status to the manager
+ */
+void ThreadStatus::exiting( int status ) {
+	pthread_mutex_lock( &exits->lock );
+	exit_status = status;
+	running = false;
+	_nextExit = exits->exited;
+	exits->exited = this;
+	exits->live--;
+	pthread_cond_signal( &exits->wait );
+	pthread_mutex_unlock( &exits->lock );
+}
+
+/*
+ * wait (up to a specified time) for all started threads to exit
+ */
+void ThreadStatus::awaitExits( const struct timespec *deadline ) {
+	pthread_mutex_lock( &exits->lock );
+	while( exits->live > 0 ) {
+		if (deadline) {
+			if (pthread_cond_clockwait( &exits->wait, &exits->lock, CLOCK_MONOTONIC, deadline ) != 0)
+				break;
+		} else
+			pthread_cond_wait( &exits->wait, &exits->lock );
+	}
+	pthread_mutex_unlock( &exits->lock );
+}
+
+/*
+ * figure out when the first report is due
+ *
+ *	Reports are due at multiples of the update interval (since the
+ *	epoch), so that the reports of instances on different machines
+ *	cover the same intervals.  We work out when the next such time
+ *	is (skipping it if we are already more than half way through the
+ *	interval), and express it as a CLOCK_MONOTONIC time, so that
+ *	changes to the time of day do not disrupt the schedule.
+ *
+ * @param	(returned) CLOCK_MONOTONIC time of the first report
+ */
+static void firstReport( struct timespec *due ) {
+	struct timespec mono, real;
+	clock_gettime( CLOCK_MONOTONIC, &mono );
+	clock_gettime( CLOCK_REALTIME, &real );
+
+	long long period = loadgen_update * 1000000LL;		// ns
+	long long wall = real.tv_sec * 1000000000LL + real.tv_nsec;
+	long long wait = period - (wall % period);
+	if (wait < period / 2)
+		wait += period;
+
+	long long when = mono.tv_sec * 1000000000LL + mono.tv_nsec + wait;
+	due->tv_sec = when / 1000000000LL;
+	due->tv_nsec = when % 1000000000LL;
+}
+
+/*
+ * figure out when the next report is due
+ *	(on an absolute schedule, skipping any we have missed)
+ *
+ * @param	(updated) CLOCK_MONOTONIC time of the next report
+ * @param	current CLOCK_MONOTONIC time
+ */
+static void nextReport( struct timespec *due, const struct timespec *now ) {
+	long long period = loadgen_update * 1000000LL;		// ns
+	long long when = due->tv_sec * 1000000000LL + due->tv_nsec;
+	long long time = now->tv_sec * 1000000000LL + now->tv_nsec;
+	do {
+		when += period;
+	} while( when <= time );
+
+	due->tv_sec = when / 1000000000LL;
+	due->tv_nsec = when % 1000000000LL;
+}
+
+/*
+ * per-target and per-thread breakdowns of each report
+ */
+static perfstats *lastStats = 0;	// each thread's totals at the last report
+static perfstats *deltas = 0;		// each thread's most recent interval
+static int *targetOf = 0;		// index of each thread's target
+static const char **targetName = 0;	// the distinct targets
+static perfstats *targetSums = 0;	// each target's most recent interval
+static int *targetThreads = 0;		// threads running on each target
+static int numTargets = 0;
+static int numClassified = 0;		// threads whose targets we know
+static int breakdownRoom = 0;		// threads the tables have room for
+
+/*
+ * move a breakdown table to a bigger one
+ *
+ * @param	(updated) the table
+ * @param	entries it has
+ * @param	entries it needs
+ */
+template <class T> static void growTable( T *&table, int had, int room ) {
+	T *bigger = new T[room];
+	for( int i = 0; i < had; i++ )
+		bigger[i] = table[i];
+	delete[] table;
+	table = bigger;
+}
+
+/*
+ * figure out which threads are working on which targets
+ *	(several threads may share a target, e.g. a split file),
+ *	making room for them (again whenever more are defined)
+ *
+ * @param	descriptors for all of the threads
+ * @param	number of threads
+ */
+static void growBreakdown( ThreadStatus **all, int defined ) {
+	if (defined > breakdownRoom) {
+		int room = (defined > 2 * breakdownRoom) ? defined : 2 * breakdownRoom;
+		growTable( lastStats, breakdownRoom, room );
+		growTable( deltas, breakdownRoom, room );
+		growTable( targetSums, breakdownRoom, room );
+		growTable( targetOf, breakdownRoom, room );
+		growTable( targetThreads, breakdownRoom, room );
+		growTable( targetName, breakdownRoom, room );
+		breakdownRoom = room;
+	}
+
+	for( int i = numClassified; i < defined; i++ ) {
+		const char *name = all[i]->target ? all[i]->target : "unknown";
+		int t = 0;
+		while( t < numTargets && strcmp( targetName[t], name ) != 0 )
+			t++;
+		if (t == numTargets)
+			targetName[numTargets++] = name;
+		targetOf[i] = t;
+	}
+	numClassified = defined;
+}
+
+/*
+ * break the most recent report down by target and thread, and
+ * summarize how fairly the throughput was divided among the threads
+ *
+ * @param	descriptors for the threads that have been started
+ * @param	number of threads that have been started
+ * @param	length of the interval (us)
+ */
+static void breakdown( ThreadStatus **all, int started, long microseconds ) {
+	for( int t = 0; t < numTargets; t++ ) {
+		targetSums[t].reset();
+		targetThreads[t] = 0;
+	}
+
+	// figure out what each thread did in this interval
+	for( int i = 0; i < started; i++ ) {
+		deltas[i] = all[i]->stats;
+		deltas[i] -= lastStats[i];
+		lastStats[i] = all[i]->stats;
+		targetSums[targetOf[i]] += deltas[i];
+		if (all[i]->running && !all[i]->parked)
+			targetThreads[targetOf[i]]++;
+	}
+
+	if (loadgen_breakdown & BREAKDOWN_TARGETS)
+		for( int t = 0; t < numTargets; t++ )
+			if (targetThreads[t] > 0 || targetSums[t].total_bytes > 0)
+				detailReport( targetName[t], -1, targetThreads[t],
+						microseconds, &targetSums[t] );
+
+	// fairness is judged among the threads that are still running
+	int n = 0;
+	double sum = 0, squares = 0;
+	long long lo = 0, hi = 0;
+	for( int i = 0; i < started; i++ ) {
+		bool active = all[i]->running && !all[i]->parked;
+		if (!active && deltas[i].total_bytes == 0)
+			continue;
+		if (loadgen_breakdown & BREAKDOWN_THREADS)
+			detailReport( targetName[targetOf[i]], i, 1, microseconds, &deltas[i] );
+		if (!active)
+			continue;
+
+		long long rate = microseconds > 0 ? (deltas[i].total_bytes * 1000000) / microseconds : 0;
+		if (n == 0 || rate < lo)
+			lo = rate;
+		if (n == 0 || rate > hi)
+			hi = rate;
+		sum += rate;
+		squares += (double) rate * rate;
+		n++;
+	}
+
+	// Jain's index: 1 if they are all equal, 1/n if one did everything
+	if (n > 0)
+		fairnessReport( n, lo, hi, squares > 0 ? (sum * sum) / (n * squares) : 1.0 );
+}
+
+/*
+ * free up the breakdown tables
+ */
+static void endBreakdown() {
+	delete[] lastStats;
+	delete[] deltas;
+	delete[] targetSums;
+	delete[] targetOf;
+	delete[] targetThreads;
+	delete[] targetName;
+	lastStats = deltas = targetSums = 0;
+	targetOf = targetThreads = 0;
+	targetName = 0;
+	numTargets = 0;
+	numClassified = 0;
+	breakdownRoom = 0;
 }
+
+/*
+ * what the worker processes need to know (set before they are forked)
+ */
+static ThreadStatus **procThreads = 0;	// all of the defined threads
+static int procDefined = 0;		// how many of them there are
+static void *(*procRoutine)(void *) = 0;
+static int procStackSize = 0;
+
+/*
+ * (worker process) start our share of the threads as they are wanted
+ *
+ *	Thread n belongs to process n % loadgen_procs.  The manager does
+ *	all of the bookkeeping (enabling, parking and harvesting them);
+ *	we merely create them, and pass on a shutdown to any that are
+ *	parked (since they check our copy of loadgen_shutdown).
+ */
+void ThreadStatus::serveProcess( int proc ) {
+	int started = 0;
+	int next = proc;
+	while( procsWait( &started )) {
+		while( next < started && next < procDefined ) {
+			ThreadStatus *sts = procThreads[next];
+			cpu_set_t cpus;
+			pthread_attr_t attr;
+			pthread_attr_init( &attr );
+			pthread_attr_setstacksize( &attr, procStackSize );
+			pthread_attr_setdetachstate( &attr, true );
+			if (workerAffinity( next, &cpus ))
+				pthread_attr_setaffinity_np( &attr, sizeof cpus, &cpus );
+			if (pthread_create( &sts->thread, &attr, procRoutine, (void *) sts ) != 0) {
+				fprintf(stderr, "Thread creation failure in worker process %d\n", proc);
+				sts->exiting( RESOURCE_ERROR );
+			} else if (loadgen_debug & D_THREADS)
+				fprintf(stderr, "# worker process %d started thread %s\n", proc, sts->name);
+			pthread_attr_destroy( &attr );
+			next += loadgen_procs;
+		}
+
+		// parked threads have to wake up to shut down
+		if (loadgen_shutdown)
+			for( int i = proc; i < next && i < procDefined; i += loadgen_procs )
+				procThreads[i]->unpark( false );
+	}
+}
+
 /**
  * The thread manager doesn't actually understand what these
  * threads are supposed to be doing.  It merely:
@@ -67,23 +404,94 @@ ThreadStatus::~ThreadStatus() {
  *  - the thread service routine
  *  - the supplied parameters
  * both of which come from the caller
+ *<br>
+ * Threads are started (in the order they were defined) as they are
+ * needed.  When we want fewer, the most recently enabled threads are
+ * parked, and when we want more, the most recently parked threads are
+ * resumed (before any new threads are started).  All of this is done
+ * with stacks of descriptors, so the cost of changing the number of
+ * threads does not depend on how many threads have been defined.
+ *<br>
+ * If the caller gave us a routine to define them, threads are only
+ * defined when more are wanted than have been defined (and so we
+ * never have more descriptors than the most threads ever wanted).
  */
-int 
-ThreadStatus:: manageThreads( void *(*routine)(void *), int threads, int stacksize ) {
+int
+ThreadStatus:: manageThreads( void *(*routine)(void *), int threads, int stacksize,
+			bool (*define)( int n ) ) {
 	int status = 0;		// return status
 	int wanted = threads;	// number of threads I am targeting
 	int enabled = 0;	// number of threads currently enabled
-	int running = 0;	// number of threads currently running
+	int running = 0;	// number of threads currently running (not parked)
+	int idling = 0;		// number of threads currently parked
 	int available = 0;	// number of threads ready to be started
 
-	// count up the defined threads
+	// index the defined threads, so we never have to search for one
 	for( ThreadStatus *t = ThreadStatus::first(); t != 0; t = t->next() )
 		available++;
-	
+
+	// worker processes can only start threads defined before the fork
+	if (loadgen_procs > 1 && define) {
+		while( available < PROCS_THREADS && define( available ))
+			available++;
+		define = 0;
+	}
+	int defined = available;
+	int numStarted = 0;
+	int room = define ? MAX_THREADS : defined;	// (just pointers)
+	ThreadStatus **all = (ThreadStatus **) malloc( (room + 1) * sizeof *all );
+	ThreadStatus **active = (ThreadStatus **) malloc( (room + 1) * sizeof *active );
+	ThreadStatus **idle = (ThreadStatus **) malloc( (room + 1) * sizeof *idle );
+	if (all == 0 || active == 0 || idle == 0) {
+		fprintf(stderr, "FATAL: unable to allocate thread tables\n");
+		loadgen_problem = "malloc failure";
+		return RESOURCE_ERROR;
+	}
+	int numActive = 0;	// enabled threads, most recently enabled on top
+	int numIdle = 0;	// parked threads, most recently parked on top
+	defined = 0;
+	for( ThreadStatus *t = ThreadStatus::first(); t != 0; t = t->next() )
+		all[defined++] = t;
+	statsThreads( all, defined );
+	if (loadgen_breakdown)
+		growBreakdown( all, defined );
+
+	// worker processes (if any) take over creating the threads
+	//	(before we pin ourselves, which they would inherit)
+	if (loadgen_procs > 1) {
+		procThreads = all;
+		procDefined = defined;
+		procRoutine = routine;
+		procStackSize = stacksize;
+		const char *problem = procsStart( serveProcess );
+		if (problem) {
+			loadgen_problem = problem;
+			procsEnd();
+			return RESOURCE_ERROR;
+		}
+	}
+
+	// the manager runs near the (first) workers
+	cpu_set_t cpus;
+	char cpulist[256];
+	if (managerAffinity( &cpus )) {
+		pthread_setaffinity_np( pthread_self(), sizeof cpus, &cpus );
+		if (loadgen_debug & D_THREADS)
+			fprintf(stderr, "# thread manager on cpu(s) %s\n", 
+				cpuList( &cpus, cpulist, sizeof cpulist ));
+	}
+
 	// initialize our throughput computation
 	perfstats prev, sum, delta;
 	hires_time_t time_now = hires_time();
 	hires_time_t time_prev = time_now;
+	struct timespec due, now, wake;
+	firstReport( &due );
+	if (tuning())
+		wanted = tuneStart( define ? MAX_THREADS : defined );
+	if (sweeping())
+		wanted = sweepStart( defined );	// (sweeps always predefine theirs)
+	bool more;		// is there anything left to manage
 
 	/*
 	 * main loop (until we shut down)
@@ -98,121 +506,266 @@ ThreadStatus:: manageThreads( void *(*routine)(void *), int threads, int stacksi
 	 *	its status before it could even start.
 	 *
 	 *	This problem started happening when I created some very fast test
-	 *	cases in detached zombie mode.  We prevent this by setting running 
-	 *	when the thread is created (here) rather than in the thread start-up 
-	 *	function.  The only down-side is that we cannot detect the 
-	 *	(extremely unlikely) situation where (for some reason) the thread 
-	 *	start-up function never gets called.
+	 *	cases in detached zombie mode.  We prevent this by setting running
+	 *	(here) before the thread is created, rather than in the thread
+	 *	start-up function or after pthread_create returns (by which time
+	 *	a very fast thread may already have finished, leaving us waiting
+	 *	forever for a thread that no longer exists).
 	 */
 	do {
 		// see if we've been told to shut down
 		if (loadgen_shutdown) {
 			wanted = 0;		// we don't want any more threads
-			available = 0;		// and we don't have any anyway
+			available = 0;		// and we won't start any more
+			define = 0;		// (or define any more)
+
+			// parked threads have to wake up to shut down
+			while( numIdle > 0 )
+				idle[--numIdle]->unpark( false );
+		} else {
+			// see what our load profile (if any) calls for
+			clock_gettime( CLOCK_MONOTONIC, &now );
+			int n = profileUpdate( &now, &wake );
+			if (n >= 0)
+				wanted = n;
+			if (wake.tv_sec > due.tv_sec ||
+			    (wake.tv_sec == due.tv_sec && wake.tv_nsec > due.tv_nsec))
+				wake = due;
 		}
+		procsPublish();		// (if there are worker processes)
 
-		// count threads still running and harvest status 
-		for( ThreadStatus *t = ThreadStatus::first(); t != 0; t = t->next() ) {
-			if (t->started && !t->running) {
-				if (t->enable == true) {	// see race condition note
-					t->enable = false;
-					enabled--;
-					if (loadgen_debug & D_THREADS) 
-						fprintf(stderr, "# disable and harvest %s\n", t->name);
-				}
+		// harvest the status of threads that have exited
+		pthread_mutex_lock( &exits->lock );
+		ThreadStatus *gone = exits->exited;
+		exits->exited = 0;
+		pthread_mutex_unlock( &exits->lock );
+		for( ThreadStatus *t = gone; t != 0; t = t->_nextExit ) {
+			if (t->enable == true) {	// see race condition note
+				t->enable = false;
+				enabled--;
+				if (loadgen_debug & D_THREADS)
+					fprintf(stderr, "# disable and harvest %s\n", t->name);
+			}
 
-				// check fo rerrors
-				status |= t->exit_status;
-				if (status != 0 && loadgen_halt)
-					loadgen_shutdown = true;
-			} 
+			// check for errors
+			status |= t->exit_status;
+			if (status != 0 && loadgen_halt)
+				loadgen_shutdown = true;
 		}
-		
-		// see if we need to start-up any new threads
-		while( enabled < wanted && available > 0) {
+
+		// see if we need to start-up (or resume) any threads
+		while( enabled < wanted ) {
+			// parked threads pick up where they left off
 			ThreadStatus *sts = 0;
+			while( numIdle > 0 && sts == 0 ) {
+				sts = idle[--numIdle];
+				if (!sts->running)	// it has since exited
+					sts = 0;
+			}
+			if (sts) {
+				sts->unpark( true );
+				active[numActive++] = sts;
+				enabled++;
+				if (loadgen_debug & D_THREADS)
+					fprintf(stderr, "# resuming thread %s\n", sts->name);
+				continue;
+			}
 
-			// find the first not-yet-run thread
-			for( sts = ThreadStatus::first(); sts != 0 && sts->started; sts = sts->next() );
+			// define another thread (if we may)
+			if (available == 0 && define && defined < MAX_THREADS) {
+				if (!define( defined )) {
+					fprintf(stderr, "Unable to define thread %d\n", defined );
+					break;
+				}
+				all[defined++] = listTail;
+				available++;
+				statsThreads( all, defined );
+				if (loadgen_breakdown)
+					growBreakdown( all, defined );
+			}
 
-			// we have already run all of the threads we were asked to manage
-			if (sts == 0)
+			// we have already started all of the threads we were asked to manage
+			if (available == 0)
 				break;
-			
+			sts = all[numStarted];
+
 			// kick off a new (detached) thread to serve it
 			sts->enable = true;
-			pthread_attr_t attr;
-			pthread_attr_init( &attr );
-			pthread_attr_setstacksize( &attr, stacksize );
-			pthread_attr_setdetachstate( &attr, true );
-			int ret = pthread_create( &sts->thread, &attr, routine, (void *) sts );
-			pthread_attr_destroy( &attr );
+			sts->started = true;
+			sts->running = true;	// this prevents the above race
+			pthread_mutex_lock( &exits->lock );
+			exits->live++;
+			pthread_mutex_unlock( &exits->lock );
+
+			// (a worker process creates it, and reports if it can't)
+			int ret = 0;
+			bool pinned = false;
+			if (loadgen_procs <= 1) {
+				pthread_attr_t attr;
+				pthread_attr_init( &attr );
+				pthread_attr_setstacksize( &attr, stacksize );
+				pthread_attr_setdetachstate( &attr, true );
+				pinned = workerAffinity( numStarted, &cpus );
+				if (pinned)
+					pthread_attr_setaffinity_np( &attr, sizeof cpus, &cpus );
+				ret = pthread_create( &sts->thread, &attr, routine, (void *) sts );
+				pthread_attr_destroy( &attr );
+			}
 			if (ret == 0) {
 				enabled++;
 				available--;
-				sts->started = true;
-				sts->running = true;	// this prevents the above race
+				numStarted++;
+				if (loadgen_procs > 1)
+					procsRequest( numStarted );
+				active[numActive++] = sts;
 				if (loadgen_debug & D_THREADS)
-					fprintf(stderr, "# enabling new thread %s\n", sts->name);
+					fprintf(stderr, "# enabling new thread %s%s%s\n", sts->name,
+						pinned ? " on cpu(s) " : "",
+						pinned ? cpuList( &cpus, cpulist, sizeof cpulist ) : "" );
 				continue;
-			} 
+			}
+
+			// it never started, so it can't be running
+			sts->enable = false;
+			sts->started = false;
+			sts->running = false;
+			pthread_mutex_lock( &exits->lock );
+			exits->live--;
+			pthread_mutex_unlock( &exits->lock );
 			fprintf(stderr, "Thread creation failure; enabled=%d, wanted=%d\n",
 				enabled, wanted );
 			break;
 		}
 
-		// see if we need to shut down any threads
+		// see if we need to park any threads
 		while( enabled > wanted ) {
-			// find the first enabled thread
-			ThreadStatus *t;
-			for( t = ThreadStatus::first(); t != 0 && !t->enable; t = t->next() );
-			if ( t && t->enable ) {
+			// find the most recently enabled thread
+			ThreadStatus *t = 0;
+			while( numActive > 0 && t == 0 ) {
+				t = active[--numActive];
+				if (!t->enable)		// it has since been harvested
+					t = 0;
+			}
+			if (t) {
 				t->enable = false;
+				idle[numIdle++] = t;
 				enabled--;
 				if (loadgen_debug & D_THREADS)
-					fprintf(stderr, "# disabling excess thread %s\n", t->name);
+					fprintf(stderr, "# parking excess thread %s\n", t->name);
 				continue;
 			}
 
-			fprintf(stderr, 
+			fprintf(stderr,
 				"No enabled threads to shut down; enabled=%d, wanted=%d\n",
 				enabled, wanted );
 			break;
 		}
 
-		// wait for input, a signal, or an update interval
-		int rslt = changeNumThreads( loadgen_update );
-		if (rslt >= 0) {
-			if (loadgen_debug & D_CMDS)
-				fprintf(stderr, "# Change number of threads to %d\n", rslt );
-			wanted = rslt;
+		if (loadgen_shutdown) {
+			// there is nothing left to do but wait for them to finish
+			awaitExits( &due );
+		} else {
+			// wait for input, a signal, the next report or profile change
+			//	(a command does not cut the reporting interval short)
+			int rslt = changeNumThreads( &wake );
+			if (rslt >= 0) {
+				if (loadgen_debug & D_CMDS)
+					fprintf(stderr, "# Change number of threads to %d\n", rslt );
+				wanted = rslt;
+				profileOverride();
+				tuneEnd();	// the master knows what it wants
+				sweepEnd();
+			}
 		}
 
-		// take a census and gather throughput data
+		// take a census
 		running = 0;
-		sum.reset();
-		time_now = hires_time();
-		for( ThreadStatus *t = ThreadStatus::first(); t != 0; t = t->next() ) {
-			sum += t->stats;
-			if (t->running)
-				running++;
+		idling = 0;
+		for( int i = 0; i < numStarted; i++ ) {
+			ThreadStatus *t = all[i];
+			if (t->running) {
+				if (t->parked)
+					idling++;
+				else
+					running++;
+			}
 		}
 
+		// parked (or undefined) threads only matter if someone can ask for them
+		more = available > 0 || running > 0 ||
+			((idling > 0 || (define && defined < MAX_THREADS)) &&
+			 (acceptingCommands() || profileActive()));
+
+		// see if a report is due (or this is our last chance)
+		clock_gettime( CLOCK_MONOTONIC, &now );
+		if (more && (now.tv_sec < due.tv_sec || 
+			    (now.tv_sec == due.tv_sec && now.tv_nsec < due.tv_nsec)))
+			continue;
+		nextReport( &due, &now );
+
 		// compute and report the most recently achieved bandwidth
+		sum.reset();
+		time_now = hires_time();
+		for( int i = 0; i < numStarted; i++ )
+			sum += all[i]->stats;
 		delta = sum;
 		delta -= prev;
 		hires_time_t delta_t = time_now - time_prev;
 		report( running, (long) delta_t, &delta );
-			
+		statsPublish( all, numStarted, (long) delta_t, &sum, &delta );
+		if (flushPolicy() != FLUSH_NONE)
+			flushReport( flushSpec(), (long) delta_t, &delta );
+		if (walActive())
+			walInterval( (long) delta_t, &delta );
+		if (loadgen_breakdown)
+			breakdown( all, numStarted, (long) delta_t );
+
+		// a saturation search moves on to its next trial
+		if (tuning()) {
+			wanted = tuneInterval( running, (long) delta_t, &delta );
+
+			// if nobody can tell us to stop, we are done
+			if (!tuning() && !acceptingCommands())
+				loadgen_shutdown = true;
+		}
+
+		// as does a sweep (which is done after its last cell)
+		if (sweeping()) {
+			wanted = sweepInterval( running, (long) delta_t, &delta );
+			if (!sweeping())
+				loadgen_shutdown = true;
+		}
+
 		// and reset the counters for next time
 		prev = sum;
 		time_prev = time_now;
-	} while( available > 0 || running > 0 );
-		
+	} while( more );
+
+	// any threads still parked will never be needed again
+	if (idling > 0) {
+		loadgen_shutdown = true;
+		procsPublish();
+		for( int i = 0; i < numStarted; i++ )
+			all[i]->unpark( false );
+		awaitExits( 0 );
+		for( ThreadStatus *t = exits->exited; t != 0; t = t->_nextExit )
+			status |= t->exit_status;
+		exits->exited = 0;
+	}
+
+	status |= procsEnd();
+	tuneEnd();
+	sweepEnd();
+	statsClose();
+	if (loadgen_breakdown)
+		endBreakdown();
+
 	// free up our thread status structures
 	while( ThreadStatus *t = ThreadStatus::first() )
 		delete t;
-	
+	free( all );
+	free( active );
+	free( idle );
+
 	return status;
 }
-
@@ -1,33 +1,49 @@
 #include <pthread.h>
+#include <atomic>
 #include "perfstats.h"
 
 /**
  * Each load generation thread is represented by one of these
  * structures, which both passes control information and captures
- * current execution status.  The descriptors for the running 
- * threads are kept in a linked list.
+ * current execution status.  The descriptors for the threads are
+ * kept in a linked list (in the order they were defined).
  *<P>
- * Note that no serialization is required.
- *      The list is only accessed by a single thread, and never
- *	from a signal handler.
+ * Threads are not destroyed when the number of threads is reduced.
+ * Rather, a disabled thread parks (at the next convenient point)
+ * until it is re-enabled, and then picks up where it left off.
+ * Thus a thread that is turned back on continues to work on the
+ * same directory it was working on before it was turned off.
+ *<P>
+ * Note that very little serialization is required.
+ *      The list is only accessed by the managing thread, and never
+ *	from a signal handler.  The only things a worker thread shares
+ *	with the manager are its enable flag (protected by its own lock
+ *	when it parks or is unparked) and its exit notification.
+ *<P>
+ * With worker processes (see workerprocs.h), the descriptors (and
+ * the exit notifications) are in memory shared with the processes,
+ * and their locks work across processes, so the manager treats the
+ * threads of the worker processes exactly as it would its own.
  */
 class ThreadStatus {
    public:
 	// identification/configuraiton information
 	char 	*name;		///< display name of this thread
 	void	*parms;		///< control parameters for this thread
+	const char *target;	///< target it works on (for breakdowns)
 
 	// enable/status information
-	bool	enable;		///< enable/shut-down indication
-	bool	started;	///< this thread has been started
-	bool	running;	///< running/terminated indication
+	std::atomic<bool> enable;	///< enable/shut-down indication
+	bool	started;		///< this thread has been started
+	std::atomic<bool> running;	///< running/terminated indication
+	std::atomic<bool> parked;	///< waiting to be re-enabled
 	int	exit_status;	///< exit status after termination
 	perfstats stats;	///< how much data has been transferred
 
 	pthread_t thread;	///< ID of this thread (if running)
 
 	/**
-	 * allocate and initialize a new threadStatus 
+	 * allocate and initialize a new threadStatus
 	 */
 	ThreadStatus( char *threadName, void *threadParms );
 
@@ -36,30 +52,107 @@ class ThreadStatus {
 	 */
 	~ThreadStatus();
 
+	/**
+	 * descriptors are allocated in shared memory when there are
+	 * worker processes
+	 */
+	static void *operator new( size_t size );
+	static void operator delete( void *p );
+
 	/**
 	 *  after that caller has created a list of ThreadStatus objects
-	 *  (big enough to handle any order), this manager is called to
-	 *  keep the right number running and generate reports.
+	 *  (big enough to handle any order, unless it also supplies a
+	 *  routine to define more of them as they are wanted), this
+	 *  manager is called to keep the right number running and
+	 *  generate reports.
+	 *
+	 * @param	routine each thread runs
+	 * @param	number of threads to start with
+	 * @param	stack size for each thread
+	 * @param	routine to define (the descriptor for) thread n,
+	 *		when more threads are wanted than have been
+	 *		defined (NULL if the defined threads are all we
+	 *		may have), which returns false if it cannot
 	 *
 	 * @return exit status (or of status bits)
 	 */
-	static int manageThreads( void *(*routine)(void *), int initThreads = 1, int stacksize = (64*1024) );
+	static int manageThreads( void *(*routine)(void *), int initThreads = 1, int stacksize = (64*1024),
+				bool (*define)( int n ) = 0 );
+
+	/**
+	 * called by a worker thread after each I/O to find out whether
+	 * or not it should continue.  If it has been disabled, it parks
+	 * here until it is re-enabled (or we shut down), and then simply
+	 * carries on with its next operation.
+	 *
+	 * @return	true if the thread should continue
+	 */
+	bool keepRunning() {
+		if (enable && !loadgen_shutdown)
+			return true;
+		return park();
+	}
+
+	/**
+	 * called by a worker thread (as the very last thing it does)
+	 * to report its exit status to the manager
+	 *
+	 * @param	exit status of the thread
+	 */
+	void exiting( int status );
 
    private:
-	/** 
+	/**
+	 * wait to be re-enabled
+	 *
+	 * @return	true if we have been re-enabled
+	 */
+	bool park();
+
+	/**
+	 * wake up a parked (or parking) thread
+	 *
+	 * @param	re-enable it (rather than wake it to shut down)
+	 */
+	void unpark( bool reenable );
+
+	/**
+	 * wait (up to a specified time) for all the threads we have
+	 * started to exit
+	 *
+	 * @param	(CLOCK_MONOTONIC) time to give up (NULL for no limit)
+	 */
+	static void awaitExits( const struct timespec *deadline );
+
+	/**
+	 * (in a worker process) start the threads it owns, as the
+	 * manager asks for them, until the manager is done with it
+	 *
+	 * @param	number of the worker process
+	 */
+	static void serveProcess( int proc );
+
+	/**
 	 * descriptor list traversal
 	 *
 	 * @return	descriptor for the first thread
 	 */
 	static ThreadStatus *first() { return listHead; }
 
-	/** 
+	/**
 	 * descriptor list traversal
 	 *
 	 * @return	descriptor for the next thread in the list;
 	 */
 	ThreadStatus *next() { return _next; }
-	
+
 	ThreadStatus *_next;		///< next descriptor in list
 	static ThreadStatus *listHead;	///< head of list of descriptors
+	static ThreadStatus *listTail;	///< tail of list of descriptors
+
+	pthread_mutex_t _lock;		///< protects enable while parked
+	pthread_cond_t _wakeup;		///< signalled when we are re-enabled
+
+	ThreadStatus *_nextExit;	///< next thread in the exited list
+	static struct exitList *exits;	///< threads that have exited
 };
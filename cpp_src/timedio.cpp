@@ -50,14 +50,15 @@ int timed_write( int fd, char *buf, int len, perfstats *s, const char *name, lon
 
 	// figure out how long it took
 	hires_time_t elapsed = hires_time() - start;
-	s->xfer_done( len, elapsed );
+	s->xfer_done( len, elapsed, true );
 	if (loadgen_debug & D_WRITES) {
 		fprintf(stderr, "# Write %d bytes to %s(%llu)\n", len,  name, offset );
 	}
 
 	// see if we need to stall before the next operation
-	if (loadgen_rate > 0) {
-		hires_time_t expected_us = (1000000ULL *  (hires_time_t) len) / (hires_time_t) loadgen_rate;
+	long long rate = loadgen_rate;	// (which a profile may change)
+	if (rate > 0) {
+		hires_time_t expected_us = (1000000ULL *  (hires_time_t) len) / (hires_time_t) rate;
 		if (expected_us > elapsed) {
 			hires_time_t needed_us = expected_us - elapsed;
 			if (loadgen_debug & D_SLEEP) {
@@ -101,11 +102,12 @@ int timed_read( int fd, char *buf, int len, perfstats *s, const char *name )
 
 	// figure out how long it took
 	hires_time_t elapsed = hires_time() - start;
-	s->xfer_done( ret, elapsed );
+	s->xfer_done( ret, elapsed, false );
 
 	// see if we need to stall before the next operation
-	if (loadgen_rate > 0) {
-		hires_time_t expected_us = (1000000ULL *  (hires_time_t) len) / (hires_time_t) loadgen_rate;
+	long long rate = loadgen_rate;	// (which a profile may change)
+	if (rate > 0) {
+		hires_time_t expected_us = (1000000ULL *  (hires_time_t) len) / (hires_time_t) rate;
 		if (expected_us > elapsed) {
 			hires_time_t needed_us = expected_us - elapsed;
 			if (loadgen_debug & D_SLEEP) {
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <malloc.h>
 #include <unistd.h>
+#include <sched.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -15,6 +16,9 @@
 #include "threadstatus.h"
 #include "pattern.h"
 #include "bufset.h"
+#include "genmap.h"
+#include "workqueue.h"
+#include "workerprocs.h"
 #include "debug.h"
 
 	
@@ -37,6 +41,20 @@ struct readParms {
 	int 		block_size;
 	long long	file_length;
 	long long	bytes_to_read;
+	int		format;			// format of the current file
+	GenMap *	genmap;			// block generations (if tracked)
+	bool		interrupted;		// shut down before the file was finished
+
+	// a single file or device can be split among several workers
+	int		part;			// which part this worker reads
+	int		parts;			// number of parts (1 if not split)
+	int *		remaining;		// parts not yet successfully read
+
+	// the files in directories are handed out by a work queue
+	WorkQueue *	queue;			// queue shared by all workers
+	int		worker;			// this worker's queue
+
+	ThreadStatus *	thread;			// worker doing these reads
 
 	/**
 	 * allocate and initialize a read operation descriptor.
@@ -56,10 +74,18 @@ struct readParms {
 		aio_depth = 0;
 		bytes_to_read = 0LL;
 		file_length = 0LL;
+		format = 1;
+		genmap = 0;
+		interrupted = false;
+		part = 0;
+		parts = 1;
+		remaining = 0;
+		queue = 0;
+		worker = 0;
 
 		// allocate the thread status structure for it
 		// 	and add it to the known threads list
-		new ThreadStatus( name, this );
+		thread = new ThreadStatus( name, this );
 
 		// FIX - on exit from_directory, to_directory and name should free
 	}
@@ -87,20 +113,6 @@ static int isDir( const struct dirent *dp )
 	return S_ISDIR( statb.st_mode );
 }
 
-/*
- * scandir filter function to select only non-hidden files
- *
- * @param dp	dirent to be validated
- *
- * @return	true if it is a non-hidden file
- */
-static int isFile( const struct dirent *dp ) {
-
-	// make sure name doesn't begin with a dot
-	const char *s = dp->d_name;
-	return( *s != '.' );
-}
-
 /**
  * Data reader
  * -	spawn off threads to read/verify every file in every directory
@@ -145,6 +157,9 @@ readData_d( const char *from, char *to, int threads ) {
 	if (threads > 0 && num_subdirs > threads && loadgen_once)
 		num_subdirs = threads;
 
+	// each thread starts out with the files in its own directory
+	WorkQueue *queue = new WorkQueue( num_subdirs, loadgen_steal );
+
 	// create a thread for each 
 	for( int i = 0; i < num_subdirs; i++ ) {
 		// come up with a name for this thread
@@ -168,8 +183,19 @@ readData_d( const char *from, char *to, int threads ) {
 			return RESOURCE_ERROR;
 		}
 		parms->bytes_to_read = loadgen_data;
-		parms->aio_depth = (loadgen_depth > 1) ? loadgen_depth : 1;
+		parms->aio_depth = (loadgen_depth > 1) ? loadgen_depth.load() : 1;
 		parms->file_length = loadgen_fsize;
+		parms->thread->target = to;
+
+		// queue up its files
+		parms->queue = queue;
+		parms->worker = i;
+		if (queue->addDir( i, cpy, src ) < 0) {
+			fprintf(stderr, "FATAL: unable to read directory %s: %s\n",
+				cpy, strerror( errno ) );
+			loadgen_problem = "target directory access";
+			return TARGET_DIRECTORY;
+		}
 
 		// and free up the dirent
 		free( results[i] );
@@ -182,6 +208,7 @@ readData_d( const char *from, char *to, int threads ) {
 	
 	// we just configure them, the thread manager does the real work
 	int ret =  ThreadStatus::manageThreads( from ? compareThread : readThread, threads );
+	delete queue;
 	
 	return ret;
 }
@@ -197,19 +224,29 @@ readData_d( const char *from, char *to, int threads ) {
 int 
 readData_l( char **list ) {
 
+	// each specified directory has its own queue of files
+	int entries = 0;
+	while( list[entries] != 0 )
+		entries++;
+	WorkQueue *queue = new WorkQueue( entries, loadgen_steal );
+
 	// create a work thread for each specified directory
+	//	(or several, for a file or device that is to be split)
 	int threads = 0;
 	for( int i = 0; list[i] != 0; i++ ) {
 		bool single_file;
+		long long length = loadgen_fsize;
 	
 		// if there is an offset, note it and null it out
 		long long offset = getOffset(list[i]);
 
 		// make sure the assigned working directory exists 
 		if (checkdev(list[i])) {
-			// TODO: add automatic size determination
-			if (loadgen_fsize == 0) {
-				fprintf(stderr, "FATAL: device %s requires length specified\n",
+			// if we weren't told how much to read, ask the device
+			if (length == 0)
+				length = devsize( list[i] ) - offset;
+			if (length <= 0) {
+				fprintf(stderr, "FATAL: unable to determine size of device %s\n",
 					list[i] );
 				loadgen_problem = "target device w/o length";
 				return TARGET_DIRECTORY;
@@ -226,36 +263,80 @@ readData_l( char **list ) {
 				return TARGET_DIRECTORY;
 			} 
 			single_file = false;
+			if (queue->addDir( i, list[i], 0 ) < 0) {
+				fprintf(stderr, "FATAL: unable to read directory %s: %s\n",
+					list[i], strerror( errno ) );
+				loadgen_problem = "target directory access";
+				return TARGET_DIRECTORY;
+			}
 		}
 		
-		// come up with a name for this thread
-		char *threadname = 0;
-		asprintf( &threadname, "Verifier Thread %04d", i );
-	
-		// allocate and initialize a parameter structure
-		struct readParms *parms = new readParms( threadname, loadgen_bsize, 0, list[i] );
-		if (threadname == 0 || parms == 0) {
-			fprintf(stderr, "FATAL: malloc failure\n");
-			loadgen_problem = "malloc failure";
-			return RESOURCE_ERROR;
+		// the parts of a split file share a count of unfinished parts
+		//	(which worker processes must all see)
+		int parts = single_file ? loadgen_split : 1;
+		int *remaining = 0;
+		if (parts > 1) {
+			remaining = (int *) procsShared( sizeof (int) );
+			if (remaining == 0)
+				remaining = new int;
+			*remaining = parts;
 		}
 
-		// plug in a few additional parameters
-		parms->bytes_to_read = loadgen_data;
-		parms->aio_depth = (loadgen_depth > 1) ? loadgen_depth : 1;
-		parms->file_length = loadgen_fsize;
-		parms->offset = offset;
-		parms->one_file = single_file;
+		for( int part = 0; part < parts; part++ ) {
+			// come up with a name for this thread
+			char *threadname = 0;
+			asprintf( &threadname, "Verifier Thread %04d", threads );
+		
+			// allocate and initialize a parameter structure
+			struct readParms *parms = new readParms( threadname, loadgen_bsize, 0, list[i] );
+			if (threadname == 0 || parms == 0) {
+				fprintf(stderr, "FATAL: malloc failure\n");
+				loadgen_problem = "malloc failure";
+				return RESOURCE_ERROR;
+			}
 
-		threads++;
+			// plug in a few additional parameters
+			parms->bytes_to_read = loadgen_data;
+			parms->aio_depth = (loadgen_depth > 1) ? loadgen_depth.load() : 1;
+			parms->file_length = length;
+			parms->offset = offset;
+			parms->one_file = single_file;
+			parms->part = part;
+			parms->parts = parts;
+			parms->remaining = remaining;
+			parms->queue = single_file ? 0 : queue;
+			parms->worker = i;
+			parms->thread->target = list[i];
+
+			threads++;
+		}
 	}
 
 	// we just configure them, the thread manager does the real work
 	int ret =  ThreadStatus::manageThreads( readThread, threads );
+	delete queue;
 	
 	return ret;
 }
 
+/**
+ * remove a directory whose files have all been verified (and deleted)
+ *
+ * @param path	directory to be removed
+ *
+ * @return	status bits
+ */
+static int removeDir( const char *path ) {
+	if (rmdir( path ) != 0) {
+		fprintf(stderr, "Unable to remove directory %s: %s\n", path, strerror( errno ) );
+		loadgen_problem = "directory deletion error";
+		return INPUT_FILE_ERROR;
+	}
+	if (loadgen_debug & D_FILES)
+		fprintf(stderr, "# Remove directory %s ... OK\n", path );
+	return 0;
+}
+
 /**
  * this is the routine that each load generation thread runs 
  *	to verify pattern data.
@@ -264,9 +345,9 @@ readData_l( char **list ) {
  */
 void *readThread( void *sts ) {
 	int status = 0;		// this thread's exit status
-	int count = 0;		// number of directory entries to process
+	int count = 0;		// number of files originally queued for us
 	int done = 0;		// number of files actually processed
-	struct dirent **results = 0;	// returned directory entries
+	bool finished = false;	// we have run out of work
 	Bufset *bufset = 0;
 
 	// pick up ponter to my status structure
@@ -281,7 +362,8 @@ void *readThread( void *sts ) {
 	// announce that we are starting up
 	mystatus->running = true;	// now set in manageThreads to avoid a race
 	if (loadgen_debug & D_THREADS) {
-		fprintf(stderr, "# Starting %s in %s\n", mystatus->name, myparms.to_directory );
+		fprintf(stderr, "# Starting %s in %s on cpu %d\n", mystatus->name,
+			myparms.to_directory, sched_getcpu() );
 	}
 
 	// make sure our target directory exists
@@ -311,7 +393,13 @@ void *readThread( void *sts ) {
 	if (myparms.one_file) {
 		count = 0;
 		status = readFile( myparms.to_directory, bufset, &myparms, &mystatus->stats );
-		if (status == 0 && loadgen_delete) {
+
+		// a split file can only be deleted once every part is read
+		bool complete = status == 0 && !myparms.interrupted;
+		bool last = myparms.remaining == 0 ||
+			    (complete && __sync_sub_and_fetch( myparms.remaining, 1 ) == 0);
+		if (complete && loadgen_delete && last) {
+			GenMap::remove( myparms.to_directory );
 			if (unlink( myparms.to_directory ) != 0) {
 				fprintf(stderr,
 					"Unable to delete file %s: %s\n",
@@ -324,21 +412,36 @@ void *readThread( void *sts ) {
 			}
 		}
 	} else 
-		count = scandir(  myparms.to_directory, &results, isFile, alphasort );
+		count = myparms.queue->queued( myparms.worker );
 
-	for( done = 0; done < count && status == 0 && mystatus->enable; done++ ) {
-		if (loadgen_shutdown)
+	// verify each queued file until there are no more
+	//	(or we are told to stop)
+	finished = myparms.one_file;
+	while( !finished && status == 0 ) {
+		if (!mystatus->keepRunning())
 			break;
 		
 		// get the next file to verify
+		WorkItem *w = myparms.queue->get( myparms.worker );
+		if (w == 0) {
+			finished = true;
+			break;
+		}
 		char *path;
-		asprintf( &path, "%s/%s", myparms.to_directory, results[done]->d_name );
+		asprintf( &path, "%s/%s", w->dir->path, w->name );
 		
 		// read (and verify) this file
-		status = readFile( path, bufset, &myparms, &mystatus->stats );
-		if (status == 0) {
+		//	(sizes learned from one file don't carry over to the next)
+		struct readParms fileparms = myparms;
+		status = readFile( path, bufset, &fileparms, &mystatus->stats );
+		if (status == 0 && fileparms.interrupted) {
+			// a file we didn't finish is neither counted nor deleted
+			free( path );
+			break;
+		} else if (status == 0) {
 			mystatus->stats.file_done();
 			if (loadgen_delete) {
+				GenMap::remove( path );
 				if (unlink( path ) != 0) {
 					fprintf(stderr,
 						"Unable to delete file %s: %s\n",
@@ -353,40 +456,34 @@ void *readThread( void *sts ) {
 			fprintf(stderr, "# %s of %s completed w/status=%d\n",
 				loadgen_verify ? "verify" : "read", path, status);
 		}
+		done++;
+
+		// whoever finishes the last file in a directory removes it
+		if (myparms.queue->done( w, status == 0 ) && loadgen_delete)
+			status |= removeDir( w->dir->path );
 		
 		// free the stuff we allocated for this file
 		free( path );
 		path = 0;
-		free( results[done] );
-		results[done] = 0;
 	}
 
+	// directories with no files never get finished, so we remove our own
+	if (finished && status == 0 && loadgen_delete && myparms.queue)
+		while( WorkDir *d = myparms.queue->empty( myparms.worker ))
+			status |= removeDir( d->path );
+
   	// free stuff we allocated
 	delete bufset;
-	if (results)
-		free( results );
-	
-	if (status == 0 && loadgen_delete && !myparms.one_file) {
-		if (rmdir( myparms.to_directory ) != 0) {
-			fprintf(stderr,
-				"Unable to remove directory %s: %s\n",
-				myparms.to_directory, strerror( errno ) );
-			status |= INPUT_FILE_ERROR;
-			loadgen_problem = "directory deletion error";
-		} else if (loadgen_debug & D_FILES) {
-			fprintf(stderr, "# Remove directory %s ... OK\n", myparms.to_directory );
-		}
-	}
 
   exit:	
-	// update my exit status and exit
-	mystatus->running = false;
-	mystatus->exit_status = status;
-	if (loadgen_debug & D_THREADS || done != count) {
+	if (loadgen_debug & D_THREADS || !finished) {
 		fprintf(stderr, "# Shutting down %s (en=%d, cnt=%d/%d sts=%x, stop=%d)\n",
-			mystatus->name, mystatus->enable,
-			done, count, status, loadgen_shutdown );
+			mystatus->name, mystatus->enable.load(),
+			done, count, status, loadgen_shutdown.load() );
 	}
+
+	// report my exit status and exit
+	mystatus->exiting( status );
 	pthread_exit(0);
 }
 
@@ -413,11 +510,11 @@ int readFile( const char *filename, Bufset *bufs, struct readParms *parms, perfs
 		return INPUT_FILE_ERROR;
 	} 
 
-	// read in the first block
+	// read in the first block (which may not be at the start of a device)
 	long firstblk = loadgen_direct ? loadgen_direct : header_size();
 
 	char *inbuf = bufs->buffer(0);
-	if (read( fd, inbuf, firstblk ) != firstblk) {
+	if (pread( fd, inbuf, firstblk, parms->offset ) != firstblk) {
 		fprintf(stderr, "Header read error on input file %s: %s\n", 
 			filename, strerror( errno ));
 		loadgen_problem = "file read error";
@@ -427,7 +524,7 @@ int readFile( const char *filename, Bufset *bufs, struct readParms *parms, perfs
 
 	// check the headers and extract size information
 	if (loadgen_verify || parms->block_size == 0 || parms->file_length == 0) {
-		const char *err = checkHeaders( inbuf, parms->block_size, 0ULL );
+		const char *err = checkHeaders( inbuf, parms->block_size, parms->offset );
 		if (err) {
 			fprintf(stderr, 
 				"Header verification error on input file %s: %s\n",
@@ -448,6 +545,7 @@ int readFile( const char *filename, Bufset *bufs, struct readParms *parms, perfs
 	}
 	if (parms->bytes_to_read == 0)
 		parms->bytes_to_read = parms->file_length;
+	parms->format = get_format( inbuf );
 
 	// make sure we have a reasonable block size
 	if (parms->block_size == 0 || parms->block_size > max_bsize() || parms->block_size > bufs->size) {
@@ -474,12 +572,28 @@ int readFile( const char *filename, Bufset *bufs, struct readParms *parms, perfs
 
 
 	if (loadgen_debug & D_FILES) {
-		fprintf(stderr, "# %sing file %s, using bsize=%d\n", 
-			loadgen_verify ? "verify" : "read", filename, parms->block_size );
+		char part[40] = "";
+		if (parms->parts > 1)
+			snprintf( part, sizeof part, ", part %d of %d", parms->part + 1, parms->parts );
+		fprintf(stderr, "# %sing file %s, using bsize=%d%s\n", 
+			loadgen_verify ? "verify" : "read", filename, parms->block_size, part );
+	}
+
+	// if we know what generation each block should be, check that too
+	if (loadgen_verify && parms->format == 2) {
+		parms->genmap = GenMap::load( filename );
+		if (parms->genmap && parms->genmap->bsize != parms->block_size) {
+			delete parms->genmap;
+			parms->genmap = 0;
+		}
 	}
 
 	int status = singleRead(filename, bufs, parms, fd, stats);
 	close( fd );
+	if (parms->genmap) {
+		delete parms->genmap;
+		parms->genmap = 0;
+	}
 	return status;
 }
 
@@ -493,8 +607,9 @@ void *compareThread( void *sts ) {
 	int status = 0;		// this thread's exit status
 	char *data1 = 0;	// the orginal data
 	char *data2 = 0;	// the copy data
-	int count = 0;		// number of directory entries to process
-	int done = 0;		// number of directory entries processed
+	int count = 0;		// number of files originally queued for us
+	int done = 0;		// number of files processed
+	bool finished = false;	// we have run out of work
 
 	// pick up ponter to my status structure
 	struct ThreadStatus *mystatus = (struct ThreadStatus *) sts;
@@ -505,9 +620,10 @@ void *compareThread( void *sts ) {
 		bsize = max_bsize();
 
 	// announce that we are starting up
-	mystatus->running = true;
+	mystatus->running = true;	// now set in manageThreads to avoid a race
 	if (loadgen_debug & D_THREADS) {
-		fprintf(stderr, "# Starting %s in %s\n", mystatus->name, myparms->to_directory );
+		fprintf(stderr, "# Starting %s in %s on cpu %d\n", mystatus->name,
+			myparms->to_directory, sched_getcpu() );
 	}
 
 	// make sure our target directory exists
@@ -542,17 +658,23 @@ void *compareThread( void *sts ) {
 		goto exit;
 	}
 
-	// find and verify each file in this directory
-	struct dirent **results;
-	count = scandir(  myparms->to_directory, &results, isFile, alphasort );
-	for( done = 0; done < count && status == 0 && mystatus->enable; done++ ) {
-		if (loadgen_shutdown)
+	// compare each queued file until there are no more
+	//	(or we are told to stop)
+	count = myparms->queue->queued( myparms->worker );
+	while( status == 0 ) {
+		if (!mystatus->keepRunning())
 			break;
 		
+		// get the next file to compare
+		WorkItem *w = myparms->queue->get( myparms->worker );
+		if (w == 0) {
+			finished = true;
+			break;
+		}
 
 		// open the original file
 		char *from_path;
-		asprintf( &from_path, "%s/%s", myparms->from_directory, results[done]->d_name );
+		asprintf( &from_path, "%s/%s", w->dir->peer, w->name );
 		int opts = loadgen_direct ? O_DIRECT : 0;
 		int fd_from = open( from_path, opts );
 		if (fd_from < 0) {
@@ -565,7 +687,7 @@ void *compareThread( void *sts ) {
 
 		// open the copy file
 		char *to_path;
-		asprintf( &to_path, "%s/%s", myparms->to_directory, results[done]->d_name );
+		asprintf( &to_path, "%s/%s", w->dir->path, w->name );
 		int fd_to = open( to_path, opts );
 		if (fd_to < 0) {
 			fprintf(stderr, "Unable to open copy file %s: %s\n", 
@@ -585,12 +707,19 @@ void *compareThread( void *sts ) {
 
 		if (loadgen_debug & D_FILES) {
 			fprintf(stderr, "# compare file %s in %s to %s, bsize=%ld\n",
-				results[done]->d_name, myparms->from_directory,
-				myparms->to_directory, bsize);
+				w->name, w->dir->peer, w->dir->path, bsize);
 		}
 
 		// verify the file contents
+		bool interrupted = false;
 		while( status == 0 ) {
+			// if we have been parked, we resume right here,
+			//	but a shutdown abandons the rest of the file
+			if (!mystatus->keepRunning()) {
+				interrupted = true;
+				break;
+			}
+
 			// read and verify another block
 			int bytes = read( fd_from, data1, bsize );
 			if (bytes == 0)
@@ -632,7 +761,12 @@ void *compareThread( void *sts ) {
 		close( fd_to );
 		close( fd_from );
 
-		if (status == 0) {
+		if (status == 0 && interrupted) {
+			// a file we didn't finish is neither counted nor deleted
+			free( to_path );
+			free( from_path );
+			break;
+		} else if (status == 0) {
 			mystatus->stats.file_done();
 			if (loadgen_delete) {
 				if (unlink( to_path ) != 0) {
@@ -646,48 +780,61 @@ void *compareThread( void *sts ) {
 				}
 			}
 		}
+		done++;
+
+		// whoever finishes the last file in a directory removes it
+		if (myparms->queue->done( w, status == 0 ) && loadgen_delete)
+			status |= removeDir( w->dir->path );
 		
 		// free the stuff we allocated for this file
 		free( to_path );
 		to_path = 0;
 		free( from_path );
 		from_path = 0;
-		free( results[done] );
-		results[done] = 0;
 	}
 
+	// directories with no files never get finished, so we remove our own
+	if (finished && status == 0 && loadgen_delete)
+		while( WorkDir *d = myparms->queue->empty( myparms->worker ))
+			status |= removeDir( d->path );
+
   	// free stuff we allocated
 	if (data1)
 		free( data1 );
 	if (data2)
 		free( data2 );
-	if (results)
-		free( results );
-	
-	if (status == 0 && loadgen_delete) {
-		if (rmdir( myparms->to_directory ) != 0) {
-			fprintf(stderr,
-				"Unable to remove directory %s: %s\n",
-				myparms->to_directory, strerror( errno ) );
-			status |= INPUT_FILE_ERROR;
-			loadgen_problem = "directory deletion error";
-		} else if (loadgen_debug & D_FILES) {
-			fprintf(stderr, "# Remove directory %s ... OK\n", myparms->to_directory );
-		}
-	}
 
   exit:	
-	// update my exit status and exit
-	mystatus->running = false;
-	mystatus->exit_status = status;
-	if (loadgen_debug & D_THREADS || done != count) {
+	if (loadgen_debug & D_THREADS || !finished) {
 		fprintf(stderr, "# Shutting down %s (en=%d, cnt=%d/%d sts=%x, stop=%d)\n",
-			mystatus->name, mystatus->enable,
-			done, count, status, loadgen_shutdown );
+			mystatus->name, mystatus->enable.load(),
+			done, count, status, loadgen_shutdown.load() );
 	}
+
+	// report my exit status and exit
+	mystatus->exiting( status );
 	pthread_exit(0);
 }
 
+/*
+ * is a block of a file one that the file system says was never written
+ *	(so that SEEK_DATA finds no data in it), without moving the
+ *	file offset
+ *
+ * @param	open file descriptor
+ * @param	offset of the block
+ * @param	length of the block
+ *
+ * @return	true if it is a hole (false if the file system cannot say)
+ */
+static bool sparse( int fd, long long offset, int len ) {
+	off_t here = lseek( fd, 0, SEEK_CUR );
+	off_t data = lseek( fd, offset, SEEK_DATA );
+	bool hole = (data < 0) ? errno == ENXIO : data >= offset + len;
+	lseek( fd, here, SEEK_SET );
+	return hole;
+}
+
 /*
  * synchronous reads
  *
@@ -708,13 +855,50 @@ int singleRead(const char *filename,
 	char *inbuf = bufs->buffer(0);
 	long long max_block = parms->file_length/parms->block_size;
 
-	long long offset = parms->offset;
+	// a file that is split among several workers is read in
+	//	contiguous ranges of blocks, or interleaved blocks
+	long long first = 0;		// first block this worker reads
+	long long stride = 1;		// blocks between successive reads
+	long long quota = parms->bytes_to_read;
+	if (parms->parts > 1) {
+		long long bs = parms->block_size;
+		long long blocks = (parms->bytes_to_read + bs - 1) / bs;
+		long long count;
+		if (loadgen_interleave) {
+			first = parms->part;
+			stride = parms->parts;
+			count = (blocks > first) ? (blocks - first + stride - 1) / stride : 0;
+		} else {
+			long long per = (blocks + parms->parts - 1) / parms->parts;
+			first = parms->part * per;
+			count = (blocks > first) ? blocks - first : 0;
+			if (count > per)
+				count = per;
+		}
+
+		// only the very last block of the file can be short
+		quota = count * bs;
+		if (count > 0 && first + (count - 1) * stride == blocks - 1)
+			quota -= (blocks * bs) - parms->bytes_to_read;
+	}
+
+	long long offset = parms->offset + first * parms->block_size;
 	lseek( fd, offset, SEEK_SET );
 
 	long long bytes_read = 0;
-	while( status == 0 && bytes_read < parms->bytes_to_read ) {
+	while( status == 0 && bytes_read < quota ) {
+		// if we have been parked, we resume right here (at the same
+		//	offset), but a shutdown abandons the rest of the file
+		if (!parms->thread->keepRunning()) {
+			parms->interrupted = true;
+			break;
+		}
+
 		// figure out how much to read
-		int bytes = (loadgen_rand_blk == 0) ? parms->block_size : loadgen_rand_blk;
+		//	(version 2 blocks are self describing, and so
+		//	 can be verified whole, in any order)
+		int bytes = (loadgen_rand_blk == 0 || parms->format == 2) ? 
+				parms->block_size : loadgen_rand_blk.load();
 
 		bytes = timed_read( fd, inbuf, bytes, stats, filename );
 		if (bytes <= 0) {
@@ -722,8 +906,18 @@ int singleRead(const char *filename,
 			break;
 		}
 
+		// random writes may have left holes that were never written
+		//	(but a block of zeroes is only a hole if the generation
+		//	 map, or without one the file system, says that nothing
+		//	 was ever written there)
+		unsigned long want = parms->genmap ? 
+			parms->genmap->expected( (offset - parms->offset) / parms->block_size ) : 0;
+		bool hole = loadgen_verify && parms->format == 2 && unwritten( inbuf, bytes ) && 
+				(parms->genmap ? want == 0 : sparse( fd, offset, bytes ));
+
 		// headers are verified against the actual block size
-		const char *err = loadgen_verify ? checkHeaders( inbuf, parms->block_size, offset ) : 0;
+		const char *err = (loadgen_verify && !hole) ? 
+				checkHeaders( inbuf, parms->block_size, offset ) : 0;
 		if (err) {
 			fprintf(stderr, 
 				"Header verification error on input file %s at offset %llu: %s\n",
@@ -733,8 +927,21 @@ int singleRead(const char *filename,
 			break;
 		}
 
+		// blocks must be from the generation we last wrote there
+		//	(an older one means that a write was lost)
+		unsigned long got = hole ? 0 : get_generation( inbuf );
+		if (want != 0 && got != want) {
+			fprintf(stderr,
+				"Generation error on input file %s at offset %llu: found %lu, expected %lu (%s)\n",
+				filename, offset, got, want, 
+				got < want ? "stale data" : "newer than last write" );
+			status |= INPUT_FILE_ERROR;
+			loadgen_problem = "stale data error";
+			break;
+		}
+
 		// data is verified against the re-read block size
-		err = loadgen_verify ? checkData( inbuf, bytes ) : 0;
+		err = (loadgen_verify && !hole) ? checkData( inbuf, bytes ) : 0;
 		if (err) {
 			fprintf(stderr, 
 				"Data verification error on input file %s at offset %llu: %s\n",
@@ -743,9 +950,9 @@ int singleRead(const char *filename,
 			loadgen_problem = "data verification error";
 			break;
 		} else if (loadgen_debug & D_VERIFY) {
-			fprintf(stderr, "# %s CONTENTS(%d) for %s(%llu) ... OK\n", 
+			fprintf(stderr, "# %s CONTENTS(%d) for %s(%llu) ... %s\n", 
 				loadgen_verify ? "Verify" : "Read",
-				bytes, filename, offset );
+				bytes, filename, offset, hole ? "UNWRITTEN" : "OK" );
 		} 
 
 		// note that we have knocked off some of our quota
@@ -755,6 +962,9 @@ int singleRead(const char *filename,
 		if (loadgen_rand_blk) {
 			offset = parms->offset + choose_block( max_block) * parms->block_size;
 			lseek( fd, offset, SEEK_SET );
+		} else if (stride > 1) {
+			offset += stride * parms->block_size;
+			lseek( fd, offset, SEEK_SET );
 		} else
 			offset += bytes;
 	}
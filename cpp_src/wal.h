@@ -0,0 +1,70 @@
+/*
+ * write-ahead log (group commit) workload
+ *
+ *	Databases write their logs with small appends, each of which must
+ *	be durable before the transaction that wrote it can commit, and
+ *	they amortize the cost of making them durable by committing the
+ *	records of many transactions at once.  A WAL workload emulates
+ *	this: each (producer) thread repeatedly submits a small record
+ *	and waits for it to be committed, while one or more committer
+ *	threads gather the submitted records into groups, append each
+ *	group to a (shared) log file, and fdatasync it.  It is described
+ *	by a list of parameters, e.g.
+ *
+ *		record=512,group=64k,window=200us,committers=1
+ *
+ *	record		size of each record (default 512)
+ *	group		most bytes committed at once (default 1m)
+ *	window		how long a committer waits (after the oldest record
+ *			it has was submitted) for a group to fill up, in
+ *			us, ms or s (default 0: commit whatever is waiting)
+ *	committers	number of committer threads (default 1)
+ *
+ *	The log is TARGET/wal.log (or the target file or device itself),
+ *	which wraps around (like a circular log) after --length bytes.
+ *	Producers are the threads that the thread manager starts, parks
+ *	and counts, and they are throttled by --rate (and stop after
+ *	--data bytes, if there is a limit).  The latencies in their
+ *	reports are commit latencies (from submission to durability),
+ *	and each report is followed by a DETAIL wal line with the commits
+ *	per second, commit latency percentiles, the number and average
+ *	size of the groups, and the latencies of their fdatasyncs.
+ */
+
+// most committer threads
+#define	MAX_COMMITTERS	16
+
+class perfstats;
+
+/**
+ * parse a WAL workload description
+ *
+ * @param	comma separated list of parameter=value
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *setWal( const char *spec );
+
+/**
+ * is this a WAL workload
+ *
+ * @return	true if it is
+ */
+bool walActive();
+
+/**
+ * report on the commits of the most recent interval
+ *
+ * @param	length of the interval (in microseconds)
+ * @param	producer statistics for the interval
+ */
+void walInterval( long microseconds, perfstats *delta );
+
+/**
+ * run a WAL workload
+ *
+ * @param	directory, file or device for the log
+ * @param	number of initial producer threads
+ *		(if this is zero, don't start yet)
+ * @return	exit status (worst exit status from any thread)
+ */
+int walData( char *to, int threads );
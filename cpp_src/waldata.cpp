@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "loadgen.h"
+#include "threadstatus.h"
+#include "pattern.h"
+#include "report.h"
+#include "wal.h"
+#include "debug.h"
+
+void *walProducer( void * );
+
+// size of the log (if no --length is specified)
+#define	DEFAULT_WAL_LENGTH	(64LL * 1024 * 1024)
+
+static bool active = false;		// this is a WAL workload
+static int recordSize = 512;		// bytes in each record
+static long long groupSize = 1024 * 1024;	// most bytes committed at once
+static long windowUs = 0;		// how long to wait for a group to fill
+static int numCommitters = 1;		// committer threads
+
+/**
+ * a record that has been submitted, and is waiting to be committed
+ */
+struct walRecord {
+	const char *	data;			// its contents
+	int		len;			// its length
+	hires_time_t	submitted;		// when it was submitted
+	bool		durable;		// it has been committed
+	struct walRecord *next;			// next record in the queue
+};
+
+/*
+ * the log, and the records waiting to be committed to it
+ */
+static pthread_mutex_t walLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t walWork = PTHREAD_COND_INITIALIZER;	// records submitted
+static pthread_cond_t walDone = PTHREAD_COND_INITIALIZER;	// records committed
+static struct walRecord *head = 0;	// oldest waiting record
+static struct walRecord *tail = 0;	// newest waiting record
+static long long pending = 0;		// bytes waiting
+static bool stopping = false;		// committers should finish up
+static int failures = 0;		// status bits of failed commits
+
+static int logFd = -1;			// the log (-1 if simulated)
+static const char *logPath = 0;		// (its name)
+static long long logBase = 0;		// its offset (in the file or device)
+static long long logLength = 0;		// bytes before it wraps
+static long long logNext = 0;		// where the next group goes
+static int alignment = 1;		// groups are padded to this
+
+static char *groupBuf[MAX_COMMITTERS];	// each committer's group buffer
+static perfstats groupStats[MAX_COMMITTERS];	// each committer's groups
+static perfstats lastGroups;		// their sum at the last report
+
+/**
+ * parameters for a WAL producer thread
+ */
+struct walParms {
+	long long	bytes_to_write;		// stop after this much (if non-zero)
+	ThreadStatus *	thread;			// producer doing these commits
+
+	/**
+	 * allocate and initialize a producer descriptor
+	 *
+	 * @param name		name of this thread
+	 */
+	walParms( char *name ) {
+		bytes_to_write = loadgen_data;
+
+		// allocate the thread status structure for it
+		// 	and add it to the known threads list
+		thread = new ThreadStatus( name, this );
+	}
+};
+
+/*
+ * a window, in us, ms or s (the default)
+ *
+ * @return	microseconds (or -1 if it is not a valid time)
+ */
+static long windowSpec( const char *s ) {
+	char *suffix;
+	double n = strtod( s, &suffix );
+	if (suffix == s || n < 0)
+		return -1;
+	if (strcmp( suffix, "us" ) == 0)
+		return (long) n;
+	if (strcmp( suffix, "ms" ) == 0)
+		return (long) (n * 1000);
+	if (strcmp( suffix, "s" ) == 0 || *suffix == 0)
+		return (long) (n * 1000000);
+	return -1;
+}
+
+/*
+ * parse a WAL workload description
+ */
+const char *setWal( const char *spec ) {
+	char *copy = strdup( spec );
+	char *save = 0;
+	const char *err = 0;
+	for( char *s = strtok_r( copy, ",", &save ); s && err == 0; s = strtok_r( 0, ",", &save )) {
+		char *v = strchr( s, '=' );
+		if (v == 0 || v[1] == 0) {
+			err = "Malformed WAL workload";
+			break;
+		}
+		*v++ = 0;
+
+		if (strcmp( s, "record" ) == 0) {
+			long long n = getSizeSpec( v );
+			if (n <= 0 || n > max_bsize())
+				err = "Invalid WAL record size";
+			recordSize = (int) n;
+		} else if (strcmp( s, "group" ) == 0) {
+			groupSize = getSizeSpec( v );
+			if (groupSize <= 0 || groupSize > 1024LL * 1024 * 1024)
+				err = "Invalid WAL group size";
+		} else if (strcmp( s, "window" ) == 0) {
+			windowUs = windowSpec( v );
+			if (windowUs < 0)
+				err = "Invalid WAL window";
+		} else if (strcmp( s, "committers" ) == 0) {
+			numCommitters = atoi( v );
+			if (numCommitters < 1 || numCommitters > MAX_COMMITTERS)
+				err = "Invalid number of WAL committers";
+		} else
+			err = "Malformed WAL workload";
+	}
+	free( copy );
+
+	if (err == 0 && groupSize < recordSize)
+		err = "WAL groups must hold at least one record";
+	active = (err == 0);
+	return err;
+}
+
+/*
+ * is this a WAL workload
+ */
+bool walActive() {
+	return active;
+}
+
+/*
+ * report on the commits (and groups) of the most recent interval
+ */
+void walInterval( long microseconds, perfstats *delta ) {
+	perfstats groups;
+	for( int i = 0; i < numCommitters; i++ )
+		groups += groupStats[i];
+	perfstats d = groups;
+	d -= lastGroups;
+	lastGroups = groups;
+	walReport( microseconds, delta, &d );
+}
+
+/*
+ * (committer) gather the waiting records into groups, append them
+ *	to the log, and make them durable
+ *
+ * @param	our committer number
+ */
+static void *committer( void *arg ) {
+	int me = (int) (long) arg;
+	perfstats *stats = &groupStats[me];
+	char *buf = groupBuf[me];
+
+	pthread_mutex_lock( &walLock );
+	for(;;) {
+		while( head == 0 && !stopping )
+			pthread_cond_wait( &walWork, &walLock );
+		if (head == 0)
+			break;
+
+		// give the group a chance to fill up
+		if (windowUs > 0) {
+			hires_time_t until = head->submitted + windowUs;
+			struct timespec deadline;
+			deadline.tv_sec = until / 1000000;
+			deadline.tv_nsec = (until % 1000000) * 1000;
+			while( pending < groupSize && !stopping && head != 0 )
+				if (pthread_cond_timedwait( &walWork, &walLock, &deadline ) == ETIMEDOUT)
+					break;
+			if (head == 0)	// another committer took them
+				continue;
+		}
+
+		// take as many records as fit in a group
+		struct walRecord *group = head;
+		struct walRecord *last = 0;
+		long long bytes = 0;
+		int records = 0;
+		while( head != 0 && (bytes == 0 || bytes + head->len <= groupSize)) {
+			bytes += head->len;
+			records++;
+			last = head;
+			head = head->next;
+		}
+		last->next = 0;
+		if (head == 0)
+			tail = 0;
+		pending -= bytes;
+
+		// and reserve a place for them in the log
+		long long len = (bytes + alignment - 1) / alignment * alignment;
+		if (logNext + len > logLength)
+			logNext = 0;
+		long long offset = logBase + logNext;
+		logNext += len;
+		pthread_mutex_unlock( &walLock );
+
+		// append them, and make them durable
+		long long pos = 0;
+		for( struct walRecord *r = group; r != 0; r = r->next ) {
+			memcpy( &buf[pos], r->data, r->len );
+			pos += r->len;
+		}
+		int status = 0;
+		hires_time_t start = hires_time();
+		if (logFd >= 0 && pwrite( logFd, buf, len, offset ) != len) {
+			fprintf(stderr, "write error to file %s: %s\n", logPath, strerror( errno ));
+			loadgen_problem = "file write error";
+			status = OUTPUT_FILE_ERROR;
+		}
+		hires_time_t written = hires_time();
+		if (status == 0 && logFd >= 0 && fdatasync( logFd ) != 0) {
+			fprintf(stderr, "flush error on %s: %s\n", logPath, strerror( errno ));
+			loadgen_problem = "file flush error";
+			status = OUTPUT_FILE_ERROR;
+		}
+		if (status == 0) {
+			stats->xfer_done( len, written - start, true );
+			stats->flush_done( hires_time() - written );
+		}
+		if (loadgen_debug & D_WRITES)
+			fprintf(stderr, "# Commit %d records (%lld bytes) to %s(%lld)\n",
+				records, len, logPath, offset );
+
+		// and let their producers know
+		pthread_mutex_lock( &walLock );
+		failures |= status;
+		for( struct walRecord *r = group; r != 0; r = r->next )
+			r->durable = true;
+		pthread_cond_broadcast( &walDone );
+	}
+	pthread_mutex_unlock( &walLock );
+	return 0;
+}
+
+static char *walTarget = 0;		// what the producers are working on
+
+/**
+ * define a WAL producer (as they are wanted)
+ *
+ * @param i		number of the thread
+ *
+ * @return		true if it could be defined
+ */
+static bool defineProducer( int i ) {
+	char *threadname = 0;
+	asprintf( &threadname, "WAL Producer %04d", i );
+	struct walParms *parms = new walParms( threadname );
+	if (threadname == 0 || parms == 0) {
+		loadgen_problem = "malloc failure";
+		return false;
+	}
+	parms->thread->target = walTarget;
+	return true;
+}
+
+/**
+ * run a WAL workload: define the producers, start the committers,
+ *	and let the thread manager do the rest
+ */
+int
+walData( char *to, int threads ) {
+
+	// if there is an offset, note it and null it out
+	long long offset = getOffset(to);
+
+	// the log goes in the file or device, or in the directory
+	if (checkdev( to ) || checkfile( to )) {
+		logPath = to;
+		logBase = offset;
+	} else {
+		const char *err = checkdir(to, true);
+		if (err) {
+			fprintf(stderr, "FATAL: target directory %s: %s\n", to, err );
+			loadgen_problem = "target directory access";
+			return TARGET_DIRECTORY;
+		}
+		char *path = 0;
+		asprintf( &path, "%s/wal.log", to );
+		logPath = path;
+	}
+	logLength = loadgen_fsize ? loadgen_fsize : DEFAULT_WAL_LENGTH;
+	if (loadgen_direct > 0)
+		alignment = loadgen_direct;
+	if (logLength < groupSize + alignment) {
+		fprintf(stderr, "FATAL: log length %lld is smaller than a WAL group\n", logLength );
+		loadgen_problem = "log too small";
+		return OUTPUT_FILE_ERROR;
+	}
+
+	if (!loadgen_simulate) {
+		int opts = O_WRONLY | O_CREAT;
+		if (!loadgen_rewrite && logPath != to)
+			opts |= O_TRUNC;
+		if (loadgen_sync)
+			opts |= O_DSYNC;
+		if (loadgen_direct)
+			opts |= O_DIRECT;
+		logFd = open( logPath, opts, 0666 );
+		if (logFd < 0) {
+			fprintf(stderr, "Unable to create output file %s: %s\n",
+				logPath, strerror( errno ));
+			loadgen_problem = "file create failure";
+			return OUTPUT_FILE_ERROR;
+		}
+	}
+	if (loadgen_debug & D_FILES)
+		fprintf(stderr, "# WAL %s, length=%lld, record=%d, group=%lld, window=%ldus, committers=%d\n",
+			logPath, logLength, recordSize, groupSize, windowUs, numCommitters );
+
+	// define the producers we are to start with (and the rest as
+	//	they are wanted, if we were not told how many we may have)
+	walTarget = to;
+	for( int i = 0; i < threads; i++ )
+		if (!defineProducer( i ))
+			return RESOURCE_ERROR;
+
+	// each committer assembles its groups in a buffer of its own
+	for( int i = 0; i < numCommitters; i++ ) {
+		long long bufsize = groupSize + alignment;
+		if (posix_memalign( (void **) &groupBuf[i], alignment > 8 ? alignment : 8, bufsize ) != 0) {
+			fprintf(stderr, "Unable to allocate (%lld byte) WAL group buffer\n", bufsize );
+			loadgen_problem = "malloc failure";
+			return RESOURCE_ERROR;
+		}
+		memset( groupBuf[i], 0, bufsize );
+	}
+
+	// start the committers (which the thread manager knows nothing of)
+	pthread_t committers[MAX_COMMITTERS];
+	int started = 0;
+	int status = 0;
+	for( ; started < numCommitters; started++ )
+		if (pthread_create( &committers[started], 0, committer, (void *) (long) started ) != 0) {
+			fprintf(stderr, "Unable to start WAL committer %d\n", started );
+			loadgen_problem = "thread creation failure";
+			status = RESOURCE_ERROR;
+			loadgen_shutdown = true;
+			break;
+		}
+
+	// the thread manager runs the producers
+	if (started > 0)
+		status |= ThreadStatus::manageThreads( walProducer, threads, 64*1024,
+				threads ? 0 : defineProducer );
+
+	// and once they are done, the committers can finish up
+	pthread_mutex_lock( &walLock );
+	stopping = true;
+	pthread_cond_broadcast( &walWork );
+	pthread_mutex_unlock( &walLock );
+	for( int i = 0; i < started; i++ )
+		pthread_join( committers[i], 0 );
+	status |= failures;
+	for( int i = 0; i < numCommitters; i++ )
+		free( groupBuf[i] );
+
+	if (logFd >= 0)
+		close( logFd );
+	return status;
+}
+
+/**
+ * this is the routine that each WAL producer thread runs
+ *
+ * @param	ThreadStatus structure for this thread
+ */
+void *walProducer( void *sts ) {
+	int status = 0;		// this thread's exit status
+	long long written = 0;	// bytes committed
+	char *record = 0;	// the record we submit
+
+	struct ThreadStatus *mystatus = (struct ThreadStatus *) sts;
+	struct walParms *myparms = (struct walParms *) mystatus->parms;
+
+	// announce that we are starting up
+	mystatus->running = true;	// now set in manageThreads to avoid a race
+	if (loadgen_debug & D_THREADS) {
+		fprintf(stderr, "# Starting %s on %s on cpu %d\n", mystatus->name,
+			logPath, sched_getcpu() );
+	}
+
+	// our record says who wrote it
+	record = (char *) malloc( recordSize );
+	if (record == 0) {
+		fprintf(stderr, "Unable to allocate (%d byte) record for %s\n",
+			recordSize, mystatus->name );
+		status |= RESOURCE_ERROR;
+		loadgen_problem = "malloc failure";
+		goto exit;
+	}
+	memset( record, '.', recordSize );
+	snprintf( record, recordSize, "%s %s\n", loadgen_tag ? loadgen_tag : "", mystatus->name );
+	record[recordSize - 1] = '\n';
+
+	// submit records (one at a time) until we are done
+	while( status == 0 ) {
+		if (myparms->bytes_to_write > 0 && written >= myparms->bytes_to_write)
+			break;
+		if (!mystatus->keepRunning())
+			break;
+
+		struct walRecord r;
+		r.data = record;
+		r.len = recordSize;
+		r.durable = false;
+		r.next = 0;
+
+		pthread_mutex_lock( &walLock );
+		r.submitted = hires_time();
+		if (tail)
+			tail->next = &r;
+		else
+			head = &r;
+		tail = &r;
+		pending += r.len;
+		pthread_cond_signal( &walWork );
+		while( !r.durable )
+			pthread_cond_wait( &walDone, &walLock );
+		status = failures;
+		pthread_mutex_unlock( &walLock );
+		if (status)
+			break;
+
+		// note how long the commit took
+		hires_time_t elapsed = hires_time() - r.submitted;
+		mystatus->stats.xfer_done( r.len, elapsed, true );
+		written += r.len;
+
+		// see if we need to stall before the next record
+		long long rate = loadgen_rate;	// (which a profile may change)
+		if (rate > 0) {
+			hires_time_t expected_us = (1000000ULL * (hires_time_t) r.len) / (hires_time_t) rate;
+			if (expected_us > elapsed) {
+				hires_time_t needed_us = expected_us - elapsed;
+				if (loadgen_debug & D_SLEEP) {
+					fprintf(stderr,
+						"# sleep %lluus (=%llu-%llu)\n",
+						needed_us, expected_us, elapsed );
+				}
+				usleep( (long) needed_us );
+			}
+		}
+	}
+
+	free( record );
+
+  exit:
+	if (loadgen_debug & D_THREADS) {
+		// it is often useful to know what caused each thread to exit
+		fprintf(stderr, "# Shutting down %s (en=%d, bytes=%lld, sts=%x, stop=%d)\n",
+			mystatus->name, mystatus->enable.load(),
+			written, status, loadgen_shutdown.load() );
+	}
+
+	// report my exit status and exit
+	mystatus->exiting( status );
+	pthread_exit(0);
+}
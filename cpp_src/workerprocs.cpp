@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#include "loadgen.h"
+#include "workerprocs.h"
+#include "debug.h"
+
+/*
+ * what the manager tells the worker processes
+ */
+struct procControl {
+	pthread_mutex_t lock;		///< protects the rest
+	pthread_cond_t	wake;		///< (broadcast) something has changed
+	int		started;	///< threads that should be started
+	bool		shutdown;	///< shut down
+	bool		done;		///< the manager is done with us
+	long long	rate;		///< loadgen_rate
+	int		bsize;		///< loadgen_bsize
+	int		depth;		///< loadgen_depth
+	int		random;		///< loadgen_rand_blk
+	int		mix;		///< loadgen_mix
+	long		generation;	///< changes to the above
+};
+
+/*
+ * the shared memory is mapped (before the fork) in chunks, as it is
+ *	needed, so that we never map more than the threads we define
+ */
+struct procChunk {
+	struct procChunk *next;		///< next chunk mapped
+	size_t		size;		///< bytes mapped (including us)
+	size_t		used;		///< bytes allocated (including us)
+};
+#define	CHUNK_SIZE	(1024*1024)
+
+static struct procChunk *chunks = 0;	// the shared mappings (newest first)
+static struct procControl *control = 0;
+static pid_t pids[MAX_PROCS];
+static int numProcs = 0;
+static long applied = 0;		// (worker process) generation we have applied
+
+/*
+ * allocate memory shared with the worker processes
+ */
+void *procsShared( size_t size ) {
+	if (loadgen_procs < 2)
+		return 0;
+
+	size = (size + 63) & ~ (size_t) 63;
+	if (chunks == 0 || chunks->used + size > chunks->size) {
+		// a new chunk would not be shared with running worker processes
+		if (numProcs > 0) {
+			fprintf(stderr, "FATAL: worker process memory exhausted\n");
+			exit( RESOURCE_ERROR );
+		}
+
+		size_t bytes = CHUNK_SIZE;
+		while( bytes < size + 64 )
+			bytes *= 2;
+		void *p = mmap( 0, bytes, PROT_READ|PROT_WRITE,
+				MAP_SHARED|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0 );
+		if (p == MAP_FAILED) {
+			fprintf(stderr, "FATAL: unable to map worker process memory: %s\n", strerror( errno ));
+			exit( RESOURCE_ERROR );
+		}
+		struct procChunk *c = (struct procChunk *) p;
+		c->next = chunks;
+		c->size = bytes;
+		c->used = 64;
+		chunks = c;
+
+		// the control block goes at the start of the first one
+		if (control == 0) {
+			control = (struct procControl *) ((char *) c + c->used);
+			c->used += (sizeof (struct procControl) + 63) & ~ (size_t) 63;
+			procsInitLock( &control->lock, &control->wake );
+		}
+	}
+
+	void *p = (char *) chunks + chunks->used;
+	chunks->used += size;
+	return p;
+}
+
+/*
+ * is this in (our) shared memory
+ */
+bool procsOwns( const void *p ) {
+	for( struct procChunk *c = chunks; c != 0; c = c->next )
+		if ((const char *) p >= (const char *) c && (const char *) p < (const char *) c + c->size)
+			return true;
+	return false;
+}
+
+/*
+ * initialize a lock (and condition) to work across processes
+ */
+void procsInitLock( pthread_mutex_t *lock, pthread_cond_t *cond ) {
+	if (loadgen_procs < 2) {
+		pthread_mutex_init( lock, 0 );
+		pthread_cond_init( cond, 0 );
+		return;
+	}
+
+	pthread_mutexattr_t ma;
+	pthread_mutexattr_init( &ma );
+	pthread_mutexattr_setpshared( &ma, PTHREAD_PROCESS_SHARED );
+	pthread_mutex_init( lock, &ma );
+	pthread_mutexattr_destroy( &ma );
+
+	pthread_condattr_t ca;
+	pthread_condattr_init( &ca );
+	pthread_condattr_setpshared( &ca, PTHREAD_PROCESS_SHARED );
+	pthread_condattr_setclock( &ca, CLOCK_MONOTONIC );
+	pthread_cond_init( cond, &ca );
+	pthread_condattr_destroy( &ca );
+}
+
+/*
+ * fork the worker processes
+ */
+const char *procsStart( void (*serve)( int proc ) ) {
+	if (control == 0)
+		procsShared( 0 );
+	control->started = 0;
+	control->shutdown = loadgen_shutdown;
+	control->done = false;
+	control->rate = loadgen_rate;
+	control->bsize = loadgen_bsize;
+	control->depth = loadgen_depth;
+	control->random = loadgen_rand_blk;
+	control->mix = loadgen_mix;
+	control->generation = applied = 0;
+
+	// (so that nothing we have buffered is written twice)
+	fflush( stdout );
+	fflush( stderr );
+
+	pid_t manager = getpid();
+	for( numProcs = 0; numProcs < loadgen_procs; numProcs++ ) {
+		pid_t pid = fork();
+		if (pid < 0) {
+			fprintf(stderr, "Unable to fork worker process: %s\n", strerror( errno ));
+			return "fork failure";
+		}
+		if (pid == 0) {
+			// we are of no use without our manager
+			prctl( PR_SET_PDEATHSIG, SIGKILL );
+			if (getppid() != manager)
+				_exit( RESOURCE_ERROR );
+
+			serve( numProcs );
+			fflush( stdout );
+			fflush( stderr );
+			_exit( 0 );
+		}
+		pids[numProcs] = pid;
+		if (loadgen_debug & D_THREADS)
+			fprintf(stderr, "# worker process %d is pid %d\n", numProcs, (int) pid);
+	}
+	return 0;
+}
+
+/*
+ * ask the worker processes to start the threads they own
+ */
+void procsRequest( int started ) {
+	pthread_mutex_lock( &control->lock );
+	control->started = started;
+	pthread_cond_broadcast( &control->wake );
+	pthread_mutex_unlock( &control->lock );
+}
+
+/*
+ * pass parameter changes (and shutdown) on to the worker processes
+ */
+void procsPublish() {
+	if (control == 0 || numProcs == 0)
+		return;
+	if (control->shutdown == loadgen_shutdown && control->rate == loadgen_rate &&
+	    control->bsize == loadgen_bsize && control->depth == loadgen_depth &&
+	    control->random == loadgen_rand_blk && control->mix == loadgen_mix)
+		return;
+
+	pthread_mutex_lock( &control->lock );
+	control->shutdown = loadgen_shutdown;
+	control->rate = loadgen_rate;
+	control->bsize = loadgen_bsize;
+	control->depth = loadgen_depth;
+	control->random = loadgen_rand_blk;
+	control->mix = loadgen_mix;
+	control->generation++;
+	pthread_cond_broadcast( &control->wake );
+	pthread_mutex_unlock( &control->lock );
+}
+
+/*
+ * (worker process) wait to be asked to do something
+ */
+bool procsWait( int *started ) {
+	pthread_mutex_lock( &control->lock );
+	while( control->started == *started && !control->done &&
+	       control->generation == applied )
+		pthread_cond_wait( &control->wake, &control->lock );
+
+	*started = control->started;
+	if (control->generation != applied) {
+		if (control->shutdown)
+			loadgen_shutdown = true;
+		loadgen_rate = control->rate;
+		loadgen_bsize = control->bsize;
+		loadgen_depth = control->depth;
+		loadgen_rand_blk = control->random;
+		loadgen_mix = control->mix;
+		applied = control->generation;
+	}
+	bool more = !control->done;
+	pthread_mutex_unlock( &control->lock );
+	return more;
+}
+
+/*
+ * tell the worker processes we are done, and wait for them
+ */
+int procsEnd() {
+	if (numProcs == 0)
+		return 0;
+
+	pthread_mutex_lock( &control->lock );
+	control->done = true;
+	pthread_cond_broadcast( &control->wake );
+	pthread_mutex_unlock( &control->lock );
+
+	int status = 0;
+	for( int i = 0; i < numProcs; i++ ) {
+		int s;
+		if (waitpid( pids[i], &s, 0 ) < 0 || !WIFEXITED( s ) || WEXITSTATUS( s ) != 0) {
+			fprintf(stderr, "# worker process %d (pid %d) failed\n", i, (int) pids[i]);
+			status |= RESOURCE_ERROR;
+		}
+	}
+	numProcs = 0;
+	return status;
+}
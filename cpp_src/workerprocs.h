@@ -0,0 +1,87 @@
+#include <pthread.h>
+
+/*
+ * worker processes (with their statistics in shared memory)
+ *
+ *	All of the workers normally live in one process, where they
+ *	contend for its file descriptor table, its mmap lock and its
+ *	allocator arenas.  With --procs=K, the thread manager instead
+ *	forks K worker processes (once all of the threads have been
+ *	defined, PROCS_THREADS of them if there was no --threads count),
+ *	and each of them starts the threads in its slice of them (every
+ *	Kth, so that they are spread evenly among the processes whatever
+ *	the number of threads).
+ *
+ *	The thread descriptors (and their statistics) are allocated in
+ *	anonymous shared mappings, mapped a chunk at a time (as the
+ *	threads are defined) before the fork, so that the manager sees
+ *	each worker's progress, parks and unparks it (with process-shared
+ *	locks), and harvests its exit exactly as it does for a thread of
+ *	its own.  The manager remains the only reader of stdin and writer
+ *	of reports, and a control block (in the first mapping) tells the
+ *	worker processes which threads to start, the current rate and
+ *	block parameters, and when to shut down.
+ */
+
+// most worker processes
+#define	MAX_PROCS	64
+
+// threads defined for the worker processes (if not told how many)
+//	since none can be defined once they have been forked
+#define	PROCS_THREADS	256
+
+/**
+ * allocate memory shared with the worker processes
+ *
+ * @param	bytes needed
+ * @return	shared memory (or NULL if there are no worker processes)
+ */
+void *procsShared( size_t size );
+
+/**
+ * is this in (our) shared memory
+ */
+bool procsOwns( const void *p );
+
+/**
+ * initialize a lock (and condition) to work across processes
+ *	(if there are worker processes)
+ */
+void procsInitLock( pthread_mutex_t *lock, pthread_cond_t *cond );
+
+/**
+ * fork the worker processes
+ *
+ * @param	routine each process runs (with its number) before it exits
+ * @return	NULL if OK, else a description of the problem
+ */
+const char *procsStart( void (*serve)( int proc ) );
+
+/**
+ * (manager) ask the worker processes to start the threads they own
+ *
+ * @param	number of threads (in order) that should now be started
+ */
+void procsRequest( int started );
+
+/**
+ * (manager) pass changes to the rate, block parameters and shutdown
+ *	on to the worker processes
+ */
+void procsPublish();
+
+/**
+ * (worker process) wait to be asked to do something
+ *	(applying any new parameters or shutdown)
+ *
+ * @param	(returned) number of threads that should be started
+ * @return	false once the manager is done with us
+ */
+bool procsWait( int *started );
+
+/**
+ * (manager) tell the worker processes we are done, and wait for them
+ *
+ * @return	exit status bits (if any of them failed)
+ */
+int procsEnd();
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "workqueue.h"
+
+/*
+ * scandir filter function to select only non-hidden files
+ *
+ * @param dp	dirent to be validated
+ *
+ * @return	true if it is a non-hidden file
+ */
+static int isFile( const struct dirent *dp ) {
+	return( dp->d_name[0] != '.' );
+}
+
+WorkQueue::WorkQueue( int workers, bool steal ) {
+	_workers = workers;
+	_steal = steal;
+	_queues = (queue *) calloc( workers > 0 ? workers : 1, sizeof *_queues );
+	for( int i = 0; i < workers; i++ )
+		pthread_mutex_init( &_queues[i].lock, 0 );
+	_dirs = 0;
+	_numdirs = 0;
+}
+
+WorkQueue::~WorkQueue() {
+	for( int i = 0; i < _workers; i++ ) {
+		queue *q = &_queues[i];
+		for( int f = 0; f < q->count; f++ )
+			free( q->items[f].name );
+		free( q->items );
+		pthread_mutex_destroy( &q->lock );
+	}
+	free( _queues );
+
+	for( int d = 0; d < _numdirs; d++ ) {
+		free( _dirs[d]->path );
+		free( _dirs[d]->peer );
+		free( _dirs[d] );
+	}
+	free( _dirs );
+}
+
+/*
+ * queue up all the (non-hidden) files in a directory
+ */
+int WorkQueue::addDir( int worker, const char *path, const char *peer ) {
+	if (worker < 0 || worker >= _workers)
+		return -1;
+
+	struct dirent **results;
+	int count = scandir( path, &results, isFile, alphasort );
+	if (count < 0)
+		return -1;
+
+	// remember the directory, so we know when it is finished
+	WorkDir *dir = (WorkDir *) malloc( sizeof *dir );
+	WorkDir **dirs = (WorkDir **) realloc( _dirs, (_numdirs + 1) * sizeof *_dirs );
+	queue *q = &_queues[worker];
+	WorkItem *items = (WorkItem *) realloc( q->items, (q->count + count + 1) * sizeof *items );
+	if (dirs)
+		_dirs = dirs;
+	if (items)
+		q->items = items;
+	if (dir == 0 || dirs == 0 || items == 0) {
+		for( int i = 0; i < count; i++ )
+			free( results[i] );
+		free( results );
+		free( dir );
+		return -1;
+	}
+	dir->path = strdup( path );
+	dir->peer = peer ? strdup( peer ) : 0;
+	dir->remaining = count;
+	dir->failed = false;
+	dir->owner = worker;
+	dir->empty = (count == 0);
+	_dirs[_numdirs++] = dir;
+
+	// and add its files to the end of this worker's queue
+	for( int i = 0; i < count; i++ ) {
+		WorkItem *w = &q->items[q->count++];
+		w->dir = dir;
+		w->name = strdup( results[i]->d_name );
+		free( results[i] );
+	}
+	free( results );
+	q->tail = q->count;
+
+	return count;
+}
+
+/*
+ * get the next file for a worker
+ *	first from the front of our own queue, and then
+ *	(if allowed) from the back of the longest other queue
+ */
+WorkItem *WorkQueue::get( int worker ) {
+	if (worker < 0 || worker >= _workers)
+		return 0;
+
+	WorkItem *w = 0;
+	queue *q = &_queues[worker];
+	pthread_mutex_lock( &q->lock );
+	if (q->head < q->tail)
+		w = &q->items[q->head++];
+	pthread_mutex_unlock( &q->lock );
+
+	while( w == 0 && _steal ) {
+		// find the victim with the most work left
+		//	(unlocked, so this is only a hint)
+		queue *victim = 0;
+		int most = 0;
+		for( int i = 0; i < _workers; i++ ) {
+			int left = _queues[i].tail - _queues[i].head;
+			if (i != worker && left > most) {
+				most = left;
+				victim = &_queues[i];
+			}
+		}
+		if (victim == 0)
+			break;
+
+		pthread_mutex_lock( &victim->lock );
+		if (victim->head < victim->tail)
+			w = &victim->items[--victim->tail];
+		pthread_mutex_unlock( &victim->lock );
+	}
+
+	return w;
+}
+
+/*
+ * note that work on a file is finished
+ */
+bool WorkQueue::done( WorkItem *item, bool ok ) {
+	WorkDir *dir = item->dir;
+	if (!ok)
+		dir->failed = true;
+	return __sync_sub_and_fetch( &dir->remaining, 1 ) == 0 && !dir->failed;
+}
+
+/*
+ * claim a directory of a worker's that had no files at all
+ */
+WorkDir *WorkQueue::empty( int worker ) {
+	for( int d = 0; d < _numdirs; d++ ) {
+		WorkDir *dir = _dirs[d];
+		if (dir->owner == worker && __sync_lock_test_and_set( &dir->empty, false ))
+			return dir;
+	}
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include <pthread.h>
+
+/*
+ * shared work queue for the reader, verifier, comparer and copier threads
+ *
+ *	Each worker used to be bound to one directory for its whole life,
+ *	so a worker with a large directory was still plodding along long
+ *	after the others had finished.  Instead, the files of each directory
+ *	are queued up for the worker that owns that directory and, if
+ *	stealing is enabled, a worker that runs out of files of its own
+ *	takes them (one at a time) from the back of the longest queue.
+ *	Thus every enabled worker stays busy until the data is exhausted,
+ *	and changes in the number of threads take effect at file (rather
+ *	than directory) granularity.
+ *
+ *	Files are only added before the workers are started, so each
+ *	queue is just an array with a head (where its owner takes work)
+ *	and a tail (where thieves take work).
+ */
+struct WorkDir {
+	char *	path;		///< directory containing the files
+	char *	peer;		///< corresponding source/target directory (if any)
+	int	remaining;	///< files not yet finished
+	bool	failed;		///< some file in this directory failed
+	int	owner;		///< worker whose queue its files are on
+	bool	empty;		///< it had no files (and has not been claimed)
+};
+
+struct WorkItem {
+	WorkDir *dir;		///< directory this file is in
+	char *	name;		///< name of the file
+};
+
+class WorkQueue {
+    public:
+	/**
+	 * allocate a set of empty queues
+	 *
+	 * @param	number of workers (each with its own queue)
+	 * @param	may workers take work from other queues
+	 */
+	WorkQueue( int workers, bool steal );
+
+	~WorkQueue();
+
+	/**
+	 * queue up all the (non-hidden) files in a directory
+	 *
+	 * @param	worker who owns the directory
+	 * @param	directory containing the files
+	 * @param	corresponding source/target directory (or NULL)
+	 * @return	number of files queued (or -1 if it cannot be read)
+	 */
+	int addDir( int worker, const char *path, const char *peer );
+
+	/**
+	 * get the next file for a worker
+	 *
+	 * @param	worker looking for something to do
+	 * @return	next file (or NULL if there is no more work)
+	 */
+	WorkItem *get( int worker );
+
+	/**
+	 * note that work on a file is finished
+	 *
+	 * @param	file that has been finished
+	 * @param	was it successfully processed
+	 * @return	true if that was the last file in a directory, all
+	 *		of which were successfully processed
+	 */
+	bool done( WorkItem *item, bool ok );
+
+	/**
+	 * claim a directory of a worker's that had no files at all
+	 *	(and so will never be finished by done)
+	 *
+	 * @param	worker who owns the directory
+	 * @return	next such directory (or NULL if there are no more)
+	 */
+	WorkDir *empty( int worker );
+
+	/**
+	 * @return	number of files originally queued for a worker
+	 */
+	int queued( int worker ) {
+		return (worker >= 0 && worker < _workers) ? _queues[worker].count : 0;
+	}
+
+    private:
+	struct queue {
+		WorkItem *items;	///< files queued for this worker
+		int	count;		///< number of files queued
+		int	head;		///< next file for the owner
+		int	tail;		///< one past the next file for a thief
+		pthread_mutex_t lock;
+	};
+
+	int	_workers;	///< number of queues
+	bool	_steal;		///< may workers take others' work
+	queue *	_queues;	///< per-worker queues
+	WorkDir **_dirs;	///< directories we have queued
+	int	_numdirs;	///< number of queued directories
+};
@@ -24,6 +24,11 @@ public class Zombie {
 	private static final String ZOMBIE_DIES     = "Arg Master.";
 	private static final String ZOMBIE_REPORT   = "REPORT";
 	private static final String ZOMBIE_COMMENT	= "#";
+	private static final String ZOMBIE_DETAIL	= "DETAIL";
+	private static final String ZOMBIE_TUNE		= "TUNE";
+	private static final String ZOMBIE_SWEEP	= "SWEEP";
+	private static final String ZOMBIE_ACK		= "ACK";
+	private static final String ZOMBIE_NAK		= "NAK";
 	
 	public final String tag;		// nick-name for this zombie
 	private final String args;		// misc args for this Zombie
@@ -134,7 +139,10 @@ public class Zombie {
 			command +=  "  --rate=" + bandwidth;
 		
 		// interaction/diagnostic parameters
-		command += " --update=" + updatePeriod/1000;	// ms -> seconds
+		if (updatePeriod % 1000 == 0)
+			command += " --update=" + updatePeriod/1000;	// ms -> seconds
+		else
+			command += " --update=" + updatePeriod + "ms";
 		command += " --halt";
 		if (Options.getInstance().log) {
 			System.out.println(tag + " <- " + command );
@@ -181,6 +189,28 @@ public class Zombie {
 							System.out.println(tag + " -> " + report );
 						continue;
 					}
+
+					// per-target/thread breakdowns and saturation
+					// search and sweep results are only for the log
+					if (report.startsWith(ZOMBIE_DETAIL) ||
+					    report.startsWith(ZOMBIE_TUNE) ||
+					    report.startsWith(ZOMBIE_SWEEP)) {
+						if (opts.log)
+							System.out.println( report );
+						continue;
+					}
+
+					// commands are acknowledged (or refused)
+					if (report.startsWith(ZOMBIE_ACK)) {
+						if (opts.log)
+							System.out.println(tag + " -> " + report );
+						continue;
+					}
+					if (report.startsWith(ZOMBIE_NAK)) {
+						System.err.println( "ZOMBIE " + tag + " refused: " +
+								report.substring(ZOMBIE_NAK.length()).trim() );
+						continue;
+					}
 			
 					// note recentness of this update
 					lastUpdate = System.currentTimeMillis();